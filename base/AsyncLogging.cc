@@ -0,0 +1,600 @@
+#include "base/AsyncLogging.h"
+#include "base/LogFile.h"
+#include "base/Logging.h"
+#include "base/Timestamp.h"
+
+#include <algorithm>
+#include <queue>
+
+#include <pthread.h>
+#include <stdio.h>
+
+using namespace muduo;
+
+namespace
+{
+
+/**
+ * kPerThreadBuffer 模式下，当前线程的 ThreadState 以及它属于哪一个 AsyncLogging
+ * 一个进程里面通常只有一个 AsyncLogging 对象
+ * 用 id 而不是地址判断，AsyncLogging 析构之后新的对象可能分配在同一个地址上，这时缓存的 ThreadState 已经释放
+*/
+__thread void* t_threadState = NULL;
+__thread uint64_t t_stateOwner = 0;
+std::atomic<uint64_t> g_nextId(1);
+
+/**
+ * 线程退出的时候把它在各个 AsyncLogging 中的 ThreadState 标记为已经退出
+ * pthread_key 的析构函数在退出的线程中调用，同时清除这个线程的缓存，之后再写日志会重新注册
+*/
+typedef std::vector<std::shared_ptr<std::atomic<bool> > > ExitFlags;
+pthread_once_t g_exitKeyOnce = PTHREAD_ONCE_INIT;
+pthread_key_t g_exitKey;
+
+void onThreadExit(void* arg)
+{
+	ExitFlags* flags = static_cast<ExitFlags*>(arg);
+	t_threadState = NULL;
+	t_stateOwner = 0;
+	for (const auto& exited : *flags)
+	{
+		exited->store(true, std::memory_order_release);
+	}
+	delete flags;
+}
+
+void createExitKey()
+{
+	::pthread_key_create(&g_exitKey, onThreadExit);
+}
+
+void watchThreadExit(const std::shared_ptr<std::atomic<bool> >& exited)
+{
+	::pthread_once(&g_exitKeyOnce, createExitKey);
+	ExitFlags* flags = static_cast<ExitFlags*>(::pthread_getspecific(g_exitKey));
+	if (flags == NULL)
+	{
+		flags = new ExitFlags;
+		::pthread_setspecific(g_exitKey, flags);
+	}
+	flags->push_back(exited);
+}
+
+/*后端积压的线程缓冲区超过这个数量，说明前端写得太快，丢弃多余的日志*/
+const size_t kMaxPendingThreadBuffers = 25 * detail::kLargeBuffer / detail::kThreadBuffer;
+const size_t kMaxFreeThreadBuffers = 64;
+
+}  // namespace
+
+AsyncLogging::AsyncLogging(const string& basename,
+						   off_t rollSize,
+						   int flushInterval,
+						   Option option)
+	:	flushInterval_(flushInterval),
+		running_(false),
+		basename_(basename),
+		rollSize_(rollSize),
+		option_(option),
+		id_(g_nextId.fetch_add(1)),
+		thread_(std::bind(&AsyncLogging::threadFunc, this), "Logging"),
+		latch_(1),
+		mutex_(),
+		cond_(mutex_),
+		currentBuffer_(new Buffer),
+		nextBuffer_(new Buffer),
+		buffers_(),
+		pending_(NULL),
+		droppedBuffers_(0)
+{
+	currentBuffer_->bzero();
+	nextBuffer_->bzero();
+	buffers_.reserve(16);
+}
+
+AsyncLogging::~AsyncLogging()
+{
+	if (running_)
+	{
+		stop();
+	}
+
+	ThreadBuffer* buffer = pending_.exchange(NULL);
+	while (buffer)
+	{
+		ThreadBuffer* next = buffer->next;
+		delete buffer;
+		buffer = next;
+	}
+}
+
+/**
+ * 前端：所有的业务线程调用这个函数，把日志追加到 currentBuffer_ 当中
+ * 这里只有内存拷贝，不会有磁盘 IO
+*/
+void AsyncLogging::append(const char* logline, int len)
+{
+	if (option_ == kPerThreadBuffer)
+	{
+		appendPerThread(logline, len);
+		return;
+	}
+
+	muduo::MutexLockGuard lock(mutex_);
+	if (currentBuffer_->avail() > len)
+	{
+		currentBuffer_->append(logline, len);
+	}
+	else
+	{
+		/**
+		 * 当前的缓冲区写满了，放入 buffers_ 等待后端写入文件
+		 * 如果预备的 nextBuffer_ 还在，直接拿来用，否则（前端写的太快）只能重新分配一块
+		*/
+		buffers_.push_back(std::move(currentBuffer_));
+
+		if (nextBuffer_)
+		{
+			currentBuffer_ = std::move(nextBuffer_);
+		}
+		else
+		{
+			currentBuffer_.reset(new Buffer); // Rarely happens
+		}
+		currentBuffer_->append(logline, len);
+		cond_.notify();
+	}
+}
+
+/**
+ * 后端：日志线程，每 flushInterval_ 秒（或者有缓冲区写满的时候）被唤醒
+ * 在临界区之内只交换指针，真正的文件写入在临界区之外完成
+*/
+void AsyncLogging::threadFunc()
+{
+	if (option_ == kPerThreadBuffer)
+	{
+		threadFuncPerThread();
+		return;
+	}
+
+	assert(running_ == true);
+	latch_.countDown();
+	LogFile output(basename_, rollSize_, false);
+	BufferPtr newBuffer1(new Buffer);
+	BufferPtr newBuffer2(new Buffer);
+	newBuffer1->bzero();
+	newBuffer2->bzero();
+	BufferVector buffersToWrite;
+	buffersToWrite.reserve(16);
+	while (running_)
+	{
+		assert(newBuffer1 && newBuffer1->length() == 0);
+		assert(newBuffer2 && newBuffer2->length() == 0);
+		assert(buffersToWrite.empty());
+
+		{
+			muduo::MutexLockGuard lock(mutex_);
+			if (buffers_.empty())  // unusual usage!
+			{
+				cond_.waitForSeconds(flushInterval_);
+			}
+			buffers_.push_back(std::move(currentBuffer_));
+			currentBuffer_ = std::move(newBuffer1);
+			buffersToWrite.swap(buffers_);
+			if (!nextBuffer_)
+			{
+				nextBuffer_ = std::move(newBuffer2);
+			}
+		}
+
+		assert(!buffersToWrite.empty());
+
+		/**
+		 * 前端产生日志的速度远远大于后端写入的速度，直接丢弃多余的日志，只保留前两块
+		*/
+		if (buffersToWrite.size() > 25)
+		{
+			char buf[256];
+			snprintf(buf, sizeof buf, "Dropped log messages at %s, %zd larger buffers\n",
+					Timestamp::now().toFormattedString().c_str(),
+					buffersToWrite.size()-2);
+			fputs(buf, stderr);
+			output.append(buf, static_cast<int>(strlen(buf)));
+			droppedBuffers_.fetch_add(static_cast<int64_t>(buffersToWrite.size() - 2), std::memory_order_relaxed);
+			buffersToWrite.erase(buffersToWrite.begin()+2, buffersToWrite.end());
+		}
+
+		for (const auto& buffer : buffersToWrite)
+		{
+			// FIXME: use unbuffered stdio FILE ? or use ::writev ?
+			output.append(buffer->data(), buffer->length());
+		}
+
+		/**
+		 * 回收写完的缓冲区，用来补充 newBuffer1 和 newBuffer2，避免反复的分配内存
+		*/
+		if (buffersToWrite.size() > 2)
+		{
+			// drop non-bzero-ed buffers, avoid trashing
+			buffersToWrite.resize(2);
+		}
+
+		if (!newBuffer1)
+		{
+			assert(!buffersToWrite.empty());
+			newBuffer1 = std::move(buffersToWrite.back());
+			buffersToWrite.pop_back();
+			newBuffer1->reset();
+		}
+
+		if (!newBuffer2)
+		{
+			assert(!buffersToWrite.empty());
+			newBuffer2 = std::move(buffersToWrite.back());
+			buffersToWrite.pop_back();
+			newBuffer2->reset();
+		}
+
+		buffersToWrite.clear();
+		output.flush();
+	}
+
+	/**
+	 * stop() 的时候后端可能正在写文件，没有等在 cond_ 上，把剩下的日志写完再退出
+	*/
+	{
+		muduo::MutexLockGuard lock(mutex_);
+		for (const auto& buffer : buffers_)
+		{
+			output.append(buffer->data(), buffer->length());
+		}
+		buffers_.clear();
+		output.append(currentBuffer_->data(), currentBuffer_->length());
+		currentBuffer_->reset();
+	}
+	output.flush();
+}
+
+AsyncLogging::ThreadState* AsyncLogging::threadState()
+{
+	if (t_stateOwner == id_)
+	{
+		return static_cast<ThreadState*>(t_threadState);
+	}
+
+	/**
+	 * 每一个线程第一次写日志的时候注册一次，只有这里需要上锁
+	 * 线程交替写多个 AsyncLogging 的时候缓存会失效，先找这个线程已经注册过的，每个线程最多注册一个
+	 * 已经退出的线程的 ThreadState 还没有被后端释放的时候，tid 可能被新的线程重用，跳过它们
+	*/
+	pid_t tid = CurrentThread::tid();
+	ThreadState* ret = NULL;
+	{
+		muduo::MutexLockGuard lock(mutex_);
+		for (const auto& state : threadStates_)
+		{
+			if (state->tid == tid && !state->exited->load(std::memory_order_relaxed))
+			{
+				ret = state.get();
+				break;
+			}
+		}
+		if (ret == NULL)
+		{
+			std::unique_ptr<ThreadState> state(new ThreadState);
+			state->tid = tid;
+			state->current.reset(new ThreadBuffer);
+			ret = state.get();
+			watchThreadExit(state->exited);
+			threadStates_.push_back(std::move(state));
+		}
+	}
+	t_threadState = ret;
+	t_stateOwner = id_;
+	return ret;
+}
+
+/**
+ * kPerThreadBuffer 模式的前端
+ * 正常情况下只操作当前线程自己的缓冲区，busy 标志只会和后端收集缓冲区的时候发生竞争
+*/
+void AsyncLogging::appendPerThread(const char* logline, int len)
+{
+	ThreadState* state = threadState();
+
+	const int kMaxLen = detail::kThreadBuffer - static_cast<int>(sizeof(Record)) - 1;
+	/*从 Logger 输出的时候直接使用 Logger 已经取得的时间*/
+	Timestamp time(Logger::outputTime());
+	if (!time.valid())
+	{
+		time = Timestamp::now();
+	}
+	Record record = { time.microSecondsSinceEpoch(), std::min(len, kMaxLen) };
+	const int need = static_cast<int>(sizeof record) + record.len;
+
+	bool handedOff = false;
+	while (state->busy.test_and_set(std::memory_order_acquire))
+	{
+	}
+
+	if (state->current->avail() <= need)
+	{
+		/**
+		 * 当前线程的缓冲区写满了，交给后端，换上后端归还的空缓冲区
+		*/
+		ThreadBuffer* full = state->current.release();
+		ThreadBuffer* spare = state->spare.exchange(NULL, std::memory_order_acquire);
+		state->current.reset(spare ? spare : new ThreadBuffer);
+		pushPending(full);
+		handedOff = true;
+	}
+	state->current->append(reinterpret_cast<const char*>(&record), sizeof record);
+	state->current->append(logline, record.len);
+
+	state->busy.clear(std::memory_order_release);
+
+	if (handedOff)
+	{
+		/**
+		 * 后端在 mutex_ 中检查 pending_ 之后才等待，不加锁的话通知可能落在检查和等待之间而丢失，
+		 * 后端会睡满 flushInterval_。只有交接缓冲区的时候才走到这里，加锁的代价可以忽略
+		*/
+		muduo::MutexLockGuard lock(mutex_);
+		cond_.notify();
+	}
+}
+
+void AsyncLogging::pushPending(ThreadBuffer* buffer)
+{
+	buffer->next = pending_.load(std::memory_order_relaxed);
+	while (!pending_.compare_exchange_weak(buffer->next, buffer,
+										   std::memory_order_release,
+										   std::memory_order_relaxed))
+	{
+	}
+}
+
+/**
+ * 后端：一次性取走无锁队列中所有写满的缓冲区，再收集每一个线程没有写满的缓冲区
+ * 这样同一批次里面包含了收集时刻之前所有线程写下的日志，可以按照时间戳排序
+*/
+void AsyncLogging::collectPending(ThreadBufferVector* buffers, ThreadBufferVector* freeBuffers)
+{
+	ThreadBuffer* buffer = pending_.exchange(NULL, std::memory_order_acquire);
+	size_t first = buffers->size();
+	while (buffer)
+	{
+		ThreadBuffer* next = buffer->next;
+		buffer->next = NULL;
+		buffers->emplace_back(buffer);
+		buffer = next;
+	}
+	/*栈是后进先出的，翻转之后同一个线程的缓冲区保持写入的顺序*/
+	std::reverse(buffers->begin() + first, buffers->end());
+
+	std::vector<ThreadState*> states;
+	{
+		muduo::MutexLockGuard lock(mutex_);
+		states.reserve(threadStates_.size());
+		for (const auto& state : threadStates_)
+		{
+			states.push_back(state.get());
+		}
+	}
+
+	bool anyExited = false;
+	for (ThreadState* state : states)
+	{
+		/*先读 exited：之后取到的缓冲区一定包含这个线程所有的日志*/
+		bool exited = state->exited->load(std::memory_order_acquire);
+		anyExited = anyExited || exited;
+		ThreadBufferPtr partial;
+		while (state->busy.test_and_set(std::memory_order_acquire))
+		{
+		}
+		if (state->current->length() > 0 && !exited)
+		{
+			ThreadBuffer* spare = state->spare.exchange(NULL, std::memory_order_acquire);
+			partial = std::move(state->current);
+			state->current.reset(spare ? spare : new ThreadBuffer);
+		}
+		else if (state->current->length() > 0)
+		{
+			partial = std::move(state->current);	/*线程已经退出，不再需要缓冲区*/
+		}
+		state->busy.clear(std::memory_order_release);
+
+		if (partial)
+		{
+			buffers->push_back(std::move(partial));
+		}
+	}
+
+	/**
+	 * 已经退出的线程不会再写，它的日志上面都已经取走了，释放 ThreadState，缓冲区留给其他线程用
+	 * 否则每一个写过日志的线程都会留下 64KB 的缓冲区，而且后端每一次都要遍历它们
+	*/
+	if (anyExited)
+	{
+		muduo::MutexLockGuard lock(mutex_);
+		for (size_t i = 0; i < threadStates_.size(); )
+		{
+			ThreadState* state = threadStates_[i].get();
+			if (!state->exited->load(std::memory_order_acquire) || (state->current && state->current->length() > 0))
+			{
+				++i;
+				continue;
+			}
+			if (state->current && freeBuffers->size() < kMaxFreeThreadBuffers)
+			{
+				freeBuffers->push_back(std::move(state->current));
+			}
+			ThreadBuffer* spare = state->spare.exchange(NULL, std::memory_order_acquire);
+			if (spare != NULL && freeBuffers->size() < kMaxFreeThreadBuffers)
+			{
+				freeBuffers->emplace_back(spare);
+			}
+			else
+			{
+				delete spare;
+			}
+			threadStates_[i] = std::move(threadStates_.back());
+			threadStates_.pop_back();
+		}
+	}
+}
+
+/**
+ * 把写完的缓冲区还给没有备用缓冲区的线程，避免前端反复的分配内存
+*/
+void AsyncLogging::refillSpares(ThreadBufferVector* freeBuffers)
+{
+	muduo::MutexLockGuard lock(mutex_);
+	for (const auto& state : threadStates_)
+	{
+		if (freeBuffers->empty())
+		{
+			break;
+		}
+		ThreadBuffer* expected = NULL;
+		if (state->spare.load(std::memory_order_relaxed) == NULL &&
+			state->spare.compare_exchange_strong(expected, freeBuffers->back().get(),
+												 std::memory_order_release))
+		{
+			freeBuffers->back().release();
+			freeBuffers->pop_back();
+		}
+	}
+}
+
+/**
+ * 每一个缓冲区内部的日志已经按照时间排好序了，用小顶堆做多路归并
+ * 时间戳相同的时候按照缓冲区在 buffers 中的顺序输出
+ * 归并的结果先拷贝到 merged 中，写满一次调用一次 LogFile::append()，而不是每一条日志调用一次
+*/
+void AsyncLogging::writeMerged(LogFile& output, ThreadBufferVector& buffers, Buffer* merged)
+{
+	struct Cursor
+	{
+		int64_t		time;
+		size_t		index;
+		const char*	pos;
+		const char*	end;
+
+		bool operator>(const Cursor& rhs) const
+		{
+			return time > rhs.time || (time == rhs.time && index > rhs.index);
+		}
+	};
+
+	std::priority_queue<Cursor, std::vector<Cursor>, std::greater<Cursor> > heap;
+	for (size_t i = 0; i < buffers.size(); ++i)
+	{
+		const ThreadBuffer& buffer = *buffers[i];
+		if (buffer.length() > 0)
+		{
+			Record record;
+			::memcpy(&record, buffer.data(), sizeof record);
+			Cursor cursor = { record.microSecondsSinceEpoch, i,
+							  buffer.data(), buffer.data() + buffer.length() };
+			heap.push(cursor);
+		}
+	}
+
+	while (!heap.empty())
+	{
+		Cursor cursor = heap.top();
+		heap.pop();
+
+		/**
+		 * 一次取出这个缓冲区中排在其他所有缓冲区前面的一段，而不是每一条日志都进出一次堆
+		 * 线程通常是一段时间一段时间地写，一段可以有很多条
+		*/
+		bool more = false;
+		do
+		{
+			Record record;
+			::memcpy(&record, cursor.pos, sizeof record);
+			if (merged->avail() <= record.len)
+			{
+				output.append(merged->data(), merged->length());
+				merged->reset();
+			}
+			merged->append(cursor.pos + sizeof record, record.len);
+			cursor.pos += sizeof record + record.len;
+
+			more = cursor.pos < cursor.end;
+			if (more)
+			{
+				::memcpy(&record, cursor.pos, sizeof record);
+				cursor.time = record.microSecondsSinceEpoch;
+			}
+		} while (more && (heap.empty() || !(cursor > heap.top())));
+
+		if (more)
+		{
+			heap.push(cursor);
+		}
+	}
+	output.append(merged->data(), merged->length());
+	merged->reset();
+}
+
+void AsyncLogging::threadFuncPerThread()
+{
+	assert(running_ == true);
+	latch_.countDown();
+	LogFile output(basename_, rollSize_, false);
+	ThreadBufferVector buffersToWrite;
+	ThreadBufferVector freeBuffers;
+	BufferPtr merged(new Buffer);
+	buffersToWrite.reserve(16);
+
+	bool stopping = false;
+	while (!stopping)
+	{
+		stopping = !running_;
+		{
+			muduo::MutexLockGuard lock(mutex_);
+			if (!stopping && pending_.load(std::memory_order_relaxed) == NULL)
+			{
+				cond_.waitForSeconds(flushInterval_);
+			}
+		}
+
+		collectPending(&buffersToWrite, &freeBuffers);
+		if (buffersToWrite.empty())
+		{
+			continue;
+		}
+
+		if (buffersToWrite.size() > kMaxPendingThreadBuffers)
+		{
+			char buf[256];
+			snprintf(buf, sizeof buf, "Dropped log messages at %s, %zd thread buffers\n",
+					Timestamp::now().toFormattedString().c_str(),
+					buffersToWrite.size() - kMaxPendingThreadBuffers);
+			fputs(buf, stderr);
+			output.append(buf, static_cast<int>(strlen(buf)));
+			droppedBuffers_.fetch_add(static_cast<int64_t>(buffersToWrite.size() - kMaxPendingThreadBuffers),
+									  std::memory_order_relaxed);
+			buffersToWrite.resize(kMaxPendingThreadBuffers);
+		}
+
+		writeMerged(output, buffersToWrite, merged.get());
+		output.flush();
+
+		for (auto& buffer : buffersToWrite)
+		{
+			if (freeBuffers.size() >= kMaxFreeThreadBuffers)
+			{
+				break;
+			}
+			buffer->reset();
+			freeBuffers.push_back(std::move(buffer));
+		}
+		buffersToWrite.clear();
+		refillSpares(&freeBuffers);
+	}
+	output.flush();
+}
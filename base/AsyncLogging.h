@@ -9,27 +9,39 @@
 #include "base/LogStream.h"
 
 #include <atomic>
+#include <memory>
 #include <vector>
 
 namespace muduo
 {
 
+class LogFile;
+
 class AsyncLogging : noncopyable
 {
 public:
+	/**
+	 * kGlobalBuffer : 所有的线程共享 currentBuffer_，由 mutex_ 保护
+	 * kPerThreadBuffer : 每一个线程写自己的缓冲区，写满之后通过无锁队列交给后端，
+	 * 		后端在写文件之前按照时间戳把各个线程的日志合并排序
+	*/
+	enum Option
+	{
+		kGlobalBuffer,
+		kPerThreadBuffer,
+	};
+
 	AsyncLogging(const string& basename,
                off_t rollSize,
-               int flushInterval = 3);
-	~AsyncLogging()
-	{
-		if (running_)
-		{
-			stop();
-		}
-	}
+               int flushInterval = 3,
+               Option option = kGlobalBuffer);
+	~AsyncLogging();
 
   	void append(const char* logline, int len);
 
+	/*后端因为前端写得太快而丢弃的缓冲区个数 (kGlobalBuffer 是 4MB 的缓冲区，kPerThreadBuffer 是线程缓冲区)*/
+	int64_t droppedBuffers() const { return droppedBuffers_.load(std::memory_order_relaxed); }
+
 	void start()
 	{
 		running_ = true;
@@ -40,7 +52,11 @@ public:
 	void stop() NO_THREAD_SAFETY_ANALYSIS
 	{
 		running_ = false;
-		cond_.notify();
+		{
+			/*后端在 mutex_ 中检查之后才等待，不加锁的话这次通知可能丢失*/
+			muduo::MutexLockGuard lock(mutex_);
+			cond_.notify();
+		}
 		thread_.join();
 	}
 
@@ -51,10 +67,57 @@ private:
 	typedef std::vector<std::unique_ptr<Buffer> >   BufferVector;
 	typedef BufferVector::value_type                BufferPtr;
 
+	/**
+	 * kPerThreadBuffer 模式下使用
+	 * 每一条日志在线程缓冲区中的格式为 Record 头部 + 日志内容
+	 * next 把写满的缓冲区链接成交给后端的无锁 MPSC 队列（Treiber 栈），交接的时候不需要另外分配节点
+	*/
+	struct ThreadBuffer : public muduo::detail::FixedBuffer<muduo::detail::kThreadBuffer>
+	{
+		ThreadBuffer() : next(NULL) {}
+
+		ThreadBuffer* next;
+	};
+	typedef std::unique_ptr<ThreadBuffer> ThreadBufferPtr;
+	typedef std::vector<ThreadBufferPtr> ThreadBufferVector;
+
+	struct Record
+	{
+		int64_t	microSecondsSinceEpoch;
+		int		len;
+	};
+
+	/**
+	 * 每一个线程私有的状态，创建之后由 AsyncLogging 持有
+	 * busy 只有在后端收集未写满的缓冲区的时候才会发生竞争
+	 * 线程退出的时候设置 exited，后端收集完它最后的日志之后释放，参考 collectPending()
+	*/
+	struct ThreadState
+	{
+		ThreadState() : tid(0), spare(NULL), exited(new std::atomic<bool>(false)) { busy.clear(); }
+		~ThreadState() { delete spare.load(); }
+
+		pid_t						tid;
+		std::atomic_flag			busy;
+		ThreadBufferPtr				current;
+		std::atomic<ThreadBuffer*>	spare;	/*后端归还的空缓冲区*/
+		std::shared_ptr<std::atomic<bool> >	exited;	/*线程退出的回调也持有一份，AsyncLogging 可能先析构*/
+	};
+
+	void appendPerThread(const char* logline, int len);
+	ThreadState* threadState();
+	void pushPending(ThreadBuffer* buffer);
+	void collectPending(ThreadBufferVector* buffers, ThreadBufferVector* freeBuffers);
+	void refillSpares(ThreadBufferVector* freeBuffers);
+	void writeMerged(LogFile& output, ThreadBufferVector& buffers, Buffer* merged);
+	void threadFuncPerThread();
+
 	const int flushInterval_;
 	std::atomic<bool> running_;
 	const string basename_;
 	const off_t rollSize_;
+	const Option option_;
+	const uint64_t id_;	/*进程内不重复，参考 threadState()*/
 	muduo::Thread thread_;
 	muduo::CountDownLatch latch_;
 	muduo::MutexLock mutex_;
@@ -62,10 +125,14 @@ private:
 	BufferPtr currentBuffer_ 	GUARDED_BY(mutex_);
 	BufferPtr nextBuffer_ 		GUARDED_BY(mutex_);
 	BufferVector buffers_ 		GUARDED_BY(mutex_);
+
+	std::vector<std::unique_ptr<ThreadState> > threadStates_ GUARDED_BY(mutex_);	/*只有还在运行的线程*/
+	std::atomic<ThreadBuffer*> pending_;	/*前端写满的缓冲区，多生产者单消费者*/
+	std::atomic<int64_t> droppedBuffers_;
 };
 
 } // namespace muduo
 
 
 
-#endif
\ No newline at end of file
+#endif
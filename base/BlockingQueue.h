@@ -5,7 +5,9 @@
 #include "base/Condition.h"
 #include "base/Mutex.h"
 
+#include <algorithm>
 #include <deque>
+#include <vector>
 #include <assert.h>
 
 /**
@@ -20,7 +22,7 @@ class BlockingQueue : noncopyable
 public:
 	BlockingQueue()
 		: mutex_(),
-		  notEmpty_(mutex_);
+		  notEmpty_(mutex_),
 		  queue_()
 	{}
 
@@ -52,6 +54,46 @@ public:
 		return front;
 	}
 
+	/**
+	 * 下面两个函数一次取出多个元素，消费者每次唤醒只需要加一次锁
+	 * takeAll(): 阻塞到队列不为空，取出队列中所有的元素，和 BoundedBlockingQueue::takeAll() 一样返回 std::vector
+	 * 持有锁的时候只交换队列，放入 vector 在锁外面进行
+	 * drainTo(): 阻塞到队列不为空，最多取出 maxItems 个追加到 out 的后面，返回取出的个数
+	*/
+	std::vector<T> takeAll()
+	{
+		std::deque<T> taken;
+		{
+			MutexLockGuard lock(mutex_);
+			while (queue_.empty())
+			{
+				notEmpty_.wait();
+			}
+			taken.swap(queue_);
+		}
+		std::vector<T> items;
+		items.reserve(taken.size());
+		for (T& x : taken)
+			items.push_back(std::move(x));
+		return items;
+	}
+
+	size_t drainTo(std::vector<T>* out, size_t maxItems)
+	{
+		MutexLockGuard lock(mutex_);
+		while (queue_.empty())
+		{
+			notEmpty_.wait();
+		}
+		size_t n = std::min(maxItems, queue_.size());
+		for (size_t i = 0; i < n; ++i)
+		{
+			out->push_back(std::move(queue_.front()));
+			queue_.pop_front();
+		}
+		return n;
+	}
+
 	size_t size() const
 	{
 		MutexLockGuard lock(mutex_);
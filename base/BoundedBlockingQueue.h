@@ -5,6 +5,8 @@
 #include "base/Condition.h"
 
 #include <boost/circular_buffer.hpp>
+#include <algorithm>
+#include <vector>
 #include <assert.h>
 
 /**
@@ -66,6 +68,33 @@ public:
 		return front;
 	}
 
+	/**
+	 * 和 BlockingQueue 一样，一次取出多个元素，空出了多个位置，所以唤醒所有的生产者
+	*/
+	std::vector<T> takeAll()
+	{
+		std::vector<T> items;
+		drainTo(&items, static_cast<size_t>(-1));
+		return items;
+	}
+
+	size_t drainTo(std::vector<T>* out, size_t maxItems)
+	{
+		MutexLockGuard lock(mutex_);
+		while (queue_.empty())
+		{
+			notEmpty_.wait();
+		}
+		size_t n = std::min(maxItems, queue_.size());
+		for (size_t i = 0; i < n; ++i)
+		{
+			out->push_back(std::move(queue_.front()));
+			queue_.pop_front();
+		}
+		notFull_.notify_all();
+		return n;
+	}
+
 	bool empty() const
 	{
 		MutexLockGuard lock(mutex_);
@@ -0,0 +1,171 @@
+#include "base/CpuPlacement.h"
+#include "base/Logging.h"
+
+#include <algorithm>
+
+#include <dirent.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace muduo;
+
+namespace
+{
+
+/*读取 /sys 中只有一行的文件*/
+bool readLine(const string& path, string* line)
+{
+	FILE* fp = ::fopen(path.c_str(), "re");
+	if (fp == NULL)
+		return false;
+	char buf[4096];
+	bool ok = ::fgets(buf, sizeof buf, fp) != NULL;
+	::fclose(fp);
+	if (ok)
+	{
+		line->assign(buf);
+		while (!line->empty() && (line->back() == '\n' || line->back() == ' '))
+			line->pop_back();
+	}
+	return ok;
+}
+
+std::vector<int> allCpus()
+{
+	std::vector<int> cpus;
+	long n = ::sysconf(_SC_NPROCESSORS_ONLN);
+	for (long i = 0; i < n; ++i)
+		cpus.push_back(static_cast<int>(i));
+	return cpus;
+}
+
+}
+
+CpuPlacement CpuPlacement::cpuList(const std::vector<int>& cpus)
+{
+	CpuPlacement placement;
+	if (!cpus.empty())
+	{
+		placement.policy_ = kCpuList;
+		placement.cpus_ = cpus;
+	}
+	return placement;
+}
+
+CpuPlacement CpuPlacement::cpuList(const string& list)
+{
+	std::vector<int> cpus;
+	if (!parseCpuList(list, &cpus))
+	{
+		LOG_ERROR << "CpuPlacement::cpuList invalid cpu list \"" << list << "\"";
+		return CpuPlacement();
+	}
+	return cpuList(cpus);
+}
+
+CpuPlacement CpuPlacement::spreadNodes()
+{
+	CpuPlacement placement;
+	placement.policy_ = kSpreadNodes;
+	placement.nodes_ = numaNodes();
+	return placement;
+}
+
+std::vector<int> CpuPlacement::cpusFor(int index) const
+{
+	std::vector<int> cpus;
+	if (policy_ == kCpuList)
+		cpus.push_back(cpus_[index % cpus_.size()]);
+	else if (policy_ == kSpreadNodes && !nodes_.empty())
+		cpus = nodes_[index % nodes_.size()];
+	return cpus;
+}
+
+bool CpuPlacement::bindCurrentThread(const std::vector<int>& cpus)
+{
+	if (cpus.empty())
+		return true;
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (int cpu : cpus)
+	{
+		if (cpu >= 0 && cpu < CPU_SETSIZE)
+			CPU_SET(cpu, &set);
+	}
+	int err = ::pthread_setaffinity_np(::pthread_self(), sizeof set, &set);
+	if (err != 0)
+	{
+		errno = err;
+		LOG_SYSERR << "CpuPlacement::bindCurrentThread";
+		return false;
+	}
+	return true;
+}
+
+/**
+ * 节点的编号可能不连续 (node0, node2)，按照编号排序，只保留有 CPU 的节点
+*/
+std::vector<std::vector<int> > CpuPlacement::numaNodes()
+{
+	std::vector<std::pair<int, std::vector<int> > > found;
+	const char* kNodeDir = "/sys/devices/system/node";
+	DIR* dir = ::opendir(kNodeDir);
+	if (dir != NULL)
+	{
+		while (struct dirent* entry = ::readdir(dir))
+		{
+			int node;
+			char extra;
+			if (::sscanf(entry->d_name, "node%d%c", &node, &extra) != 1)
+				continue;
+			string line;
+			std::vector<int> cpus;
+			if (readLine(string(kNodeDir) + "/" + entry->d_name + "/cpulist", &line)
+				&& parseCpuList(line, &cpus) && !cpus.empty())
+				found.push_back(std::make_pair(node, cpus));
+		}
+		::closedir(dir);
+	}
+	std::sort(found.begin(), found.end());
+
+	std::vector<std::vector<int> > nodes;
+	for (auto& node : found)
+		nodes.push_back(node.second);
+	if (nodes.empty())
+		nodes.push_back(allCpus());
+	return nodes;
+}
+
+bool CpuPlacement::parseCpuList(const string& list, std::vector<int>* cpus)
+{
+	const char* p = list.c_str();
+	while (*p != '\0')
+	{
+		char* end;
+		long first = ::strtol(p, &end, 10);
+		if (end == p || first < 0)
+			return false;
+		long last = first;
+		p = end;
+		if (*p == '-')
+		{
+			++p;
+			last = ::strtol(p, &end, 10);
+			if (end == p || last < first)
+				return false;
+			p = end;
+		}
+		for (long cpu = first; cpu <= last; ++cpu)
+			cpus->push_back(static_cast<int>(cpu));
+		if (*p == ',')
+			++p;
+		else if (*p != '\0')
+			return false;
+	}
+	return true;
+}
@@ -0,0 +1,55 @@
+#ifndef MUDUO_BASE_CPUPLACEMENT_H
+#define MUDUO_BASE_CPUPLACEMENT_H
+
+#include "base/copyable.h"
+#include "base/Types.h"
+
+#include <vector>
+
+namespace muduo
+{
+
+/**
+ * 线程池中第 i 个线程允许在哪些 CPU 上运行
+ *
+ * 默认不限制，线程可能在 NUMA 节点之间迁移，它的 Buffer 等内存留在原来的节点上，之后的访问都是远程的
+ * cpuList():     第 i 个线程绑定到列表中的第 i % n 个 CPU 上
+ * spreadNodes(): 第 i 个线程绑定到第 i % nodes 个 NUMA 节点的所有 CPU 上，线程依次分散到各个节点
+ *
+ * 绑定在线程函数开始之前完成，Linux 默认在第一次访问的 CPU 所在的节点上分配物理页，
+ * 所以线程中创建的 EventLoop 和它的 BufferPool 都在本地节点上。TcpConnection 的 Buffer 在
+ * connectEstablished() 中从所在 io loop 的 BufferPool 申请，也是本地的 (参考 CpuPlacement_test)
+*/
+class CpuPlacement : public copyable
+{
+public:
+	CpuPlacement() : policy_(kNone) {}
+
+	static CpuPlacement cpuList(const std::vector<int>& cpus);
+	/*"0-3,8,10-11" 的格式，和 taskset -c 以及 /sys 中的 cpulist 一样，格式错误的时候返回不限制的*/
+	static CpuPlacement cpuList(const string& list);
+	static CpuPlacement spreadNodes();
+
+	bool enabled() const { return policy_ != kNone; }
+
+	/*第 index 个线程可以使用的 CPU，空的表示不限制*/
+	std::vector<int> cpusFor(int index) const;
+
+	/*把当前线程绑定到 cpus 上，失败的时候记录日志并返回 false*/
+	static bool bindCurrentThread(const std::vector<int>& cpus);
+
+	/*从 /sys/devices/system/node 读取每一个 NUMA 节点的 CPU，没有 NUMA 信息的时候所有 CPU 是一个节点*/
+	static std::vector<std::vector<int> > numaNodes();
+	static bool parseCpuList(const string& list, std::vector<int>* cpus);
+
+private:
+	enum Policy { kNone, kCpuList, kSpreadNodes };
+
+	Policy policy_;
+	std::vector<int> cpus_;
+	std::vector<std::vector<int> > nodes_;
+};
+
+} // namespace muduo
+
+#endif
@@ -0,0 +1,60 @@
+#include "base/FileUtil.h"
+#include "base/Logging.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+
+using namespace muduo;
+
+FileUtil::AppendFile::AppendFile(StringArg filename)
+	:	fp_(::fopen(filename.c_str(), "ae")),	// 'e' for O_CLOEXEC
+		writtenBytes_(0)
+{
+	assert(fp_);
+	::setbuffer(fp_, buffer_, sizeof buffer_);
+	/**
+	 * 用我们自己的缓冲区替换 stdio 默认的缓冲区，fflush() 之前数据都保存在 buffer_ 当中
+	*/
+}
+
+FileUtil::AppendFile::~AppendFile()
+{
+	::fclose(fp_);
+}
+
+void FileUtil::AppendFile::append(const char* logline, const size_t len)
+{
+	size_t written = 0;
+
+	while (written != len)
+	{
+		size_t remain = len - written;
+		size_t n = write(logline + written, remain);
+		if (n != remain)
+		{
+			int err = ferror(fp_);
+			if (err)
+			{
+				fprintf(stderr, "AppendFile::append() failed %s\n", strerror_tl(err));
+				break;
+			}
+		}
+		written += n;
+	}
+
+	writtenBytes_ += written;
+}
+
+void FileUtil::AppendFile::flush()
+{
+	::fflush(fp_);
+}
+
+size_t FileUtil::AppendFile::write(const char* logline, size_t len)
+{
+	/**
+	 * 只有后台的日志线程会写这个文件，所以不需要 stdio 内部的锁
+	*/
+	return ::fwrite_unlocked(logline, 1, len, fp_);
+}
@@ -0,0 +1,45 @@
+#ifndef MUDUO_BASE_FILEUTIL_H
+#define MUDUO_BASE_FILEUTIL_H
+
+#include "base/noncopyable.h"
+#include "base/StringPiece.h"
+
+#include <stdio.h>
+#include <sys/types.h>  // for off_t
+
+namespace muduo
+{
+namespace FileUtil
+{
+
+/**
+ * 以追加的方式写文件，非线程安全
+ * 使用了一个 64KB 的用户态缓冲区，配合 fwrite_unlocked() 减少系统调用的次数
+*/
+class AppendFile : noncopyable
+{
+public:
+	explicit AppendFile(StringArg filename);
+
+	~AppendFile();
+
+	void append(const char* logline, size_t len);
+
+	void flush();
+
+	off_t writtenBytes() const { return writtenBytes_; }
+
+private:
+	size_t write(const char* logline, size_t len);
+
+	FILE*	fp_;
+	char	buffer_[64*1024];
+	off_t	writtenBytes_;	/*已经写入文件的字节数，LogFile 根据这个值来决定是否滚动文件*/
+};
+
+} // namespace FileUtil
+
+} // namespace muduo
+
+
+#endif
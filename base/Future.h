@@ -0,0 +1,220 @@
+#ifndef MUDUO_BASE_FUTURE_H
+#define MUDUO_BASE_FUTURE_H
+
+#include "base/noncopyable.h"
+#include "base/WeakCallback.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <assert.h>
+
+namespace muduo
+{
+
+/**
+ * ThreadPool::submit() 返回的 Future，只有一个结果和一个后续操作 (then)
+ *
+ *   pool.submit(std::bind(handleRequest, request))
+ *       .then(conn->getLoop(), WeakCallback<TcpConnection, string>(conn, sendResponse));
+ *
+ * then(loop, cb) 在 loop 线程中调用 cb(result)，loop 是任何有 runInLoop() 的类型，通常是 EventLoop
+ * 结果和 then() 谁后到达，谁负责把 cb 交给 loop，不需要加锁，也不会阻塞任何线程
+ *
+ * 取消：cancel()，或者 then() 的 WeakCallback 指向的对象（例如 TcpConnection）已经析构
+ * 线程池还没有开始执行的任务直接跳过，已经开始的结果被丢弃，cb 不会被调用
+ * 线程池 stop() 的时候丢弃的任务不会完成，cb 也不会被调用
+*/
+template <typename T>
+class Future;
+
+namespace detail
+{
+
+struct Unit {};
+
+/*void 的结果用 Unit 保存，cb 没有参数*/
+template <typename T>
+struct FutureTraits
+{
+	typedef T Value;
+	typedef std::function<void (T)> Callback;
+
+	template <typename F>
+	static Value produce(F& f) { return f(); }
+	static void invoke(const Callback& cb, Value& value) { cb(std::move(value)); }
+};
+
+template <>
+struct FutureTraits<void>
+{
+	typedef Unit Value;
+	typedef std::function<void ()> Callback;
+
+	template <typename F>
+	static Value produce(F& f) { f(); return Unit(); }
+	static void invoke(const Callback& cb, Value&) { cb(); }
+};
+
+template <typename T>
+class FutureState : noncopyable,
+					public std::enable_shared_from_this<FutureState<T> >
+{
+public:
+	typedef FutureTraits<T> Traits;
+	typedef typename Traits::Value Value;
+	typedef typename Traits::Callback Callback;
+	/*把 deliver() 交给 loop，loop 的类型在 then() 中才知道*/
+	typedef void (*Post)(void* loop, const std::shared_ptr<FutureState>& state);
+
+	FutureState()
+		: flags_(0), cancelled_(false), loop_(NULL), post_(NULL), guarded_(false)
+	{}
+
+	~FutureState()
+	{
+		if (flags_.load(std::memory_order_acquire) & kHasValue)
+			value().~Value();
+	}
+
+	/*在线程池中执行*/
+	template <typename F>
+	void run(F& f)
+	{
+		if (cancelled())
+			return;
+		new (&storage_) Value(Traits::produce(f));
+		publish(kHasValue);
+	}
+
+	/*guard 必须在 setContinuation() 之前设置，设置之后线程池可以通过 cancelled() 读取*/
+	void setGuard(const std::weak_ptr<void>& guard)
+	{
+		guard_ = guard;
+		guarded_ = true;
+	}
+
+	void setContinuation(void* loop, Post post, Callback cb)
+	{
+		assert(!(flags_.load(std::memory_order_relaxed) & kHasContinuation));
+		loop_ = loop;
+		post_ = post;
+		callback_ = std::move(cb);
+		publish(kHasContinuation);
+	}
+
+	/*在 loop 线程中执行*/
+	void deliver()
+	{
+		if (!cancelled())
+			Traits::invoke(callback_, value());
+	}
+
+	void cancel() { cancelled_.store(true, std::memory_order_relaxed); }
+
+	bool cancelled() const
+	{
+		if (cancelled_.load(std::memory_order_relaxed))
+			return true;
+		return (flags_.load(std::memory_order_acquire) & kHasContinuation) && guarded_ && guard_.expired();
+	}
+
+	bool ready() const { return flags_.load(std::memory_order_acquire) & kHasValue; }
+
+private:
+	enum { kHasValue = 1, kHasContinuation = 2 };
+
+	Value& value() { return *reinterpret_cast<Value*>(&storage_); }
+
+	/*结果和后续操作都到了之后，后到的一方交给 loop，只会有一次*/
+	void publish(int flag)
+	{
+		int prev = flags_.fetch_or(flag, std::memory_order_acq_rel);
+		if ((prev | flag) == (kHasValue | kHasContinuation))
+			post_(loop_, this->shared_from_this());
+	}
+
+	typename std::aligned_storage<sizeof(Value), alignof(Value)>::type storage_;
+	std::atomic<int> flags_;
+	std::atomic<bool> cancelled_;
+	void* loop_;
+	Post post_;
+	Callback callback_;
+	std::weak_ptr<void> guard_;
+	bool guarded_;
+};
+
+/**
+ * ThreadPool 和 WorkStealingThreadPool 的 submit() 共用
+ * 任务是 std::function，所以 f 必须可以复制
+*/
+template <typename Pool, typename F>
+Future<typename std::result_of<F()>::type> submitTo(Pool* pool, F f)
+{
+	typedef typename std::result_of<F()>::type R;
+	std::shared_ptr<FutureState<R> > state(std::make_shared<FutureState<R> >());
+	pool->run([state, f]() mutable { state->run(f); });
+	return Future<R>(state);
+}
+
+} // namespace detail
+
+template <typename T>
+class Future
+{
+public:
+	typedef typename detail::FutureTraits<T>::Value Value;
+	typedef typename detail::FutureTraits<T>::Callback Callback;
+
+	Future() {}
+	explicit Future(const std::shared_ptr<detail::FutureState<T> >& state)
+		: state_(state)
+	{}
+
+	bool valid() const { return static_cast<bool>(state_); }
+	bool ready() const { return state_ && state_->ready(); }
+	void cancel() { if (state_) state_->cancel(); }
+
+	/**
+	 * 结果在 loop 线程中交给 cb，每一个 Future 只能调用一次 then()
+	 * 结果已经有了的时候，在 loop 线程中调用 then() 会马上执行 cb
+	*/
+	template <typename Loop>
+	void then(Loop* loop, Callback cb)
+	{
+		assert(state_);
+		state_->setContinuation(loop, &post<Loop>, std::move(cb));
+	}
+
+	/**
+	 * object 析构之后结果被丢弃，还没有开始执行的任务也不再执行
+	*/
+	template <typename Loop, typename CLASS, typename... ARGS>
+	void then(Loop* loop, const WeakCallback<CLASS, ARGS...>& cb)
+	{
+		assert(state_);
+		state_->setGuard(cb.object());
+		state_->setContinuation(loop, &post<Loop>, Callback([cb](ARGS... args) {
+			cb(std::forward<ARGS>(args)...);
+		}));
+	}
+
+private:
+	typedef detail::FutureState<T> State;
+
+	template <typename Loop>
+	static void post(void* loop, const std::shared_ptr<State>& state)
+	{
+		static_cast<Loop*>(loop)->runInLoop([state] { state->deliver(); });
+	}
+
+	std::shared_ptr<State> state_;
+};
+
+} // namespace muduo
+
+#endif
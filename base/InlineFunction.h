@@ -0,0 +1,203 @@
+#ifndef MUDUO_BASE_INLINEFUNCTION_H
+#define MUDUO_BASE_INLINEFUNCTION_H
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <assert.h>
+
+namespace muduo
+{
+
+/**
+ * 只能移动不能复制的 std::function
+ * 不超过 Capacity 字节的可调用对象直接放在对象内部，不需要分配内存，更大的才放到堆上
+ * libstdc++ 的 std::function 只有 16 字节的内部空间，std::bind(&TcpConnection::sendInLoop, this, string)
+ * 这样的对象就需要分配一次
+ *
+ * EventLoop::Functor 和 TimerCallback 都是 InlineFunction<void ()>，这两个回调都只会被调用一次或者
+ * 只在一个地方保存，不需要复制
+*/
+template <typename Signature, size_t Capacity = 64>
+class InlineFunction;
+
+template <typename R, typename... Args, size_t Capacity>
+class InlineFunction<R (Args...), Capacity>
+{
+public:
+	InlineFunction() : ops_(NULL) {}
+	InlineFunction(std::nullptr_t) : ops_(NULL) {}
+
+	template <typename F,
+			  typename = typename std::enable_if<
+				  !std::is_same<typename std::decay<F>::type, InlineFunction>::value>::type>
+	InlineFunction(F&& f)
+		: ops_(NULL)
+	{
+		typedef typename std::decay<F>::type Fn;
+		if (isEmpty(f))
+			return;
+		if (fitsInline<Fn>())
+		{
+			new (&storage_) Fn(std::forward<F>(f));
+			ops_ = &InlineOps<Fn>::ops;
+		}
+		else
+		{
+			*reinterpret_cast<Fn**>(&storage_) = new Fn(std::forward<F>(f));
+			ops_ = &HeapOps<Fn>::ops;
+		}
+	}
+
+	InlineFunction(InlineFunction&& other)
+		: ops_(other.ops_)
+	{
+		if (ops_)
+		{
+			ops_->move(&storage_, &other.storage_);
+			other.ops_ = NULL;
+		}
+	}
+
+	InlineFunction& operator=(InlineFunction&& other)
+	{
+		if (this != &other)
+		{
+			reset();
+			if (other.ops_)
+			{
+				other.ops_->move(&storage_, &other.storage_);
+				ops_ = other.ops_;
+				other.ops_ = NULL;
+			}
+		}
+		return *this;
+	}
+
+	InlineFunction& operator=(std::nullptr_t)
+	{
+		reset();
+		return *this;
+	}
+
+	InlineFunction(const InlineFunction&) = delete;
+	InlineFunction& operator=(const InlineFunction&) = delete;
+
+	~InlineFunction()
+	{
+		reset();
+	}
+
+	explicit operator bool() const { return ops_ != NULL; }
+
+	R operator()(Args... args) const
+	{
+		assert(ops_ != NULL);
+		return ops_->invoke(const_cast<Storage*>(&storage_), std::forward<Args>(args)...);
+	}
+
+	/*可调用对象是否放在内部，没有分配内存*/
+	bool storedInline() const { return ops_ != NULL && ops_->isInline; }
+
+	static const size_t kCapacity = Capacity;
+
+private:
+	typedef typename std::aligned_storage<Capacity, alignof(std::max_align_t)>::type Storage;
+
+	/*每一种可调用对象一个的函数表，代替 std::function 中的虚函数*/
+	struct Ops
+	{
+		R (*invoke)(void* storage, Args&&... args);
+		void (*move)(void* dst, void* src);	/*移动之后 src 中的对象也已经析构*/
+		void (*destroy)(void* storage);
+		bool isInline;
+	};
+
+	template <typename Fn>
+	static constexpr bool fitsInline()
+	{
+		return sizeof(Fn) <= Capacity &&
+			   alignof(Fn) <= alignof(std::max_align_t) &&
+			   std::is_nothrow_move_constructible<Fn>::value;
+	}
+
+	template <typename Fn>
+	struct InlineOps
+	{
+		static R invoke(void* storage, Args&&... args)
+		{
+			return (*static_cast<Fn*>(storage))(std::forward<Args>(args)...);
+		}
+		static void move(void* dst, void* src)
+		{
+			new (dst) Fn(std::move(*static_cast<Fn*>(src)));
+			static_cast<Fn*>(src)->~Fn();
+		}
+		static void destroy(void* storage)
+		{
+			static_cast<Fn*>(storage)->~Fn();
+		}
+		static const Ops ops;
+	};
+
+	template <typename Fn>
+	struct HeapOps
+	{
+		static R invoke(void* storage, Args&&... args)
+		{
+			return (**static_cast<Fn**>(storage))(std::forward<Args>(args)...);
+		}
+		static void move(void* dst, void* src)
+		{
+			*static_cast<Fn**>(dst) = *static_cast<Fn**>(src);
+		}
+		static void destroy(void* storage)
+		{
+			delete *static_cast<Fn**>(storage);
+		}
+		static const Ops ops;
+	};
+
+	/*空的函数指针和 std::function 构造出来的也是空的*/
+	template <typename F>
+	static bool isEmpty(const F&) { return false; }
+	template <typename Ret, typename... Params>
+	static bool isEmpty(Ret (*f)(Params...)) { return f == NULL; }
+	template <typename Sig>
+	static bool isEmpty(const std::function<Sig>& f) { return !f; }
+
+	void reset()
+	{
+		if (ops_)
+		{
+			ops_->destroy(&storage_);
+			ops_ = NULL;
+		}
+	}
+
+	Storage storage_;
+	const Ops* ops_;
+};
+
+template <typename R, typename... Args, size_t Capacity>
+template <typename Fn>
+const typename InlineFunction<R (Args...), Capacity>::Ops
+InlineFunction<R (Args...), Capacity>::InlineOps<Fn>::ops =
+{
+	&InlineOps<Fn>::invoke, &InlineOps<Fn>::move, &InlineOps<Fn>::destroy, true
+};
+
+template <typename R, typename... Args, size_t Capacity>
+template <typename Fn>
+const typename InlineFunction<R (Args...), Capacity>::Ops
+InlineFunction<R (Args...), Capacity>::HeapOps<Fn>::ops =
+{
+	&HeapOps<Fn>::invoke, &HeapOps<Fn>::move, &HeapOps<Fn>::destroy, false
+};
+
+} // namespace muduo
+
+#endif
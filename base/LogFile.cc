@@ -0,0 +1,142 @@
+#include "base/LogFile.h"
+
+#include "base/FileUtil.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace muduo;
+
+LogFile::LogFile(const string& basename,
+				 off_t rollSize,
+				 bool threadSafe,
+				 int flushInterval,
+				 int checkEveryN)
+	:	basename_(basename),
+		rollSize_(rollSize),
+		flushInterval_(flushInterval),
+		checkEveryN_(checkEveryN),
+		count_(0),
+		mutex_(threadSafe ? new MutexLock : NULL),
+		startOfPeriod_(0),
+		lastRoll_(0),
+		lastFlush_(0)
+{
+	assert(basename.find('/') == string::npos);	/*basename 不可以带有路径*/
+	rollFile();
+}
+
+LogFile::~LogFile() = default;
+
+void LogFile::append(const char* logline, int len)
+{
+	if (mutex_)
+	{
+		MutexLockGuard lock(*mutex_);
+		append_unlocked(logline, len);
+	}
+	else
+	{
+		append_unlocked(logline, len);
+	}
+}
+
+void LogFile::flush()
+{
+	if (mutex_)
+	{
+		MutexLockGuard lock(*mutex_);
+		file_->flush();
+	}
+	else
+	{
+		file_->flush();
+	}
+}
+
+void LogFile::append_unlocked(const char* logline, int len)
+{
+	file_->append(logline, len);
+
+	if (file_->writtenBytes() > rollSize_)
+	{
+		rollFile();
+	}
+	else
+	{
+		++count_;
+		if (count_ >= checkEveryN_)
+		{
+			/**
+			 * 每一次 append 都去调用 ::time() 代价太大，所以每 checkEveryN_ 次才检查一次
+			*/
+			count_ = 0;
+			time_t now = ::time(NULL);
+			time_t thisPeriod = now / kRollPerSeconds_ * kRollPerSeconds_;
+			if (thisPeriod != startOfPeriod_)
+			{
+				rollFile();
+			}
+			else if (now - lastFlush_ > flushInterval_)
+			{
+				lastFlush_ = now;
+				file_->flush();
+			}
+		}
+	}
+}
+
+bool LogFile::rollFile()
+{
+	time_t now = 0;
+	string filename = getLogFileName(basename_, &now);
+	time_t start = now / kRollPerSeconds_ * kRollPerSeconds_;
+
+	/**
+	 * 文件名精确到秒，同一秒之内不重复滚动，否则会打开同一个文件
+	*/
+	if (now > lastRoll_)
+	{
+		lastRoll_ = now;
+		lastFlush_ = now;
+		startOfPeriod_ = start;
+		file_.reset(new FileUtil::AppendFile(filename));
+		return true;
+	}
+	return false;
+}
+
+string LogFile::getLogFileName(const string& basename, time_t* now)
+{
+	string filename;
+	filename.reserve(basename.size() + 64);
+	filename = basename;
+
+	char timebuf[32];
+	struct tm tm;
+	*now = time(NULL);
+	gmtime_r(now, &tm); // FIXME: localtime_r ?
+	strftime(timebuf, sizeof timebuf, ".%Y%m%d-%H%M%S.", &tm);
+	filename += timebuf;
+
+	char hostbuf[256];
+	if (::gethostname(hostbuf, sizeof hostbuf) == 0)
+	{
+		hostbuf[sizeof(hostbuf)-1] = '\0';
+		filename += hostbuf;
+	}
+	else
+	{
+		filename += "unknownhost";
+	}
+
+	char pidbuf[32];
+	snprintf(pidbuf, sizeof pidbuf, ".%d", ::getpid());
+	filename += pidbuf;
+
+	filename += ".log";
+
+	return filename;
+}
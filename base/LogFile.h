@@ -0,0 +1,61 @@
+#ifndef MUDUO_BASE_LOGFILE_H
+#define MUDUO_BASE_LOGFILE_H
+
+#include "base/Mutex.h"
+#include "base/Types.h"
+
+#include <memory>
+
+namespace muduo
+{
+
+namespace FileUtil
+{
+class AppendFile;
+}
+
+/**
+ * 滚动日志文件
+ * 1. 写入的字节数超过 rollSize 之后，创建一个新的日志文件
+ * 2. 跨过了一天的边界（UTC 零点），创建一个新的日志文件
+ * 日志文件的名称为 basename.YYYYmmdd-HHMMSS.hostname.pid.log
+*/
+class LogFile : noncopyable
+{
+public:
+	LogFile(const string& basename,
+			off_t rollSize,
+			bool threadSafe = true,
+			int flushInterval = 3,
+			int checkEveryN = 1024);
+	~LogFile();
+
+	void append(const char* logline, int len);
+	void flush();
+	bool rollFile();
+
+private:
+	void append_unlocked(const char* logline, int len);
+
+	static string getLogFileName(const string& basename, time_t* now);
+
+	const string	basename_;
+	const off_t		rollSize_;
+	const int		flushInterval_;
+	const int		checkEveryN_;	/*每 append checkEveryN_ 次，检查一次是否需要 flush 或者滚动*/
+
+	int count_;
+
+	std::unique_ptr<MutexLock> mutex_;	/*只有后台线程写文件的时候，不需要上锁*/
+	time_t startOfPeriod_;	/*当前日志文件所属的那一天的零点*/
+	time_t lastRoll_;
+	time_t lastFlush_;
+	std::unique_ptr<FileUtil::AppendFile> file_;
+
+	const static int kRollPerSeconds_ = 60*60*24;
+};
+
+} // namespace muduo
+
+
+#endif
@@ -88,6 +88,7 @@ size_t convertHex(char buf[], uintptr_t value)
 */
 template class FixedBuffer<kSmallBuffer>;
 template class FixedBuffer<kLargeBuffer>;
+template class FixedBuffer<kThreadBuffer>;
 }   // namespace detail
 
 /*
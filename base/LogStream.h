@@ -15,6 +15,7 @@ namespace detail
 
 const int kSmallBuffer = 4000;
 const int kLargeBuffer = 4000 * 1000;
+const int kThreadBuffer = 4000 * 16;	/*AsyncLogging 每一个线程私有的缓冲区大小*/
 
 /**
  * 一个固定大小的 Buffer
@@ -17,6 +17,7 @@ namespace muduo
 __thread char t_errnobuf[512];
 __thread char t_time[64];
 __thread time_t t_lastSecond;
+__thread int64_t t_outputTime;	/*正在交给 g_output 的日志的时间，参考 Logger::outputTime()*/
 
 const char* strerror_tl(int savedErrno)
 {
@@ -198,7 +199,9 @@ Logger::~Logger()
 {
 	impl_.finish();
 	const LogStream::Buffer& buf(stream().buffer());
+	t_outputTime = impl_.time_.microSecondsSinceEpoch();
 	g_output(buf.data(), buf.length());		/*默认从控制台输出 buf 中的信息*/
+	t_outputTime = 0;
 	if (impl_.level_ == FATAL)	// 如果等级为致命错误，终止程序
 	{
 		g_flush();
@@ -206,6 +209,11 @@ Logger::~Logger()
 	}
 }
 
+Timestamp Logger::outputTime()
+{
+	return Timestamp(t_outputTime);
+}
+
 void Logger::setLogLevel(Logger::LogLevel level)
 {
   	g_logLevel = level;
@@ -78,6 +78,10 @@ public:
 	static void setFlush(FlushFunc);
 	static void setTimeZone(const TimeZone& tz);
 
+	/// 在 OutputFunc 中调用，返回正在输出的这一条日志的时间，不用再取一次当前时间
+	/// 不是从 Logger 输出的时候返回 Timestamp::invalid()
+	static Timestamp outputTime();
+
 private:
 	class Impl{
 	public:
@@ -0,0 +1,273 @@
+#ifndef MUDUO_BASE_MPMCRINGQUEUE_H
+#define MUDUO_BASE_MPMCRINGQUEUE_H
+
+#include "base/Condition.h"
+#include "base/Mutex.h"
+#include "base/Timestamp.h"
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <assert.h>
+#include <sched.h>
+
+namespace muduo
+{
+
+/**
+ * 有界的多生产者多消费者无锁队列 (Dmitry Vyukov 的 bounded MPMC queue)，可以代替 BoundedBlockingQueue
+ *
+ * 每一个格子有一个序号 sequence：等于 2 * pos 表示空的，可以写入第 pos 个元素；等于 2 * pos + 1 表示第 pos 个元素已经写好
+ * (原始的算法用 pos 和 pos + 1，容量为 1 的时候第 0 个元素写好和第 1 个元素可以写入无法区分)
+ * 生产者和消费者各自用一次 CAS 抢占 enqueuePos_ / dequeuePos_，之后只访问自己的格子，不需要加锁
+ *
+ * tryPut() / tryTake() 不会阻塞，put() / take() 先自旋一会儿，之后才在条件变量上等待
+ * 只有有线程在等待的时候，另一边才需要加锁唤醒，队列不空不满的时候没有任何系统调用
+ *
+ * close() 之后 put 系列返回 false，队列中剩下的元素还可以取出，取完之后阻塞的 take() 返回
+*/
+template <typename T>
+class MpmcRingQueue : noncopyable
+{
+public:
+	explicit MpmcRingQueue(size_t capacity)
+		: capacity_(capacity > 0 ? capacity : 1),
+		  cells_(new Cell[capacity_]),
+		  enqueuePos_(0),
+		  dequeuePos_(0),
+		  closed_(false),
+		  mutex_(),
+		  notEmpty_(mutex_),
+		  notFull_(mutex_),
+		  takeWaiters_(0),
+		  putWaiters_(0)
+	{
+		for (size_t i = 0; i < capacity_; ++i)
+			cells_[i].sequence.store(2 * i, std::memory_order_relaxed);
+	}
+
+	~MpmcRingQueue()
+	{
+		T x;
+		while (dequeue(&x))
+		{
+		}
+	}
+
+	bool tryPut(const T& x) { return enqueue(x) && wakeOne(takeWaiters_, notEmpty_); }
+	bool tryPut(T&& x) { return enqueue(std::move(x)) && wakeOne(takeWaiters_, notEmpty_); }
+	bool tryTake(T* x) { return dequeue(x) && wakeOne(putWaiters_, notFull_); }
+
+	/*队列满的时候阻塞，close() 之后返回 false，x 被丢弃*/
+	bool put(T x) { return putFor(std::move(x), -1); }
+
+	/*队列为空的时候阻塞，close() 之后并且队列为空的时候返回 T()*/
+	T take()
+	{
+		T x = T();
+		takeFor(&x, -1);
+		return x;
+	}
+
+	/*seconds < 0 表示一直等待。超时或者 close() 返回 false*/
+	bool putFor(T x, double seconds)
+	{
+		if (closed())
+			return false;
+		return wait([this, &x] { return enqueue(std::move(x)); },
+					putWaiters_, notFull_, seconds, false)
+			&& wakeOne(takeWaiters_, notEmpty_);
+	}
+
+	bool takeFor(T* x, double seconds)
+	{
+		return wait([this, x] { return dequeue(x); },
+					takeWaiters_, notEmpty_, seconds, true)
+			&& wakeOne(putWaiters_, notFull_);
+	}
+
+	/*唤醒所有等待的线程，之后不能再 put*/
+	void close()
+	{
+		MutexLockGuard lock(mutex_);
+		closed_.store(true);
+		notEmpty_.notify_all();
+		notFull_.notify_all();
+	}
+
+	bool closed() const { return closed_.load(std::memory_order_relaxed); }
+
+	/*近似值，多线程同时操作的时候只能作为参考*/
+	size_t size() const
+	{
+		size_t enq = enqueuePos_.load(std::memory_order_relaxed);
+		size_t deq = dequeuePos_.load(std::memory_order_relaxed);
+		return enq > deq ? enq - deq : 0;
+	}
+
+	bool empty() const { return size() == 0; }
+	bool full() const { return size() >= capacity_; }
+	size_t capacity() const { return capacity_; }
+
+private:
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+
+		T* value() { return reinterpret_cast<T*>(&storage); }
+	};
+
+	/*下面两个函数只修改队列，不唤醒等待的线程，在 mutex_ 中也可以调用*/
+	bool dequeue(T* x)
+	{
+		size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+		Cell* cell;
+		for (;;)
+		{
+			cell = &cells_[pos % capacity_];
+			size_t seq = cell->sequence.load(std::memory_order_acquire);
+			intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(2 * pos + 1);
+			if (diff == 0)
+			{
+				if (dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+			{
+				return false;	/*空的*/
+			}
+			else
+			{
+				pos = dequeuePos_.load(std::memory_order_relaxed);
+			}
+		}
+		T* value = cell->value();
+		*x = std::move(*value);
+		value->~T();
+		/*这个格子下一次用来存放第 pos + capacity_ 个元素*/
+		cell->sequence.store(2 * (pos + capacity_), std::memory_order_release);
+		return true;
+	}
+
+	/*参数 x 可能是右值，只有抢到格子之后才 move*/
+	template <typename U>
+	bool enqueue(U&& x)
+	{
+		size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+		Cell* cell;
+		for (;;)
+		{
+			cell = &cells_[pos % capacity_];
+			size_t seq = cell->sequence.load(std::memory_order_acquire);
+			intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(2 * pos);
+			if (diff == 0)
+			{
+				if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+			{
+				return false;	/*满的*/
+			}
+			else
+			{
+				pos = enqueuePos_.load(std::memory_order_relaxed);
+			}
+		}
+		new (cell->value()) T(std::forward<U>(x));
+		cell->sequence.store(2 * pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * 等待的一方先增加 waiters 再重试，成功的一方先修改 sequence 再检查 waiters，两边之间都有 seq_cst 的 fence，
+	 * 至少有一边能看到另一边。重试和 wait() 都在 mutex_ 中，唤醒也要先拿到 mutex_，不会丢失唤醒
+	 * 总是返回 true，方便写在 && 后面
+	*/
+	bool wakeOne(std::atomic<int>& waiters, Condition& cond)
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (waiters.load(std::memory_order_relaxed) > 0)
+		{
+			MutexLockGuard lock(mutex_);
+			cond.notify();
+		}
+		return true;
+	}
+
+	/*drainOnClose: take 在 close() 之后还要把队列中剩下的取完*/
+	template <typename Op>
+	bool wait(Op op, std::atomic<int>& waiters, Condition& cond, double seconds, bool drainOnClose)
+	{
+		for (int i = 0; i < kSpins; ++i)
+		{
+			if (op())
+				return true;
+			if (closed())
+				return drainOnClose && op();
+			sched_yield();
+		}
+
+		Timestamp deadline(seconds >= 0 ? addTime(Timestamp::now(), seconds) : Timestamp::invalid());
+		MutexLockGuard lock(mutex_);
+		waiters.fetch_add(1);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		bool ok = false;
+		for (;;)
+		{
+			if (op())
+			{
+				ok = true;
+				break;
+			}
+			if (closed())
+			{
+				ok = drainOnClose && op();
+				break;
+			}
+			if (deadline.valid())
+			{
+				double remaining = timeDifference(deadline, Timestamp::now());
+				if (remaining <= 0)
+					break;
+				cond.waitForSeconds(remaining);
+			}
+			else
+			{
+				cond.wait();
+			}
+		}
+		waiters.fetch_sub(1);
+		return ok;
+	}
+
+	static const int kSpins = 16;
+
+	const size_t capacity_;
+	std::unique_ptr<Cell[]> cells_;
+	/**
+	 * 生产者和消费者各自修改一个位置，和每次都要读的 cells_ 一起用 pad 隔开，放在不同的 cache line 上
+	 * 不用 alignas(64)，ThreadPool 中的队列是 new 出来的，C++11 的 new 不保证超过 16 字节的对齐
+	*/
+	char pad0_[64];
+	std::atomic<size_t> enqueuePos_;
+	char pad1_[64 - sizeof(std::atomic<size_t>)];
+	std::atomic<size_t> dequeuePos_;
+	char pad2_[64 - sizeof(std::atomic<size_t>)];
+	std::atomic<bool> closed_;
+
+	/*只用于阻塞和唤醒*/
+	MutexLock mutex_;
+	Condition notEmpty_;
+	Condition notFull_;
+	std::atomic<int> takeWaiters_;
+	std::atomic<int> putWaiters_;
+};
+
+} // namespace muduo
+
+#endif
@@ -0,0 +1,180 @@
+#ifndef MUDUO_BASE_MPSCQUEUE_H
+#define MUDUO_BASE_MPSCQUEUE_H
+
+#include "base/noncopyable.h"
+
+#include <atomic>
+#include <utility>
+
+#include <assert.h>
+#include <sched.h>
+
+namespace muduo
+{
+
+/**
+ * 多生产者单消费者的无锁队列 (Dmitry Vyukov 的 MPSC 链表队列)
+ * 这里不是侵入式的，每一个元素放在队列自己的节点中，push() 只有一次 exchange，生产者之间不需要加锁
+ * consume() / consumeAll() 只能在一个线程（消费者）中调用
+ *
+ * 消费者用完的节点放入空闲链表，生产者优先从这里取，不用每次 push() 都 new 一个节点
+ * 空闲链表同一时刻只有一个生产者在取（其他生产者这个时候直接 new），消费者只放回，所以没有 ABA 问题
+ *
+ * 生产者先 exchange head_，再把前一个节点的 next 指向自己，两步之间消费者看到的链表是断开的
+ * 这个时候消费者只要等一下就可以了，参考 consumeAll()
+*/
+template <typename T>
+class MpscQueue : noncopyable
+{
+public:
+	MpscQueue()
+		: head_(new Node),
+		  size_(0),
+		  tail_(head_.load(std::memory_order_relaxed)),
+		  freeNodes_(NULL),
+		  numFreeNodes_(0),
+		  freeLock_(false)
+	{}
+
+	~MpscQueue()
+	{
+		deleteList(tail_);
+		deleteList(freeNodes_.load(std::memory_order_relaxed));
+	}
+
+	/*线程安全的*/
+	void push(T x)
+	{
+		Node* node = newNode(std::move(x));
+		size_.fetch_add(1, std::memory_order_relaxed);
+		Node* prev = head_.exchange(node, std::memory_order_acq_rel);
+		prev->next.store(node, std::memory_order_release);
+	}
+
+	/**
+	 * 依次取出调用 consumeAll() 时已经在队列中的元素，交给 f 处理，返回处理的个数
+	 * f 中再 push() 的元素留到下一次，避免一直有新的元素的时候无法返回
+	*/
+	template <typename F>
+	size_t consumeAll(F&& f)
+	{
+		return consume(std::forward<F>(f), static_cast<size_t>(-1));
+	}
+
+	/*和 consumeAll() 一样，最多取出 maxItems 个*/
+	template <typename F>
+	size_t consume(F&& f, size_t maxItems)
+	{
+		Node* last = head_.load(std::memory_order_acquire);
+		size_t n = 0;
+		while (tail_ != last && n < maxItems)
+		{
+			Node* next = tail_->next.load(std::memory_order_acquire);
+			while (next == NULL)
+			{
+				/*last 已经 exchange 进来了，但是还有生产者没有来得及链接上，很快就会完成*/
+				sched_yield();
+				next = tail_->next.load(std::memory_order_acquire);
+			}
+			/*next 成为新的哨兵节点，它的值取出之后就不再使用*/
+			T value(std::move(next->value));
+			recycleNode(tail_);
+			tail_ = next;
+			size_.fetch_sub(1, std::memory_order_relaxed);
+			++n;
+			f(value);
+		}
+		return n;
+	}
+
+	/*近似值，可以在任意线程中调用*/
+	size_t size() const
+	{
+		return size_.load(std::memory_order_relaxed);
+	}
+
+	/*只能在消费者线程中调用*/
+	bool empty() const
+	{
+		return head_.load(std::memory_order_acquire) == tail_;
+	}
+
+private:
+	struct Node
+	{
+		Node() : next(NULL), value() {}
+		explicit Node(T&& x) : next(NULL), value(std::move(x)) {}
+
+		std::atomic<Node*> next;
+		T value;
+	};
+
+	/*空闲链表中最多保留的节点数，多出来的直接 delete*/
+	static const size_t kMaxFreeNodes = 1024;
+
+	static void deleteList(Node* node)
+	{
+		while (node != NULL)
+		{
+			Node* next = node->next.load(std::memory_order_relaxed);
+			delete node;
+			node = next;
+		}
+	}
+
+	/*生产者调用，空闲链表正在被其他生产者使用或者是空的时候 new 一个*/
+	Node* newNode(T&& x)
+	{
+		Node* node = NULL;
+		if (!freeLock_.exchange(true, std::memory_order_acquire))
+		{
+			node = freeNodes_.load(std::memory_order_acquire);
+			/*node 还在链表中，只有这里会取出，它的 next 不会改变；失败的话是消费者又放回了节点*/
+			while (node != NULL &&
+				   !freeNodes_.compare_exchange_weak(node, node->next.load(std::memory_order_relaxed),
+													 std::memory_order_acquire, std::memory_order_acquire))
+			{
+			}
+			freeLock_.store(false, std::memory_order_release);
+		}
+		if (node == NULL)
+			return new Node(std::move(x));
+		numFreeNodes_.fetch_sub(1, std::memory_order_relaxed);
+		node->next.store(NULL, std::memory_order_relaxed);
+		node->value = std::move(x);
+		return node;
+	}
+
+	/*消费者调用，node 中的值已经取出*/
+	void recycleNode(Node* node)
+	{
+		if (numFreeNodes_.load(std::memory_order_relaxed) >= kMaxFreeNodes)
+		{
+			delete node;
+			return;
+		}
+		node->value = T();	/*释放取出之后可能还留下的资源*/
+		numFreeNodes_.fetch_add(1, std::memory_order_relaxed);
+		Node* top = freeNodes_.load(std::memory_order_relaxed);
+		do
+		{
+			node->next.store(top, std::memory_order_relaxed);
+		} while (!freeNodes_.compare_exchange_weak(top, node,
+												   std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	/*生产者和消费者使用的变量放在不同的 cache line 上*/
+	std::atomic<Node*> head_;	/*最近 push 的节点，生产者修改*/
+	std::atomic<size_t> size_;
+	char pad_[64 - sizeof(std::atomic<Node*>) - sizeof(std::atomic<size_t>)];
+	Node* tail_;				/*哨兵节点，它的 next 是下一个要取出的元素，只有消费者修改*/
+	char freePad_[64 - sizeof(Node*)];
+	/*生产者和消费者都会修改*/
+	std::atomic<Node*> freeNodes_;
+	std::atomic<size_t> numFreeNodes_;
+	std::atomic<bool> freeLock_;	/*正在从 freeNodes_ 中取节点的生产者*/
+};
+
+} // namespace muduo
+
+#endif
@@ -1,4 +1,5 @@
 #include "base/Thread.h"
+#include "base/CpuPlacement.h"
 #include "base/CurrentThread.h"
 #include "base/Exception.h"
 #include "base/Logging.h"
@@ -62,15 +63,18 @@ struct ThreadData
 	typedef muduo::Thread::ThreadFunc ThreadFunc;
 	ThreadFunc func_;
 	string name_;
+	std::vector<int> cpus_;
 	pid_t* tid_;
 	CountDownLatch* latch_;
 
 	ThreadData(ThreadFunc func,
 				const string& name,
+				const std::vector<int>& cpus,
 				pid_t* tid,
 				CountDownLatch* latch)
 		: func_(std::move(func)),
 		name_(name),
+		cpus_(cpus),
 		tid_(tid),
 		latch_(latch)
 	{ }
@@ -84,6 +88,8 @@ struct ThreadData
 
 		muduo::CurrentThread::t_threadName = name_.empty() ? "muduoThread" : name_.c_str();
 		::prctl(PR_SET_NAME, muduo::CurrentThread::t_threadName);
+		/*在 func_ 分配任何内存之前绑定，这些内存在本地的 NUMA 节点上*/
+		CpuPlacement::bindCurrentThread(cpus_);
 		/*改变进程的名字*/
 		try
 		{
@@ -192,7 +198,7 @@ void Thread::start()
 	assert(!started_);/*如果在线程开始执行之前，started_ 的值就已经是 true, 那么就会报错*/
 	started_ = true;
 	// FIXME: move(func_)
-	detail::ThreadData* data = new detail::ThreadData(func_, name_, &tid_, &latch_);
+	detail::ThreadData* data = new detail::ThreadData(func_, name_, cpus_, &tid_, &latch_);
 	if (pthread_create(&pthreadId_, NULL, &detail::startThread, data))
 	/**
 	 * 创建一个线程，线程的入口函数是 startThread
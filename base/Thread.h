@@ -8,6 +8,7 @@
 
 #include <functional>
 #include <memory>
+#include <vector>
 #include <pthread.h>
 
 namespace muduo
@@ -22,6 +23,9 @@ public:
 
 	~Thread();
 
+	/*在 start() 之前调用，线程函数开始之前把线程绑定到这些 CPU 上，参考 CpuPlacement*/
+	void setCpuAffinity(const std::vector<int>& cpus) { cpus_ = cpus; }
+
 	void start();
 	int join();
 
@@ -42,6 +46,7 @@ private:
 	pid_t				tid_;
 	ThreadFunc			func_;
 	string				name_;
+	std::vector<int>	cpus_;
 	CountDownLatch		latch_; /**线程安全的，阻塞式的访问*/
 
 	static AtomicInt32 numCreated_; /**原子访问，不需要进行上锁*/
@@ -2,6 +2,8 @@
 #include "base/Exception.h"
 
 
+#include <algorithm>
+
 #include <assert.h>
 #include <errno.h>
 
@@ -14,6 +16,7 @@ ThreadPool::ThreadPool(const std::string nameArg)
       notFull_(mutex_),
       name_(nameArg),
       maxQueueSize_(0),
+      maxBatch_(1),
       running_(false)
 {}
 
@@ -25,6 +28,8 @@ ThreadPool::~ThreadPool()
 
 size_t ThreadPool::queueSize() const
 {
+    if (ring_)
+        return ring_->size();
     MutexLockGuard lock(mutex_);
     return queue_.size();
 }
@@ -39,7 +44,7 @@ bool ThreadPool::isFull() const
 }
 
 
-void ThreadPool::start(int numThreads)
+void ThreadPool::start(int numThreads, const CpuPlacement& placement)
 {
     /**
      * 在开始执行线程之前，当前的线程池一定是空的
@@ -47,6 +52,8 @@ void ThreadPool::start(int numThreads)
     assert(this->threads_.empty());
     this->running_ = true;
     this->threads_.reserve(numThreads);
+    if (maxQueueSize_ > 0 && numThreads > 0)
+        this->ring_.reset(new MpmcRingQueue<Task>(maxQueueSize_));
 
     for (int i = 0; i < numThreads; ++i)
     {
@@ -55,6 +62,7 @@ void ThreadPool::start(int numThreads)
         this->threads_.emplace_back(
             new muduo::Thread(std::bind(&ThreadPool::runInThread, this), this->name_ + id)
         );
+        this->threads_[i]->setCpuAffinity(placement.cpusFor(i));
         this->threads_[i]->start();
     }
 
@@ -70,6 +78,11 @@ void ThreadPool::stop()
         this->notEmpty_.notify_all();
         this->notFull_.notify_all();
     }
+    /**
+     * 唤醒阻塞在 ring_ 上的 run() 和 take()，还没有执行的任务和 queue_ 一样被丢弃
+    */
+    if (this->ring_)
+        this->ring_->close();
 
     for (auto& thr : this->threads_)
         thr->join();
@@ -88,8 +101,18 @@ void ThreadPool::runInThread()
     {
         if (this->threadInitCallback_)
             this->threadInitCallback_();
+        std::vector<Task> batch;
         while(this->running_)   /**在这里我们可以终止线程池的执行的过程*/
         {
+            if (maxBatch_ > 1)
+            {
+                /**取到的任务在 stop() 之后和队列中的一样被丢弃*/
+                this->takeBatch(&batch);
+                for (size_t i = 0; i < batch.size() && this->running_; ++i)
+                    batch[i]();
+                batch.clear();
+                continue;
+            }
             Task task(this->take());
             if (task)
                 task();
@@ -118,6 +141,9 @@ void ThreadPool::runInThread()
 
 ThreadPool::Task ThreadPool::take()
 {
+    if (this->ring_)
+        return this->ring_->take();    /**close() 之后返回空的任务*/
+
     MutexLockGuard lock(this->mutex_);
     while(this->queue_.empty() && this->running_)
         this->notEmpty_.wait();
@@ -138,6 +164,39 @@ ThreadPool::Task ThreadPool::take()
 }
 
 
+/**
+ * 一次最多取 maxBatch_ 个任务，但是不超过平均每个线程的份额，否则一个线程取走了所有的任务，其他的线程空闲
+*/
+void ThreadPool::takeBatch(std::vector<Task>* tasks)
+{
+    if (this->ring_)
+    {
+        Task task(this->ring_->take());
+        if (!task)
+            return;
+        tasks->push_back(std::move(task));
+        /*和下面一样最多取平分的份额，size() 不包括已经取出的这一个*/
+        size_t share = (this->ring_->size() + threads_.size()) / threads_.size();
+        size_t n = std::min(maxBatch_, share);
+        while (tasks->size() < n && this->ring_->tryTake(&task))
+            tasks->push_back(std::move(task));
+        return;
+    }
+
+    MutexLockGuard lock(this->mutex_);
+    while(this->queue_.empty() && this->running_)
+        this->notEmpty_.wait();
+    size_t share = (queue_.size() + threads_.size() - 1) / threads_.size();
+    size_t n = std::min(std::min(maxBatch_, share), queue_.size());
+    for (size_t i = 0; i < n; ++i)
+    {
+        tasks->push_back(std::move(queue_.front()));
+        queue_.pop_front();
+    }
+    if (n > 0 && maxQueueSize_ > 0)
+        notFull_.notify_all();
+}
+
 /**
  * 向我们的线程池当中添加任务
  * 执行添加任务的线程和线程池当中的线程之间是独立的
@@ -150,6 +209,11 @@ void ThreadPool::run(Task task)
     */
     if (this->threads_.empty())
         task();
+    else if (this->ring_)
+    {
+        /**队列满的时候阻塞，线程池被终止的时候 put() 失败，任务被丢弃*/
+        this->ring_->put(std::move(task));
+    }
     else 
     {
         MutexLockGuard lock(this->mutex_);
@@ -3,6 +3,9 @@
 
 #include "base/Mutex.h"
 #include "base/Condition.h"
+#include "base/CpuPlacement.h"
+#include "base/Future.h"
+#include "base/MpmcRingQueue.h"
 #include "base/Thread.h"
 #include "base/Types.h"
 
@@ -24,32 +27,48 @@ private:
 	Task 	threadInitCallback_;
 	std::vector<std::unique_ptr<muduo::Thread> > threads_;
 	std::deque<Task> queue_ GUARDED_BY(mutex_);
+	std::unique_ptr<MpmcRingQueue<Task> > ring_;	/*设置了 maxQueueSize_ 的时候代替 queue_*/
 	size_t maxQueueSize_;
+	size_t maxBatch_;
 	bool running_;
 private:
 	bool isFull() const REQUIRES(mutex_);
 	void runInThread();
 	Task take();
+	void takeBatch(std::vector<Task>* tasks);
 public:
 	explicit ThreadPool(const std::string nameArg = std::string("ThreadPool"));
 	~ThreadPool();
 
 	/**
 	 * 下面两个设置属性的函数必须在线程池执行之间进行调用
+	 * 设置了 maxQueueSize 的时候任务放在无锁的 MpmcRingQueue 中，run() 和 take() 不再竞争 mutex_
+	 * setTaskBatch(): 每个线程一次最多取 maxBatch 个任务，减少加锁和唤醒的次数，适合大量很短的任务
 	*/
 	void setMaxQueueSize(int maxSize) { this->maxQueueSize_ = maxSize; }
+	void setTaskBatch(int maxBatch) { this->maxBatch_ = maxBatch > 1 ? maxBatch : 1; }
 	void setThreadInitCallback(const Task& cb) 
 	{
 		this->threadInitCallback_ = cb;
 	}
 
-	void start(int numThreads);
+	/*第 i 个线程按照 placement.cpusFor(i) 绑定 CPU，默认不绑定*/
+	void start(int numThreads, const CpuPlacement& placement = CpuPlacement());
 	void stop();
 
 	const std::string& name() const { return this->name_; }
 	size_t queueSize() const;
 
 	void run(Task f);	/**添加任务*/
+
+	/**
+	 * 添加一个有返回值的任务，结果通过 Future::then() 交给一个 EventLoop，参考 base/Future.h
+	*/
+	template <typename F>
+	Future<typename std::result_of<F()>::type> submit(F f)
+	{
+		return detail::submitTo(this, std::move(f));
+	}
 };
 
 } // namespace muduo
@@ -32,7 +32,10 @@ public:
         {
             function_(ptr.get(), std::forward<ARGS>(args)...);
         }
-    }    
+    }
+
+    /*对象是否已经销毁，Future::then() 用它提前取消任务*/
+    const std::weak_ptr<CLASS>& object() const { return object_; }
 };
 
 /**
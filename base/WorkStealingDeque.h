@@ -0,0 +1,154 @@
+#ifndef MUDUO_BASE_WORKSTEALINGDEQUE_H
+#define MUDUO_BASE_WORKSTEALINGDEQUE_H
+
+#include "base/noncopyable.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <stdint.h>
+
+namespace muduo
+{
+
+/**
+ * Chase-Lev 工作窃取双端队列 (Lê, Pop, Cohen, Zappa Nardelli 的 C11 内存模型版本)
+ * 只有一个线程（所有者）可以 push() / pop()，在 bottom 一端后进先出，不需要 CAS
+ * 其他线程 steal() 从 top 一端先进先出地取，和所有者只在剩下最后一个元素的时候竞争
+ *
+ * 元素是指针，空的时候返回 NULL。数组满了之后所有者换一个两倍大的数组，
+ * 旧的数组可能还有窃取者在读，留到队列析构的时候释放
+*/
+template <typename T>
+class WorkStealingDeque : noncopyable
+{
+public:
+	explicit WorkStealingDeque(size_t capacity = 1024)
+		: top_(0),
+		  bottom_(0),
+		  array_(new Array(roundUp(capacity)))
+	{
+		retired_.emplace_back(array_.load(std::memory_order_relaxed));
+	}
+
+	/*只能在所有者线程中调用*/
+	void push(T* x)
+	{
+		int64_t b = bottom_.load(std::memory_order_relaxed);
+		int64_t t = top_.load(std::memory_order_acquire);
+		Array* a = array_.load(std::memory_order_relaxed);
+		if (b - t > static_cast<int64_t>(a->mask))
+			a = grow(a, t, b);
+		a->put(b, x);
+		std::atomic_thread_fence(std::memory_order_release);
+		bottom_.store(b + 1, std::memory_order_relaxed);
+	}
+
+	/*只能在所有者线程中调用，取最近 push 的元素*/
+	T* pop()
+	{
+		int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+		Array* a = array_.load(std::memory_order_relaxed);
+		bottom_.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t t = top_.load(std::memory_order_relaxed);
+		T* x = NULL;
+		if (t <= b)
+		{
+			x = a->get(b);
+			if (t == b)
+			{
+				/*最后一个元素，和窃取者竞争 top_*/
+				if (!top_.compare_exchange_strong(t, t + 1,
+												  std::memory_order_seq_cst,
+												  std::memory_order_relaxed))
+					x = NULL;
+				bottom_.store(b + 1, std::memory_order_relaxed);
+			}
+		}
+		else
+		{
+			bottom_.store(b + 1, std::memory_order_relaxed);
+		}
+		return x;
+	}
+
+	/*线程安全的，取最早 push 的元素，空的或者和其他线程竞争失败的时候返回 NULL*/
+	T* steal()
+	{
+		int64_t t = top_.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t b = bottom_.load(std::memory_order_acquire);
+		if (t < b)
+		{
+			Array* a = array_.load(std::memory_order_acquire);
+			T* x = a->get(t);
+			if (!top_.compare_exchange_strong(t, t + 1,
+											  std::memory_order_seq_cst,
+											  std::memory_order_relaxed))
+				return NULL;
+			return x;
+		}
+		return NULL;
+	}
+
+	/*近似值，可以在任意线程中调用*/
+	size_t size() const
+	{
+		int64_t b = bottom_.load(std::memory_order_relaxed);
+		int64_t t = top_.load(std::memory_order_relaxed);
+		return b > t ? static_cast<size_t>(b - t) : 0;
+	}
+
+	bool empty() const { return size() == 0; }
+
+private:
+	struct Array
+	{
+		explicit Array(size_t capacity)
+			: mask(capacity - 1),
+			  slots(new std::atomic<T*>[capacity])
+		{}
+
+		T* get(int64_t i) const
+		{ return slots[i & mask].load(std::memory_order_relaxed); }
+		void put(int64_t i, T* x)
+		{ slots[i & mask].store(x, std::memory_order_relaxed); }
+
+		const size_t mask;
+		std::unique_ptr<std::atomic<T*>[]> slots;
+	};
+
+	static size_t roundUp(size_t n)
+	{
+		size_t capacity = 2;
+		while (capacity < n)
+			capacity <<= 1;
+		return capacity;
+	}
+
+	Array* grow(Array* a, int64_t t, int64_t b)
+	{
+		Array* bigger = new Array((a->mask + 1) * 2);
+		for (int64_t i = t; i < b; ++i)
+			bigger->put(i, a->get(i));
+		retired_.emplace_back(bigger);
+		array_.store(bigger, std::memory_order_release);
+		return bigger;
+	}
+
+	/**
+	 * 窃取者修改 top_，所有者修改 bottom_，放在不同的 cache line 上
+	 * 用 pad_ 隔开而不是 alignas(64)，Worker 是 new 出来的，C++11 的 new 不保证超过 16 字节的对齐
+	*/
+	std::atomic<int64_t> top_;
+	char pad_[64 - sizeof(std::atomic<int64_t>)];
+	std::atomic<int64_t> bottom_;
+	std::atomic<Array*> array_;
+	std::vector<std::unique_ptr<Array> > retired_;	/*用过的所有数组，只有所有者修改*/
+};
+
+} // namespace muduo
+
+#endif
@@ -0,0 +1,343 @@
+#include "base/WorkStealingThreadPool.h"
+#include "base/Exception.h"
+#include "base/WorkStealingDeque.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <sched.h>
+#include <stdio.h>
+
+using namespace muduo;
+
+namespace
+{
+/*当前线程是哪一个线程池的哪一个 worker，worker 线程中 run() 的任务直接放入自己的队列*/
+__thread void* t_worker = NULL;
+__thread const WorkStealingThreadPool* t_workerOwner = NULL;
+
+/*自旋的前几次只用 pause 指令等待，之后让出 CPU*/
+const int kPauseSpins = 16;
+const int kDefaultSpinCount = 64;
+const int kDefaultInjectionBatch = 32;
+const int kMaxInjectionBatch = 256;
+
+inline void cpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+}
+
+struct WorkStealingThreadPool::Worker
+{
+    Worker(int i) : index(i), seed(static_cast<unsigned>(i) * 2654435761u + 1) {}
+
+    /*xorshift，选择窃取的对象*/
+    unsigned nextRandom()
+    {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return seed;
+    }
+
+    const int index;
+    unsigned seed;
+    WorkStealingDeque<Task> deque;
+    std::unique_ptr<muduo::Thread> thread;
+};
+
+WorkStealingThreadPool::WorkStealingThreadPool(const string& nameArg)
+    : name_(nameArg),
+      maxQueueSize_(0),
+      spinCount_(kDefaultSpinCount),
+      injectionBatch_(kDefaultInjectionBatch),
+      running_(false),
+      injectedLock_(false),
+      queued_(0),
+      mutex_(),
+      notEmpty_(mutex_),
+      notFull_(mutex_),
+      sleepers_(0),
+      wakePending_(false),
+      fullWaiters_(0),
+      steals_(0),
+      parks_(0)
+{}
+
+WorkStealingThreadPool::~WorkStealingThreadPool()
+{
+    if (running_)
+        stop();
+}
+
+void WorkStealingThreadPool::start(int numThreads, const CpuPlacement& placement)
+{
+    assert(workers_.empty());
+    running_ = true;
+    workers_.reserve(numThreads);
+    /*所有的 Worker 创建好之后才启动线程，窃取的时候 workers_ 不再改变*/
+    for (int i = 0; i < numThreads; ++i)
+    {
+        workers_.emplace_back(new Worker(i));
+    }
+    for (int i = 0; i < numThreads; ++i)
+    {
+        char id[32];
+        snprintf(id, sizeof id, "%d", i + 1);
+        Worker* worker = workers_[i].get();
+        worker->thread.reset(
+            new muduo::Thread(std::bind(&WorkStealingThreadPool::runInThread, this, worker), name_ + id));
+        worker->thread->setCpuAffinity(placement.cpusFor(i));
+        worker->thread->start();
+    }
+
+    if (numThreads == 0 && threadInitCallback_)
+        threadInitCallback_();
+}
+
+/**
+ * 和 ThreadPool 一样，还没有执行的任务被丢弃
+*/
+void WorkStealingThreadPool::stop()
+{
+    {
+        MutexLockGuard lock(mutex_);
+        running_ = false;
+        notEmpty_.notify_all();
+        notFull_.notify_all();
+    }
+    for (auto& worker : workers_)
+        worker->thread->join();
+
+    /*所有的 worker 都已经退出，这里是唯一的消费者*/
+    for (auto& worker : workers_)
+    {
+        while (Task* task = worker->deque.pop())
+            delete task;
+    }
+    injected_.consumeAll([](Task&) {});
+    queued_ = 0;
+}
+
+void WorkStealingThreadPool::run(Task task)
+{
+    if (workers_.empty())
+    {
+        task();
+        return;
+    }
+
+    if (t_workerOwner == this)
+    {
+        /*worker 中产生的子任务，放入自己的队列，不受 maxQueueSize_ 限制，否则所有 worker 都可能阻塞在这里*/
+        queued_.fetch_add(1);
+        static_cast<Worker*>(t_worker)->deque.push(new Task(std::move(task)));
+    }
+    else
+    {
+        if (!reserve())
+            return;     /*线程池被终止了，那么任务就不添加进去了*/
+        injected_.push(std::move(task));
+    }
+    notifyIdleWorker();
+}
+
+/**
+ * 占用一个队列的位置，队列满了的时候等待，线程池终止的时候返回 false
+*/
+bool WorkStealingThreadPool::reserve()
+{
+    size_t queued = queued_.load();
+    for (;;)
+    {
+        if (!running_)
+            return false;
+        if (maxQueueSize_ > 0 && queued >= maxQueueSize_)
+        {
+            MutexLockGuard lock(mutex_);
+            fullWaiters_.fetch_add(1);
+            while (running_ && queued_.load() >= maxQueueSize_)
+                notFull_.wait();
+            fullWaiters_.fetch_sub(1);
+            queued = queued_.load();
+            continue;
+        }
+        if (queued_.compare_exchange_weak(queued, queued + 1))
+            return true;
+    }
+}
+
+/**
+ * 任务入队 (queued_ 增加) 之后检查 sleepers_，worker 休眠之前先增加 sleepers_ 再检查 queued_，
+ * 两边都是先写后读并且是 seq_cst，至少有一边能看到另一边，不会出现任务在队列中而所有的 worker 都在休眠
+ *
+ * 被唤醒的 worker 真正运行之前，后面的 run() 不用再唤醒 (wakePending_)，否则一个生产者连续 run() 的时候
+ * 每一次都是一次 futex 系统调用。醒来的 worker 取到任务之后如果还有任务，再唤醒下一个，参考 runInThread()
+ * wakePending_ 只在持有 mutex_ 的时候清除，设置之后要么唤醒了一个休眠的 worker，要么马上清除
+*/
+void WorkStealingThreadPool::notifyIdleWorker()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleepers_.load(std::memory_order_relaxed) > 0 && !wakePending_.exchange(true))
+    {
+        MutexLockGuard lock(mutex_);
+        if (sleepers_.load() > 0)
+            notEmpty_.notify();
+        else
+            wakePending_ = false;
+    }
+}
+
+void WorkStealingThreadPool::taskTaken()
+{
+    queued_.fetch_sub(1);
+    if (maxQueueSize_ > 0 && fullWaiters_.load() > 0)
+    {
+        MutexLockGuard lock(mutex_);
+        notFull_.notify_all();
+    }
+}
+
+void WorkStealingThreadPool::runInThread(Worker* self)
+{
+    t_worker = self;
+    t_workerOwner = this;
+    try
+    {
+        if (threadInitCallback_)
+            threadInitCallback_();
+        while (running_)
+        {
+            Task task;
+            if (findTask(self, &task) || spinThenPark(self, &task))
+            {
+                taskTaken();
+                /*还有任务的时候把唤醒传递下去，否则连续 run() 的一批任务只有一个 worker 被唤醒*/
+                if (queued_.load(std::memory_order_relaxed) > 0)
+                    notifyIdleWorker();
+                task();
+            }
+        }
+    }
+    catch (const Exception& ex)
+    {
+        fprintf(stderr, "exception caught in WorkStealingThreadPool %s\n", name_.c_str());
+        fprintf(stderr, "reason: %s\n", ex.what());
+        fprintf(stderr, "stack trace: %s\n", ex.stackTrace());
+        abort();
+    }
+    catch (const std::exception& ex)
+    {
+        fprintf(stderr, "exception caught in WorkStealingThreadPool %s\n", name_.c_str());
+        fprintf(stderr, "reason: %s\n", ex.what());
+        abort();
+    }
+    catch (...)
+    {
+        fprintf(stderr, "unknown exception caught in WorkStealingThreadPool %s\n", name_.c_str());
+        throw; // rethrow
+    }
+    t_worker = NULL;
+    t_workerOwner = NULL;
+}
+
+bool WorkStealingThreadPool::findTask(Worker* self, Task* task)
+{
+    Task* local = self->deque.pop();
+    if (local == NULL)
+        local = steal(self);
+    if (local)
+    {
+        *task = std::move(*local);
+        delete local;
+        return true;
+    }
+    return takeInjected(self, task);
+}
+
+/**
+ * 注入队列只能有一个消费者，拿不到 injectedLock_ 的 worker 直接返回，不等待
+ * 第一个任务直接返回，后面最多 injectionBatch_ - 1 个放入自己的队列，持有锁的时间和取一个差不多，
+ * 其他 worker 从这个队列中窃取，不用排队等 injectedLock_
+ * 一批最多取注入队列中按照 worker 个数平分的份额，不让一个 worker 拿走所有的任务
+ * 倒序放入，自己从底部取的时候仍然是先提交的先执行，窃取的是这一批中后提交的
+*/
+bool WorkStealingThreadPool::takeInjected(Worker* self, Task* task)
+{
+    size_t size = injected_.size();
+    if (size == 0 || injectedLock_.load(std::memory_order_relaxed))
+        return false;
+    bool expected = false;
+    if (!injectedLock_.compare_exchange_strong(expected, true, std::memory_order_acquire))
+        return false;
+
+    size_t share = size / workers_.size() + 1;
+    size_t batch = std::min(std::min(static_cast<size_t>(injectionBatch_), share),
+                            static_cast<size_t>(kMaxInjectionBatch));
+    Task* rest[kMaxInjectionBatch];
+    size_t n = 0;
+    injected_.consume([task, &rest, &n](Task& t) {
+        if (n == 0)
+            *task = std::move(t);
+        else
+            rest[n - 1] = new Task(std::move(t));
+        ++n;
+    }, batch);
+    injectedLock_.store(false, std::memory_order_release);
+
+    for (size_t i = n; i > 1; --i)
+        self->deque.push(rest[i - 2]);
+    return n > 0;
+}
+
+/**
+ * 从一个随机的位置开始，每一个其他的 worker 尝试一次
+*/
+WorkStealingThreadPool::Task* WorkStealingThreadPool::steal(Worker* self)
+{
+    size_t n = workers_.size();
+    size_t start = self->nextRandom() % n;
+    for (size_t k = 0; k < n; ++k)
+    {
+        Worker* victim = workers_[(start + k) % n].get();
+        if (victim == self)
+            continue;
+        Task* task = victim->deque.steal();
+        if (task)
+        {
+            steals_.fetch_add(1, std::memory_order_relaxed);
+            return task;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * 任务常常是一个接一个到达的，马上休眠的话下一个任务要付出一次 futex 唤醒的代价
+ * 所以先自旋一会儿，还是没有任务再休眠。返回 false 的时候调用者重新检查 running_
+*/
+bool WorkStealingThreadPool::spinThenPark(Worker* self, Task* task)
+{
+    for (int i = 0; i < spinCount_ && running_; ++i)
+    {
+        if (i < kPauseSpins)
+            cpuRelax();
+        else
+            sched_yield();
+        if (findTask(self, task))
+            return true;
+    }
+
+    MutexLockGuard lock(mutex_);
+    sleepers_.fetch_add(1);
+    while (running_ && queued_.load() == 0)
+    {
+        parks_.fetch_add(1, std::memory_order_relaxed);
+        notEmpty_.wait();
+        wakePending_ = false;
+    }
+    sleepers_.fetch_sub(1);
+    return false;
+}
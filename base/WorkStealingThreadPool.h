@@ -0,0 +1,111 @@
+#ifndef MUDUO_BASE_WORKSTEALINGTHREADPOOL_H
+#define MUDUO_BASE_WORKSTEALINGTHREADPOOL_H
+
+#include "base/Condition.h"
+#include "base/CpuPlacement.h"
+#include "base/Future.h"
+#include "base/MpscQueue.h"
+#include "base/Mutex.h"
+#include "base/Thread.h"
+#include "base/Types.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace muduo
+{
+
+/**
+ * 工作窃取的线程池，接口和 ThreadPool 一样
+ *
+ * ThreadPool 的所有线程和所有提交任务的线程都在竞争同一个 mutex_，每秒上百万个任务的时候锁成为瓶颈
+ * 这里每一个 worker 有自己的 WorkStealingDeque，其他线程 run() 的任务放入全局的无锁注入队列 (MpscQueue)
+ * worker 线程中 run() 的任务（子任务）直接放入自己的队列，不经过注入队列
+ * worker 取任务的顺序：自己的队列 -> 随机从其他 worker 的队列中窃取 -> 注入队列
+ * 注入队列同一时刻只有一个 worker 在取，每次取一批放入自己的队列，其他空闲的 worker 再从这里窃取，
+ * 其他线程大量 run() 的时候注入队列不会成为唯一的瓶颈。一批中的任务不再严格按照提交的顺序开始执行，
+ * 需要和 ThreadPool 一样的顺序的时候 setInjectionBatch(1)
+ *
+ * 没有任务的时候先自旋 spinCount 次，仍然没有再在条件变量上休眠，只有有 worker 休眠的时候 run() 才需要加锁唤醒
+*/
+class WorkStealingThreadPool : noncopyable
+{
+public:
+	typedef std::function<void ()> Task;
+
+	explicit WorkStealingThreadPool(const string& nameArg = string("WorkStealingThreadPool"));
+	~WorkStealingThreadPool();
+
+	/**
+	 * 下面设置属性的函数必须在线程池执行之前进行调用
+	 * setMaxQueueSize(): 等待执行的任务超过 maxSize 的时候，其他线程的 run() 阻塞，worker 线程中的 run() 不受限制
+	 * setSpinCount(): 空闲的 worker 休眠之前尝试取任务的次数
+	 * setInjectionBatch(): worker 一次最多从注入队列中取多少个任务，1 表示按照提交的顺序一个一个地取
+	*/
+	void setMaxQueueSize(int maxSize) { maxQueueSize_ = maxSize; }
+	void setThreadInitCallback(const Task& cb) { threadInitCallback_ = cb; }
+	void setSpinCount(int n) { spinCount_ = n; }
+	void setInjectionBatch(int n) { injectionBatch_ = n > 0 ? n : 1; }
+
+	void start(int numThreads, const CpuPlacement& placement = CpuPlacement());
+	void stop();
+
+	const string& name() const { return name_; }
+	/*等待执行的任务个数，线程安全*/
+	size_t queueSize() const { return queued_.load(std::memory_order_relaxed); }
+
+	void run(Task f);	/**添加任务，线程安全*/
+
+	/*和 ThreadPool::submit() 一样*/
+	template <typename F>
+	Future<typename std::result_of<F()>::type> submit(F f)
+	{
+		return detail::submitTo(this, std::move(f));
+	}
+
+	/*统计：从其他 worker 窃取到的任务数，worker 休眠的次数*/
+	int64_t steals() const { return steals_.load(std::memory_order_relaxed); }
+	int64_t parks() const { return parks_.load(std::memory_order_relaxed); }
+
+private:
+	struct Worker;
+
+	void runInThread(Worker* self);
+	bool findTask(Worker* self, Task* task);
+	bool takeInjected(Worker* self, Task* task);
+	Task* steal(Worker* self);
+	bool spinThenPark(Worker* self, Task* task);
+	void taskTaken();
+	void notifyIdleWorker();
+	bool reserve();
+
+	const string name_;
+	Task threadInitCallback_;
+	size_t maxQueueSize_;
+	int spinCount_;
+	int injectionBatch_;
+	std::atomic<bool> running_;
+	std::vector<std::unique_ptr<Worker> > workers_;
+
+	MpscQueue<Task> injected_;
+	std::atomic<bool> injectedLock_;	/*同一时刻只有一个 worker 从注入队列中取*/
+	std::atomic<size_t> queued_;		/*run() 了还没有被取走的任务，包括各个 worker 队列中的*/
+
+	/**
+	 * 只用于休眠和唤醒，sleepers_ / fullWaiters_ 为 0 的时候 run() 和取任务都不需要加锁
+	*/
+	MutexLock mutex_;
+	Condition notEmpty_;
+	Condition notFull_;
+	std::atomic<int> sleepers_;
+	std::atomic<bool> wakePending_;	/*已经唤醒了一个 worker，它还没有运行，参考 notifyIdleWorker()*/
+	std::atomic<int> fullWaiters_;
+
+	std::atomic<int64_t> steals_;
+	std::atomic<int64_t> parks_;
+};
+
+} // namespace muduo
+
+#endif
@@ -59,15 +59,13 @@ public:
 
     void send(muduo::net::TcpConnection* conn, const muduo::StringPiece& message)
     {
-        muduo::net::Buffer buf;
-        buf.append(message.data(), message.size()); /*深拷贝*/
         int32_t len = static_cast<int32_t>(message.size());
         int32_t be32 = muduo::net::sockets::hostToNetwork32(len);
         /**
          * 每一个消息发送出去之后，会在这个消息的前面加上这个消息的长度信息
+         * 消息头和消息体通过一次 writev() 发送，不需要拷贝到一个新的 Buffer 中再 prepend
         */
-        buf.prepend(&be32, sizeof be32);
-        conn->send(&buf); /**非阻塞也不需要担心，函数结束之后 buf 失效的问题，在 conn->send() 当中将其转换为了 string*/
+        conn->send({ muduo::net::Slice(&be32, sizeof be32), muduo::net::Slice(message) });
     }
 };
 
@@ -4,34 +4,57 @@
 #include "base/Timestamp.h"
 #include "net/TcpConnection.h"
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <memory>
 #include <string>
 #include <functional>
 
-std::string contents;
+/**
+ * usage: client [readBudget]
+ * 收到的文件内容写到标准输出，结束的时候在标准错误上打印吞吐量和每次 read 平均读到的字节数
+ * readBudget 为 0 的时候每次可读事件只读一次
+*/
+
+size_t readBudget = 256 * 1024;
+int64_t received = 0;
+muduo::Timestamp start;
 
 void receiveFile(const muduo::net::TcpConnectionPtr& conn, 
         muduo::net::Buffer* inputbuffer, 
         muduo::Timestamp receivedTime)
 {
-    LOG_INFO << "receiveFile";
-    std::string temp = inputbuffer->retrieveAllAsString();
-    contents.append(temp);
+    received += inputbuffer->readableBytes();
+    fwrite(inputbuffer->peek(), 1, inputbuffer->readableBytes(), stdout);
+    inputbuffer->retrieveAll();
 }
 
 void connectionCallback(const muduo::net::TcpConnectionPtr& conn)
 {
-    if (conn->disconnected())
+    if (conn->connected())
+    {
+        conn->setReadBudget(readBudget);
+        start = muduo::Timestamp::now();
+    }
+    else
     {
+        double seconds = timeDifference(muduo::Timestamp::now(), start);
+        fprintf(stderr, "received %ld bytes in %.3f s, %.1f MiB/s, %ld reads, %.1f bytes/read\n",
+                static_cast<long>(received), seconds,
+                static_cast<double>(received) / seconds / 1024 / 1024,
+                static_cast<long>(conn->readCalls()),
+                static_cast<double>(conn->bytesRead()) / conn->readCalls());
         LOG_INFO << "Client disconnected";
         muduo::net::EventLoop* loop = conn->getLoop();
-        loop->runAfter(5.0, std::bind(&muduo::net::EventLoop::quit, loop));
+        loop->queueInLoop(std::bind(&muduo::net::EventLoop::quit, loop));
     }
 }
 
 int main(int argc, char* argv[], char* env[])
 {
+    muduo::Logger::setLogLevel(muduo::Logger::WARN);
+    if (argc > 1)
+        readBudget = atoi(argv[1]);
     muduo::net::EventLoop loop;
     muduo::net::InetAddress serverAddr("127.0.0.1", 2021);
     muduo::net::TcpClient client (&loop, serverAddr, "TcpClient");
@@ -39,7 +62,6 @@ int main(int argc, char* argv[], char* env[])
     client.setConnectionCallback(connectionCallback);
     client.connect();
     loop.loop();
-
-    printf("%s\n", contents.c_str());
+    fflush(stdout);
     return 0;
-}
\ No newline at end of file
+}
@@ -1,15 +1,26 @@
 #include "base/Logging.h"
+#include "base/Timestamp.h"
 #include "net/EventLoop.h"
 #include "net/TcpServer.h"
 
+#include <fcntl.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
+/**
+ * usage: download file_for_downloading [copy]
+ * 默认使用 TcpConnection::sendFile() 零拷贝的发送文件
+ * 加上 copy 参数之后使用原来的方式：把整个文件读入内存，再 send() 出去
+ * 每一个连接发送完成之后打印吞吐量和进程的 RSS
+*/
 
 using namespace muduo;
 using namespace muduo::net;
 
 const char* g_file = NULL;
+bool g_copy = false;
 
 string readFile(const char* filename)
 {
@@ -34,6 +45,29 @@ string readFile(const char* filename)
     return content;
 }
 
+/**
+ * 进程当前占用的物理内存，单位 KB
+*/
+long residentKB()
+{
+    long rss = 0;
+    FILE* fp = ::fopen("/proc/self/status", "r");
+    if (fp)
+    {
+        char line[256];
+        while (::fgets(line, sizeof line, fp))
+        {
+            if (::strncmp(line, "VmRSS:", 6) == 0)
+            {
+                rss = ::atol(line + 6);
+                break;
+            }
+        }
+        ::fclose(fp);
+    }
+    return rss;
+}
+
 void quit(EventLoop* loop)
 {
     loop->quit();
@@ -45,6 +79,28 @@ void onHighWaterMark(const TcpConnectionPtr& conn, size_t len)
     LOG_INFO << "download -- High water mark : " << len;
 }
 
+/**
+ * 连接的 context 中保存 发送开始的时间 和 文件的大小
+*/
+struct Transfer
+{
+    Timestamp start;
+    size_t bytes;
+};
+
+void onWriteComplete(const TcpConnectionPtr& conn)
+{
+    const Transfer& transfer = boost::any_cast<const Transfer&>(conn->getContext());
+    double seconds = timeDifference(Timestamp::now(), transfer.start);
+    printf("%s: sent %zu bytes in %.3f s, %.2f MiB/s, RSS %ld KB\n",
+           g_copy ? "copy" : "sendfile",
+           transfer.bytes,
+           seconds,
+           static_cast<double>(transfer.bytes) / seconds / 1024 / 1024,
+           residentKB());
+    fflush(stdout);
+    conn->shutdown();
+}
 
 void onConnection(const TcpConnectionPtr& conn)
 {
@@ -56,24 +112,53 @@ void onConnection(const TcpConnectionPtr& conn)
         LOG_INFO << "download -- FileServer - Sending file " << g_file
                 << " to " << conn->peerAddress().toIpPort();
         conn->setHighWaterMarkCallback(onHighWaterMark, 64*1024);
-        string fileContent = readFile(g_file);
-        printf("file contents : \n %s\n", fileContent.c_str());
-        conn->send(fileContent);
-        conn->shutdown();
+        conn->setWriteCompleteCallback(onWriteComplete);
+
+        Transfer transfer;
+        transfer.start = Timestamp::now();
+        if (g_copy)
+        {
+            string fileContent = readFile(g_file);
+            transfer.bytes = fileContent.size();
+            conn->setContext(transfer);
+            conn->send(fileContent);
+        }
+        else
+        {
+            /**
+             * sendFile() 会 dup 这个 fd，所以这里可以直接关闭
+            */
+            int fd = ::open(g_file, O_RDONLY | O_CLOEXEC);
+            struct stat st;
+            if (fd < 0 || ::fstat(fd, &st) < 0)
+            {
+                LOG_SYSERR << "download -- open " << g_file;
+                if (fd >= 0)
+                    ::close(fd);
+                conn->shutdown();
+                return;
+            }
+            transfer.bytes = st.st_size;
+            conn->setContext(transfer);
+            conn->sendFile(fd, 0, st.st_size);
+            ::close(fd);
+        }
         LOG_INFO << "FileServer - done";
     }
     if (conn->disconnected())
     {
-        LOG_INFO << "download -- FileServer - TcpConnection double direction distoried";  
+        LOG_INFO << "download -- FileServer - TcpConnection double direction distoried";
     }
 }
 
 int main(int argc, char* argv[])
 {
+    Logger::setLogLevel(Logger::INFO);
     LOG_INFO << "download -- pid = " << getpid();
     if (argc > 1)
     {
         g_file = argv[1];
+        g_copy = argc > 2 && ::strcmp(argv[2], "copy") == 0;
 
         EventLoop loop;
         InetAddress listenAddr(2021);   /**监控计算机本地的 2021 端口*/
@@ -85,6 +170,6 @@ int main(int argc, char* argv[])
     }
     else
     {
-        fprintf(stderr, "Usage: %s file_for_downloading\n", argv[0]);
+        fprintf(stderr, "Usage: %s file_for_downloading [copy]\n", argv[0]);
     }
-}
\ No newline at end of file
+}
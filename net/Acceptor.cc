@@ -2,6 +2,7 @@
 
 
 #include "base/Logging.h"
+#include "base/Timestamp.h"
 #include "net/EventLoop.h"
 #include "net/InetAddress.h"
 #include "net/SocketsOps.h"
@@ -21,7 +22,13 @@ Acceptor::Acceptor(EventLoop* loop, const InetAddress& listenAddr, bool reusepor
 		acceptSocket_(sockets::createNonblockingOrDie(listenAddr.family())),
 		accpetChannel_(loop, acceptSocket_.fd()),
 		listenning_(false),
-		idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC)) /*/dev/null 是一个空文件，从这个文件读取数据，将得到 空*/
+		idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC)), /*/dev/null 是一个空文件，从这个文件读取数据，将得到 空*/
+		maxAcceptsPerEvent_(1),
+		acceptTimeBudget_(0.0),
+		acceptEvents_(0),
+		accepted_(0),
+		rejected_(0),
+		acceptErrors_(0)
 {
 	assert(idleFd_ >= 0);
 	this->acceptSocket_.setReuseAddr(true);
@@ -54,34 +61,66 @@ void Acceptor::listen()
 	*/
 }
 
+/**
+ * 一次可读事件中循环 accept，直到 EAGAIN，或者达到 maxAcceptsPerEvent_ / acceptTimeBudget_
+ * 监听 socket 是水平触发的，没有 accept 完的连接下一次 poll 还会通知
+ *
+ * admissionCallback_ 拒绝的连接 accept 之后马上关闭，对端读到 EOF，和下面 EMFILE 的处理一样，
+ * 不会让连接一直堆在内核的 accept 队列中
+*/
 void Acceptor::handleRead()
 {
 	this->loop_->assertInLoopThread();
-	InetAddress  peerAddr;	/*远端也就是客户端的 IP 地址*/
+	acceptEvents_.fetch_add(1, std::memory_order_relaxed);
+	Timestamp start;
+	if (acceptTimeBudget_ > 0)
+		start = Timestamp::now();
 
-	int connfd = this->acceptSocket_.accept(&peerAddr);
-	if (connfd >= 0)
+	for (int i = 0; i < maxAcceptsPerEvent_; ++i)
 	{
-		if (this->newConnectionCallback_)
-			newConnectionCallback_(connfd, peerAddr);
-		else 
-			sockets::close(connfd);
-	}
-	else 
-	{
-		LOG_SYSERR << "in Acceptor::handleRead";
+		InetAddress  peerAddr;	/*远端也就是客户端的 IP 地址*/
+		int connfd = this->acceptSocket_.accept(&peerAddr);
+		if (connfd < 0)
+		{
+			int savedErrno = errno;	/*LOG_SYSERR 之后 errno 可能已经改变*/
+			if (savedErrno == EAGAIN)	/*已经 accept 完了*/
+				break;
+			acceptErrors_.fetch_add(1, std::memory_order_relaxed);
+			LOG_SYSERR << "in Acceptor::handleRead";
+			/**
+			 * 只是这一个连接出了问题（对端已经 RST，或者被信号打断），队列中后面的连接还可以继续 accept
+			*/
+			if (savedErrno == ECONNABORTED || savedErrno == EINTR || savedErrno == EPROTO)
+				continue;
     // Read the section named "The special problem of
     // accept()ing when you can't" in libev's doc.
     // By Marc Lehmann, author of libev.
-		if (errno == EMFILE)
+			if (savedErrno == EMFILE)
+			{
+				/***
+				 * 每一个进程可以使用的 fd 的数量是有限的，当打开的 fd 的数量超出了限制，会发生这个错误
+				*/
+				::close(idleFd_);
+				idleFd_ = ::accept(acceptSocket_.fd(), NULL, NULL);
+				::close(idleFd_);
+				idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+				rejected_.fetch_add(1, std::memory_order_relaxed);
+			}
+			break;
+		}
+
+		if (!newConnectionCallback_ || (admissionCallback_ && !admissionCallback_()))
 		{
-			/***
-			 * 每一个进程可以使用的 fd 的数量是有限的，当打开的 fd 的数量超出了限制，会发生这个错误
-			*/
-			::close(idleFd_);
-			idleFd_ = ::accept(acceptSocket_.fd(), NULL, NULL);
-			::close(idleFd_);
-			idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+			sockets::close(connfd);
+			rejected_.fetch_add(1, std::memory_order_relaxed);
 		}
+		else
+		{
+			accepted_.fetch_add(1, std::memory_order_relaxed);
+			newConnectionCallback_(connfd, peerAddr);
+		}
+
+		if (acceptTimeBudget_ > 0 && timeDifference(Timestamp::now(), start) >= acceptTimeBudget_)
+			break;
 	}
 }
@@ -1,6 +1,7 @@
 #ifndef MUDUO_NET_ACCEPTOR_H
 #define MUDUO_NET_ACCEPTOR_H
 
+#include <atomic>
 #include <functional>
 
 #include "net/Channel.h"
@@ -20,6 +21,10 @@ class Acceptor : public noncopyable
 {
 public:
 	typedef std::function<void (int sockfd_, const InetAddress&)> NewConnectionCallback;
+	/**
+	 * 每一个 accept 到的连接交给上层之前调用，返回 false 的时候直接关闭这个连接（拒绝）
+	*/
+	typedef std::function<bool ()> AdmissionCallback;
 	/**
 	 * 对于每一个新的连接，accpet() 返回一个连接 sockefd 
 	*/
@@ -28,8 +33,21 @@ private:
 	Socket					acceptSocket_;
 	Channel					accpetChannel_;
 	NewConnectionCallback	newConnectionCallback_;
+	AdmissionCallback		admissionCallback_;
 	bool	listenning_;
 	int		idleFd_;
+	/**
+	 * 一次可读事件最多 accept 多少个连接，以及最多用多长时间，参考 handleRead()
+	*/
+	int		maxAcceptsPerEvent_;
+	double	acceptTimeBudget_;
+	/**
+	 * 统计，可以在任意线程中读取
+	*/
+	std::atomic<int64_t>	acceptEvents_;
+	std::atomic<int64_t>	accepted_;
+	std::atomic<int64_t>	rejected_;
+	std::atomic<int64_t>	acceptErrors_;
 private:
 	void handleRead();
 public:
@@ -39,6 +57,24 @@ public:
 	void setNewConnectionCallback(const NewConnectionCallback& cb)
 	{ newConnectionCallback_ = cb; }
 
+	void setAdmissionCallback(const AdmissionCallback& cb)
+	{ admissionCallback_ = cb; }
+
+	/**
+	 * 一次可读事件最多 accept n 个连接，默认 1。连接集中到达的时候（重连风暴）不用每一个连接都 epoll_wait() 一次
+	 * seconds > 0 的时候，一次事件 accept 的时间超过 seconds 也停止，剩下的连接留到下一轮，不耽误这个 loop 上的其他事件
+	*/
+	void setMaxAcceptsPerEvent(int n)
+	{ maxAcceptsPerEvent_ = n > 0 ? n : 1; }
+	void setAcceptTimeBudget(double seconds)
+	{ acceptTimeBudget_ = seconds; }
+
+	/**可读事件的次数，交给上层的连接数，被拒绝的连接数 (包括 EMFILE)，accept 出错的次数*/
+	int64_t acceptEvents() const { return acceptEvents_.load(std::memory_order_relaxed); }
+	int64_t accepted() const { return accepted_.load(std::memory_order_relaxed); }
+	int64_t rejected() const { return rejected_.load(std::memory_order_relaxed); }
+	int64_t acceptErrors() const { return acceptErrors_.load(std::memory_order_relaxed); }
+
 	bool listenning() const { return listenning_; }
 	void listen();
 };
@@ -17,9 +17,13 @@ const size_t Buffer::kInitialSize;
  * 一次性从 socket 中读取足够的数据，如果当前的 buffer 无法完成存储，则使用
  * 额外的 buf 进行存储，之后再对 buffer 进行扩容
 */
-ssize_t Buffer::readfd(int fd, int* savedErrno)
+ssize_t Buffer::readfd(int fd, int* savedErrno, size_t directBytes)
 {
 	char extrabuf[65536];   /**64 KB 的缓冲区*/
+	if (directBytes > this->writableBytes())
+	{
+		this->ensureWritableBytes(directBytes);
+	}
 	struct iovec vec[2];    /**分散存储*/
 	const size_t writable = this->writableBytes();
 	vec[0].iov_base = this->begin() + this->writer_index_;	/*可写区域开始的位置*/
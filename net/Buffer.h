@@ -5,6 +5,7 @@
 #include "base/StringPiece.h"
 #include "base/Types.h"
 
+#include "net/BufferAllocator.h"
 #include "net/Endian.h"
 
 
@@ -32,7 +33,9 @@ Buffer 仿 Netty ChannelBuffer 的 buffer class，数据的读写通过 buffer 
 */
 class Buffer : public muduo::copyable{
 private:
-	std::vector<char>   buffer_;
+	typedef std::vector<char, detail::BufferStlAllocator<char> > Storage;
+
+	Storage             buffer_;
 	size_t              reader_index_;
 	size_t              writer_index_;
 
@@ -42,11 +45,15 @@ public:
 	static const size_t kCheapPrepend = 8;
 	static const size_t kInitialSize = 1024;
 
-	explicit Buffer(size_t initialSize = kInitialSize)
-		:   buffer_(kCheapPrepend + initialSize),
+	/**
+	 * allocator 为 NULL 的时候使用 malloc，TcpConnection 使用 BufferAllocator::loopAllocator()
+	*/
+	explicit Buffer(size_t initialSize = kInitialSize, BufferAllocator* allocator = NULL)
+		:   buffer_(detail::BufferStlAllocator<char>(allocator)),
 			reader_index_(kCheapPrepend),
 			writer_index_(kCheapPrepend)
 	{
+		buffer_.resize(kCheapPrepend + initialSize);
 		/**初始化之后的检查*/
 		assert(this->readableBytes() == 0);
 		assert(this->writableBytes() == initialSize);
@@ -67,7 +74,7 @@ public:
 	{ return writer_index_ - reader_index_; }
 
 	size_t writableBytes() const
-	{ return buffer_.size() - reader_index_; }
+	{ return buffer_.size() - writer_index_; }
 
 	size_t prependableBytes() const
 	{ return reader_index_; }
@@ -206,13 +213,13 @@ public:
 
 	void hasWritten(size_t len)
 	{
-		assert(len < this->writableBytes());
+		assert(len <= this->writableBytes());
 		this->writer_index_ += len;
 	}
 
 	void unwrite(size_t len)
 	{
-		assert(len < this->readableBytes());
+		assert(len <= this->readableBytes());
 		this->writer_index_ -= len;
 	}
 
@@ -369,8 +376,7 @@ public:
 	void shrink(size_t reserve)
 	{
 		// FIXME: use vector::shrink_to_fit() in C++ 11 if possible.
-		Buffer other;
-		other.ensureWritableBytes(readableBytes()+reserve);
+		Buffer other(readableBytes()+reserve, allocator());
 		other.append(toStringPiece());
 		swap(other);
 	}
@@ -380,7 +386,16 @@ public:
 		return buffer_.capacity();
 	}
 
-	ssize_t readfd(int fd, int* savedErrno);
+	BufferAllocator* allocator() const
+	{
+		return buffer_.get_allocator().allocator();
+	}
+
+	/**
+	 * 从 fd 中读取数据，directBytes 是调用者预计这一次能读到的字节数
+	 * 可写区域不够 directBytes 的时候先扩容，让数据直接读进 buffer，不需要再从栈上拷贝一次
+	*/
+	ssize_t readfd(int fd, int* savedErrno, size_t directBytes = 0);
 
 private:
 	char* begin() { return &*buffer_.begin(); }
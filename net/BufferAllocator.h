@@ -0,0 +1,115 @@
+#ifndef MUDUO_NET_BUFFERALLOCATOR_H
+#define MUDUO_NET_BUFFERALLOCATOR_H
+
+#include <stddef.h>
+
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace muduo
+{
+
+namespace net
+{
+
+/**
+ * Buffer / ChainBuffer 申请内存的接口
+ * allocate / deallocate 可能在不同的线程中调用，实现必须考虑这一点
+*/
+class BufferAllocator
+{
+public:
+	virtual ~BufferAllocator() {}
+
+	virtual void* allocate(size_t n) = 0;
+	virtual void deallocate(void* p, size_t n) = 0;
+
+	/**malloc / free*/
+	static BufferAllocator* defaultAllocator();
+	/**
+	 * 从当前线程的 EventLoop 持有的 BufferPool 中申请内存，当前线程没有 EventLoop 的时候退化为 malloc
+	 * 释放的时候可以在任意的线程
+	*/
+	static BufferAllocator* loopAllocator();
+};
+
+namespace detail
+{
+
+/**
+ * 把 BufferAllocator 包装成 std::vector 可以使用的分配器
+ * 拷贝，移动和交换的时候分配器跟着数据一起走
+*/
+template<typename T>
+class BufferStlAllocator
+{
+public:
+	typedef T value_type;
+	typedef std::true_type propagate_on_container_copy_assignment;
+	typedef std::true_type propagate_on_container_move_assignment;
+	typedef std::true_type propagate_on_container_swap;
+
+	explicit BufferStlAllocator(BufferAllocator* allocator = NULL)
+		: allocator_(allocator ? allocator : BufferAllocator::defaultAllocator())
+	{
+	}
+
+	template<typename U>
+	BufferStlAllocator(const BufferStlAllocator<U>& rhs)
+		: allocator_(rhs.allocator())
+	{
+	}
+
+	T* allocate(size_t n)
+	{
+		return static_cast<T*>(allocator_->allocate(n * sizeof(T)));
+	}
+
+	void deallocate(T* p, size_t n)
+	{
+		allocator_->deallocate(p, n * sizeof(T));
+	}
+
+	/**
+	 * resize() 的时候只做默认初始化，char 不会被清零
+	 * Buffer 不会读取没有写过的内存，省去扩容时候的 memset
+	*/
+	template<typename U>
+	void construct(U* p)
+	{
+		::new (static_cast<void*>(p)) U;
+	}
+
+	template<typename U, typename... Args>
+	void construct(U* p, Args&&... args)
+	{
+		::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
+	}
+
+	BufferAllocator* allocator() const { return allocator_; }
+
+private:
+	BufferAllocator* allocator_;
+};
+
+template<typename T, typename U>
+bool operator==(const BufferStlAllocator<T>& lhs, const BufferStlAllocator<U>& rhs)
+{
+	return lhs.allocator() == rhs.allocator();
+}
+
+template<typename T, typename U>
+bool operator!=(const BufferStlAllocator<T>& lhs, const BufferStlAllocator<U>& rhs)
+{
+	return lhs.allocator() != rhs.allocator();
+}
+
+} // namespace detail
+
+} // namespace net
+
+} // namespace muduo
+
+
+#endif
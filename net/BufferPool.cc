@@ -0,0 +1,388 @@
+#include "net/BufferPool.h"
+
+#include <algorithm>
+#include <new>
+
+#include <assert.h>
+#include <stdlib.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const size_t BufferPool::kHeaderSize;
+const size_t BufferPool::kMaxClassSize;
+const int BufferPool::kNumClasses;
+
+/**
+ * 每一块内存前面的头部
+ * 已经分配出去的时候 : owner 指向所属的 Slab，size 为 0；大块的内存 owner 指向申请它的 BufferPool（可能为 NULL），size 为申请的大小
+ * 空闲的时候 : owner 不变，next 把同一个 slab 中的空闲内存（或者其他线程释放的内存）串起来
+*/
+struct BufferPool::Header
+{
+	void*	owner;
+	union
+	{
+		size_t	size;
+		Header*	next;
+	};
+};
+
+struct BufferPool::Slab
+{
+	BufferPool*	pool;
+	Slab*		prev;		/*所在等级的 partial 链表*/
+	Slab*		next;
+	Header*		freeList;
+	int			index;
+	int			inUse;
+	int			capacity;
+	size_t		bytes;
+};
+
+struct BufferPool::SizeClass
+{
+	SizeClass() : partial(NULL), emptySlabs(0) {}
+
+	Slab*	partial;	/*还有空闲内存的 slab，包括全部空闲的 slab*/
+	int		emptySlabs;
+};
+
+namespace
+{
+
+const size_t kSlabBytes = 64 * 1024;
+const int kMinObjectsPerSlab = 4;
+const size_t kSlabHeaderSize = 64;
+
+__thread BufferPool* t_bufferPool = NULL;
+
+/**只有一个线程修改的计数*/
+template<typename T, typename U>
+inline void localAdd(std::atomic<T>& counter, U delta)
+{
+	counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+template<typename T, typename U>
+inline void localSub(std::atomic<T>& counter, U delta)
+{
+	counter.store(counter.load(std::memory_order_relaxed) - delta, std::memory_order_relaxed);
+}
+
+class MallocAllocator : public BufferAllocator
+{
+public:
+	void* allocate(size_t n) override
+	{
+		void* p = ::malloc(n);
+		if (p == NULL)
+			throw std::bad_alloc();
+		return p;
+	}
+
+	void deallocate(void* p, size_t) override
+	{
+		::free(p);
+	}
+};
+
+class LoopAllocator : public BufferAllocator
+{
+public:
+	void* allocate(size_t n) override
+	{
+		return BufferPool::allocateInThread(n);
+	}
+
+	void deallocate(void* p, size_t) override
+	{
+		BufferPool::deallocate(p);
+	}
+};
+
+} // namespace
+
+BufferAllocator* BufferAllocator::defaultAllocator()
+{
+	static MallocAllocator allocator;
+	return &allocator;
+}
+
+BufferAllocator* BufferAllocator::loopAllocator()
+{
+	static LoopAllocator allocator;
+	return &allocator;
+}
+
+BufferPool* BufferPool::threadPool()
+{
+	return t_bufferPool;
+}
+
+void BufferPool::setThreadPool(BufferPool* pool)
+{
+	t_bufferPool = pool;
+}
+
+/**
+ * 64 是第 0 级，之后每一个 2 的幂次之间分成 4 级
+ * 例如 (1024, 2048] 分成 1280, 1536, 1792, 2048
+*/
+int BufferPool::classIndex(size_t n)
+{
+	assert(n <= kMaxClassSize);
+	if (n <= 64)
+		return 0;
+	int p = 63 - __builtin_clzl(n - 1);		/*2^p < n <= 2^(p+1)*/
+	size_t step = static_cast<size_t>(1) << (p - 2);
+	size_t sub = (n - 1 - (static_cast<size_t>(1) << p)) / step;
+	return (p - 6) * 4 + static_cast<int>(sub) + 1;
+}
+
+size_t BufferPool::classSize(int index)
+{
+	if (index == 0)
+		return 64;
+	int p = (index - 1) / 4 + 6;
+	size_t step = static_cast<size_t>(1) << (p - 2);
+	return (static_cast<size_t>(1) << p) + ((index - 1) % 4 + 1) * step;
+}
+
+BufferPool::BufferPool()
+	:	classes_(new SizeClass[kNumClasses]),
+		maxEmptySlabs_(1),
+		remoteFrees_(NULL),
+		bytesHeld_(0),
+		bytesInUse_(0),
+		slabCount_(0),
+		allocations_(0),
+		remoteLargeFreed_(0)
+{
+	static_assert(sizeof(Header) == kHeaderSize, "Header size");
+	static_assert(sizeof(Slab) <= kSlabHeaderSize, "Slab header size");
+	assert(classSize(kNumClasses - 1) == kMaxClassSize);
+}
+
+/**
+ * 还有没有释放的内存的时候，不能调用析构函数，参考 EventLoop::~EventLoop()
+*/
+BufferPool::~BufferPool()
+{
+	trim();
+	assert(slabCount() == 0);
+	delete[] classes_;
+}
+
+void* BufferPool::allocate(size_t n)
+{
+	localAdd(allocations_, 1);
+	if (n > kMaxClassSize)
+	{
+		Header* header = static_cast<Header*>(::malloc(kHeaderSize + n));
+		if (header == NULL)
+			throw std::bad_alloc();
+		header->owner = this;
+		header->size = n;
+		localAdd(bytesHeld_, n);
+		localAdd(bytesInUse_, n);
+		return reinterpret_cast<char*>(header) + kHeaderSize;
+	}
+
+	int index = classIndex(n);
+	SizeClass& sizeClass = classes_[index];
+	if (sizeClass.partial == NULL)
+	{
+		drainRemoteFrees();
+		if (sizeClass.partial == NULL)
+			newSlab(index);
+	}
+
+	Slab* slab = sizeClass.partial;
+	Header* header = slab->freeList;
+	slab->freeList = header->next;
+	if (slab->inUse++ == 0)
+		--sizeClass.emptySlabs;
+	if (slab->freeList == NULL)
+	{
+		/*slab 已经用完，从 partial 链表中摘下来*/
+		sizeClass.partial = slab->next;
+		if (slab->next)
+			slab->next->prev = NULL;
+		slab->next = NULL;
+	}
+	header->owner = slab;
+	header->size = 0;
+	localAdd(bytesInUse_, classSize(index));
+	return reinterpret_cast<char*>(header) + kHeaderSize;
+}
+
+void* BufferPool::allocateInThread(size_t n)
+{
+	BufferPool* pool = t_bufferPool;
+	if (pool)
+		return pool->allocate(n);
+
+	Header* header = static_cast<Header*>(::malloc(kHeaderSize + n));
+	if (header == NULL)
+		throw std::bad_alloc();
+	header->owner = NULL;
+	header->size = std::max<size_t>(n, 1);
+	return reinterpret_cast<char*>(header) + kHeaderSize;
+}
+
+void BufferPool::deallocate(void* p)
+{
+	if (p == NULL)
+		return;
+
+	Header* header = reinterpret_cast<Header*>(static_cast<char*>(p) - kHeaderSize);
+	if (header->size != 0)
+	{
+		BufferPool* pool = static_cast<BufferPool*>(header->owner);
+		if (pool == t_bufferPool && pool)
+		{
+			localSub(pool->bytesHeld_, header->size);
+			localSub(pool->bytesInUse_, header->size);
+		}
+		else if (pool)
+		{
+			pool->remoteLargeFreed_.fetch_add(header->size, std::memory_order_relaxed);
+		}
+		::free(header);
+		return;
+	}
+
+	Slab* slab = static_cast<Slab*>(header->owner);
+	BufferPool* pool = slab->pool;
+	if (pool == t_bufferPool)
+	{
+		pool->freeLocal(slab, header);
+	}
+	else
+	{
+		/**
+		 * 不是 pool 所在的线程，放入无锁栈，等待 loop 线程回收
+		*/
+		Header* head = pool->remoteFrees_.load(std::memory_order_relaxed);
+		do
+		{
+			header->next = head;
+		} while (!pool->remoteFrees_.compare_exchange_weak(head, header,
+														 std::memory_order_release,
+														 std::memory_order_relaxed));
+	}
+}
+
+void BufferPool::freeLocal(Slab* slab, Header* header)
+{
+	SizeClass& sizeClass = classes_[slab->index];
+	bool wasFull = slab->freeList == NULL;
+	header->next = slab->freeList;
+	slab->freeList = header;
+	localSub(bytesInUse_, classSize(slab->index));
+
+	if (wasFull)
+	{
+		slab->prev = NULL;
+		slab->next = sizeClass.partial;
+		if (sizeClass.partial)
+			sizeClass.partial->prev = slab;
+		sizeClass.partial = slab;
+	}
+
+	if (--slab->inUse == 0)
+	{
+		if (++sizeClass.emptySlabs > maxEmptySlabs_)
+		{
+			--sizeClass.emptySlabs;
+			releaseSlab(slab);
+		}
+	}
+}
+
+void BufferPool::drainRemoteFrees()
+{
+	Header* header = remoteFrees_.exchange(NULL, std::memory_order_acquire);
+	while (header)
+	{
+		Header* next = header->next;
+		freeLocal(static_cast<Slab*>(header->owner), header);
+		header = next;
+	}
+}
+
+void BufferPool::newSlab(int index)
+{
+	size_t stride = classSize(index) + kHeaderSize;
+	int capacity = std::max(static_cast<int>(kSlabBytes / stride), kMinObjectsPerSlab);
+	size_t bytes = kSlabHeaderSize + capacity * stride;
+
+	Slab* slab = static_cast<Slab*>(::malloc(bytes));
+	if (slab == NULL)
+		throw std::bad_alloc();
+	slab->pool = this;
+	slab->prev = NULL;
+	slab->next = classes_[index].partial;
+	slab->freeList = NULL;
+	slab->index = index;
+	slab->inUse = 0;
+	slab->capacity = capacity;
+	slab->bytes = bytes;
+
+	/**
+	 * 从后往前串起来，申请的时候按照地址从低到高
+	*/
+	char* objects = reinterpret_cast<char*>(slab) + kSlabHeaderSize;
+	for (int i = capacity - 1; i >= 0; --i)
+	{
+		Header* header = reinterpret_cast<Header*>(objects + i * stride);
+		header->owner = slab;
+		header->next = slab->freeList;
+		slab->freeList = header;
+	}
+
+	if (classes_[index].partial)
+		classes_[index].partial->prev = slab;
+	classes_[index].partial = slab;
+	++classes_[index].emptySlabs;
+
+	localAdd(slabCount_, 1);
+	localAdd(bytesHeld_, bytes);
+}
+
+/**
+ * slab 必须是全部空闲的，并且在 partial 链表中
+*/
+void BufferPool::releaseSlab(Slab* slab)
+{
+	assert(slab->inUse == 0);
+	SizeClass& sizeClass = classes_[slab->index];
+	if (slab->prev)
+		slab->prev->next = slab->next;
+	else
+		sizeClass.partial = slab->next;
+	if (slab->next)
+		slab->next->prev = slab->prev;
+
+	localSub(slabCount_, 1);
+	localSub(bytesHeld_, slab->bytes);
+	::free(slab);
+}
+
+void BufferPool::trim()
+{
+	drainRemoteFrees();
+	for (int i = 0; i < kNumClasses; ++i)
+	{
+		Slab* slab = classes_[i].partial;
+		while (slab)
+		{
+			Slab* next = slab->next;
+			if (slab->inUse == 0)
+				releaseSlab(slab);
+			slab = next;
+		}
+		classes_[i].emptySlabs = 0;
+	}
+}
@@ -0,0 +1,106 @@
+#ifndef MUDUO_NET_BUFFERPOOL_H
+#define MUDUO_NET_BUFFERPOOL_H
+
+#include "base/noncopyable.h"
+#include "net/BufferAllocator.h"
+
+#include <atomic>
+
+#include <stdint.h>
+
+namespace muduo
+{
+
+namespace net
+{
+
+/**
+ * 每一个 EventLoop 持有一个 BufferPool，为这个线程中的 Buffer 和 ChainBuffer 提供内存
+ *
+ * 1. 64 B ~ 64 KB 之间按照大小分成 41 个等级，每一个 2 的幂次之间有 4 个等级，浪费不超过 25%
+ * 2. 每一个等级的内存从 slab 中切分，一个 slab 至少 64 KB，slab 全部空闲之后可以还给系统
+ * 3. 超过 64 KB 的内存直接使用 malloc
+ *
+ * 每一块内存的前面有 16 个字节的头部，记录它属于哪一个 slab，所以可以在任何线程中释放：
+ * 在其他线程中释放的内存先放入一个无锁的栈，由 loop 线程在下一次申请或者 trim() 的时候回收
+*/
+class BufferPool : noncopyable
+{
+public:
+	static const size_t kHeaderSize = 16;
+	static const size_t kMaxClassSize = 64 * 1024;
+
+	BufferPool();
+	~BufferPool();
+
+	/**只能在持有这个 pool 的线程中调用*/
+	void* allocate(size_t n);
+	/**从当前线程的 pool 中申请，当前线程没有 pool 的时候使用 malloc，同样带有头部*/
+	static void* allocateInThread(size_t n);
+	/**任意的线程，可以释放上面两个函数申请的内存*/
+	static void deallocate(void* p);
+
+	/**
+	 * 回收其他线程释放的内存，并把全部空闲的 slab 还给系统
+	 * 只能在持有这个 pool 的线程中调用
+	*/
+	void trim();
+
+	/**
+	 * 每一个等级最多保留多少个全部空闲的 slab，超过的部分马上还给系统，默认为 1
+	*/
+	void setMaxEmptySlabs(int n) { maxEmptySlabs_ = n; }
+
+	/**
+	 * 统计数据，可以在任意的线程中读取
+	 * bytesHeld : 从系统申请的内存，包括 slab 和大块的内存
+	 * bytesInUse : 已经分配出去，还没有释放的内存
+	*/
+	size_t bytesHeld() const
+	{ return bytesHeld_.load(std::memory_order_relaxed) - remoteLargeFreed_.load(std::memory_order_relaxed); }
+	size_t bytesInUse() const
+	{ return bytesInUse_.load(std::memory_order_relaxed) - remoteLargeFreed_.load(std::memory_order_relaxed); }
+	size_t slabCount() const { return slabCount_.load(std::memory_order_relaxed); }
+	int64_t allocations() const { return allocations_.load(std::memory_order_relaxed); }
+
+	/**当前线程的 EventLoop 持有的 pool，没有的时候返回 NULL*/
+	static BufferPool* threadPool();
+	/**EventLoop 创建和销毁的时候设置*/
+	static void setThreadPool(BufferPool* pool);
+
+private:
+	struct Slab;
+	struct SizeClass;
+	struct Header;
+
+	static const int kNumClasses = 41;
+
+	static int classIndex(size_t n);
+	static size_t classSize(int index);
+
+	void newSlab(int index);
+	void releaseSlab(Slab* slab);
+	void freeLocal(Slab* slab, Header* header);
+	void drainRemoteFrees();
+
+	SizeClass* classes_;
+	int maxEmptySlabs_;
+	std::atomic<Header*> remoteFrees_;	/*其他线程释放的内存，多生产者单消费者*/
+
+	/**
+	 * 下面的计数只有 loop 线程会修改，使用 relaxed 的 load + store，不需要 lock 前缀的指令
+	 * 其他线程释放的大块内存累加在 remoteLargeFreed_ 中
+	*/
+	std::atomic<size_t> bytesHeld_;
+	std::atomic<size_t> bytesInUse_;
+	std::atomic<size_t> slabCount_;
+	std::atomic<int64_t> allocations_;
+	std::atomic<size_t> remoteLargeFreed_;
+};
+
+} // namespace net
+
+} // namespace muduo
+
+
+#endif
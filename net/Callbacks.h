@@ -1,6 +1,7 @@
 #ifndef MUDUO_NET_CALLBACKS_H
 #define MUDUO_NET_CALLBACKS_H
 
+#include "base/InlineFunction.h"
 #include "base/Timestamp.h"
 
 #include <functional>
@@ -47,7 +48,7 @@ class Buffer; /*类的声明*/
 class TcpConnection;
 
 typedef std::shared_ptr<TcpConnection> TcpConnectionPtr;
-typedef std::function<void()> TimerCallback;
+typedef InlineFunction<void ()> TimerCallback;	/*只能移动，参考 InlineFunction*/
 typedef std::function<void (const TcpConnectionPtr&)> ConnectionCallback;
 typedef std::function<void (const TcpConnectionPtr&)> CloseCallback;
 typedef std::function<void (const TcpConnectionPtr&)> WriteCompleteCallback;
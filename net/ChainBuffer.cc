@@ -0,0 +1,369 @@
+#include "net/ChainBuffer.h"
+#include "net/SocketsOps.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/uio.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const size_t ChainBuffer::kBlockSize;
+const size_t ChainBuffer::kCheapPrepend;
+const size_t ChainBuffer::kMinExternalSlice;
+
+/**
+ * 从分配器申请的块，数据紧跟在头部的后面
+ * 外部的块 (ExternalBlock) 只引用 appendSlice() 传入的数据，不可写
+*/
+struct ChainBuffer::Block
+{
+	static const size_t kDataSize;
+
+	size_t readable() const { return writerIndex - readerIndex; }
+	size_t writable() const { return capacity - writerIndex; }
+	char* beginRead() { return data + readerIndex; }
+	char* beginWrite() { return data + writerIndex; }
+
+	Block*	next;
+	size_t	readerIndex;
+	size_t	writerIndex;
+	size_t	capacity;
+	char*	data;
+	bool	external;
+};
+
+const size_t ChainBuffer::Block::kDataSize = ChainBuffer::kBlockSize - sizeof(ChainBuffer::Block);
+
+struct ChainBuffer::ExternalBlock : public ChainBuffer::Block
+{
+	std::shared_ptr<const void> owner;
+};
+
+namespace
+{
+
+const int kMaxIovec = 64;		/*一次 writev() 最多写多少个块*/
+const int kReadBlocks = 4;		/*readfd() 最多额外准备多少个新的块，64 KB*/
+
+} // namespace
+
+ChainBuffer::Block* ChainBuffer::allocBlock()
+{
+	void* memory = allocator_->allocate(kBlockSize);
+	Block* block = static_cast<Block*>(memory);
+	block->next = NULL;
+	block->readerIndex = kCheapPrepend;
+	block->writerIndex = kCheapPrepend;
+	block->capacity = Block::kDataSize;
+	block->data = static_cast<char*>(memory) + sizeof(Block);
+	block->external = false;
+	++blockCount_;
+	return block;
+}
+
+void ChainBuffer::freeBlock(Block* block)
+{
+	if (block->external)
+	{
+		delete static_cast<ExternalBlock*>(block);
+	}
+	else
+	{
+		allocator_->deallocate(block, kBlockSize);
+		--blockCount_;
+	}
+}
+
+ChainBuffer::ChainBuffer(BufferAllocator* allocator)
+	:	head_(NULL),
+		tail_(NULL),
+		readableBytes_(0),
+		blockCount_(0),
+		allocator_(allocator ? allocator : BufferAllocator::defaultAllocator())
+{
+}
+
+ChainBuffer::ChainBuffer(ChainBuffer&& rhs)
+	:	head_(rhs.head_),
+		tail_(rhs.tail_),
+		readableBytes_(rhs.readableBytes_),
+		blockCount_(rhs.blockCount_),
+		allocator_(rhs.allocator_)
+{
+	rhs.head_ = rhs.tail_ = NULL;
+	rhs.readableBytes_ = 0;
+	rhs.blockCount_ = 0;
+}
+
+ChainBuffer::~ChainBuffer()
+{
+	clear();
+}
+
+void ChainBuffer::swap(ChainBuffer& rhs)
+{
+	std::swap(head_, rhs.head_);
+	std::swap(tail_, rhs.tail_);
+	std::swap(readableBytes_, rhs.readableBytes_);
+	std::swap(blockCount_, rhs.blockCount_);
+	std::swap(allocator_, rhs.allocator_);
+}
+
+void ChainBuffer::clear()
+{
+	while (head_)
+	{
+		Block* next = head_->next;
+		freeBlock(head_);
+		head_ = next;
+	}
+	tail_ = NULL;
+	readableBytes_ = 0;
+	assert(blockCount_ == 0);
+}
+
+void ChainBuffer::pushBack(Block* block)
+{
+	if (tail_)
+		tail_->next = block;
+	else
+		head_ = block;
+	tail_ = block;
+}
+
+/**
+ * 只有在缓冲区只剩下一个块的时候，第一个块才可能是空的
+*/
+const char* ChainBuffer::peek() const
+{
+	return head_ ? head_->data + head_->readerIndex : NULL;
+}
+
+size_t ChainBuffer::contiguousBytes() const
+{
+	return head_ ? head_->readable() : 0;
+}
+
+size_t ChainBuffer::peek(void* dst, size_t len) const
+{
+	char* out = static_cast<char*>(dst);
+	size_t copied = 0;
+	for (Block* b = head_; b && copied < len; b = b->next)
+	{
+		size_t n = std::min(len - copied, b->readable());
+		::memcpy(out + copied, b->data + b->readerIndex, n);
+		copied += n;
+	}
+	return copied;
+}
+
+void ChainBuffer::retrieve(size_t len)
+{
+	assert(len <= readableBytes_);
+	readableBytes_ -= len;
+	while (len > 0)
+	{
+		Block* b = head_;
+		size_t n = std::min(len, b->readable());
+		b->readerIndex += n;
+		len -= n;
+		if (b->readable() == 0)
+		{
+			if (b == tail_ && !b->external)
+			{
+				/**
+				 * 最后一个块留下来重复使用，避免缓冲区反复的空和非空时不停的申请释放
+				*/
+				b->readerIndex = kCheapPrepend;
+				b->writerIndex = kCheapPrepend;
+			}
+			else
+			{
+				head_ = b->next;
+				if (b == tail_)
+					tail_ = NULL;
+				freeBlock(b);
+			}
+		}
+	}
+}
+
+void ChainBuffer::retrieveAll()
+{
+	retrieve(readableBytes_);
+}
+
+void ChainBuffer::shrink()
+{
+	if (readableBytes_ == 0)
+		clear();
+}
+
+string ChainBuffer::retrieveAsString(size_t len)
+{
+	assert(len <= readableBytes_);
+	string result;
+	result.resize(len);
+	if (len > 0)
+	{
+		peek(&*result.begin(), len);
+		retrieve(len);
+	}
+	return result;
+}
+
+void ChainBuffer::append(const void* data, size_t len)
+{
+	const char* in = static_cast<const char*>(data);
+	readableBytes_ += len;
+	while (len > 0)
+	{
+		if (tail_ == NULL || tail_->writable() == 0)
+			pushBack(allocBlock());
+		size_t n = std::min(len, tail_->writable());
+		::memcpy(tail_->beginWrite(), in, n);
+		tail_->writerIndex += n;
+		in += n;
+		len -= n;
+	}
+}
+
+/**
+ * 小的数据拷贝比单独挂一个外部的块更便宜
+ * 最后一个块是空的（只可能是唯一的一个块）的时候先释放掉，保证只有最后一个块可能是空的
+*/
+void ChainBuffer::appendSlice(const char* data, size_t len, const std::shared_ptr<const void>& owner)
+{
+	if (!owner || len < kMinExternalSlice)
+	{
+		append(data, len);
+		return;
+	}
+	if (tail_ && tail_->readable() == 0)
+	{
+		assert(head_ == tail_);
+		freeBlock(tail_);
+		head_ = tail_ = NULL;
+	}
+	ExternalBlock* block = new ExternalBlock;
+	block->next = NULL;
+	block->readerIndex = 0;
+	block->writerIndex = len;
+	block->capacity = len;
+	block->data = const_cast<char*>(data);
+	block->external = true;
+	block->owner = owner;
+	pushBack(block);
+	readableBytes_ += len;
+}
+
+void ChainBuffer::prepend(const void* data, size_t len)
+{
+	assert(len <= Block::kDataSize);
+	if (head_ && head_->readable() == 0)
+	{
+		/*空的块，把读写指针移动到刚好可以放下 len 个字节的位置*/
+		head_->readerIndex = std::max(len, kCheapPrepend);
+		head_->writerIndex = head_->readerIndex;
+	}
+	if (head_ == NULL || head_->external || head_->readerIndex < len)
+	{
+		Block* block = allocBlock();
+		block->readerIndex = Block::kDataSize;
+		block->writerIndex = Block::kDataSize;
+		block->next = head_;
+		head_ = block;
+		if (tail_ == NULL)
+			tail_ = block;
+	}
+	head_->readerIndex -= len;
+	::memcpy(head_->beginRead(), data, len);
+	readableBytes_ += len;
+}
+
+int ChainBuffer::fillIovec(struct iovec* iov, int maxIov) const
+{
+	int count = 0;
+	for (Block* b = head_; b && count < maxIov; b = b->next)
+	{
+		if (b->readable() > 0)
+		{
+			iov[count].iov_base = b->data + b->readerIndex;
+			iov[count].iov_len = b->readable();
+			++count;
+		}
+	}
+	return count;
+}
+
+ssize_t ChainBuffer::writefd(int fd, int* savedErrno)
+{
+	struct iovec vec[kMaxIovec];
+	int iovcnt = fillIovec(vec, kMaxIovec);
+	ssize_t n = sockets::writev(fd, vec, iovcnt);
+	if (n < 0)
+	{
+		*savedErrno = errno;
+	}
+	else
+	{
+		retrieve(n);
+	}
+	return n;
+}
+
+/**
+ * 和 Buffer::readfd 不同，多读出来的数据不需要先放到栈上再拷贝一次
+ * 新的块来自 BufferPool，没有用到的块马上就还回去，代价很小
+*/
+ssize_t ChainBuffer::readfd(int fd, int* savedErrno)
+{
+	struct iovec vec[kReadBlocks + 1];
+	Block* fresh[kReadBlocks];
+	int iovcnt = 0;
+	size_t tailWritable = tail_ ? tail_->writable() : 0;
+	if (tailWritable > 0)
+	{
+		vec[iovcnt].iov_base = tail_->beginWrite();
+		vec[iovcnt].iov_len = tailWritable;
+		++iovcnt;
+	}
+	for (int i = 0; i < kReadBlocks; ++i)
+	{
+		fresh[i] = allocBlock();
+		vec[iovcnt].iov_base = fresh[i]->beginWrite();
+		vec[iovcnt].iov_len = fresh[i]->writable();
+		++iovcnt;
+	}
+
+	const ssize_t n = sockets::readv(fd, vec, iovcnt);
+	if (n < 0)
+	{
+		*savedErrno = errno;
+	}
+
+	size_t left = n > 0 ? static_cast<size_t>(n) : 0;
+	readableBytes_ += left;
+	if (tailWritable > 0)
+	{
+		size_t used = std::min(left, tailWritable);
+		tail_->writerIndex += used;
+		left -= used;
+	}
+	for (int i = 0; i < kReadBlocks; ++i)
+	{
+		if (left > 0)
+		{
+			size_t used = std::min(left, fresh[i]->writable());
+			fresh[i]->writerIndex += used;
+			left -= used;
+			pushBack(fresh[i]);
+		}
+		else
+		{
+			freeBlock(fresh[i]);
+		}
+	}
+	return n;
+}
@@ -0,0 +1,118 @@
+#ifndef MUDUO_NET_CHAINBUFFER_H
+#define MUDUO_NET_CHAINBUFFER_H
+
+#include "base/noncopyable.h"
+#include "base/StringPiece.h"
+#include "base/Types.h"
+#include "net/BufferAllocator.h"
+
+#include <algorithm>
+#include <memory>
+
+#include <assert.h>
+#include <sys/types.h>
+
+struct iovec;
+
+namespace muduo
+{
+
+namespace net
+{
+
+/**
+ * 由固定大小的块串起来的缓冲区
+ *
+ *  head_                                   tail_
+ *  +---------------+    +---------------+    +---------------+
+ *  | 已读 | 可读    | -> |     可读       | -> | 可读 | 可写    |
+ *  +---------------+    +---------------+    +---------------+
+ *
+ * 和 Buffer 相比，写入大量的数据时不需要 vector 翻倍扩容，读走数据之后也不需要 memmove 把剩下的数据
+ * 搬回到前面，读完的块直接还给分配器（默认是当前线程的 EventLoop 持有的 BufferPool）
+ * 适合作为发送缓冲区：对端很慢的时候积压的数据可能有几十 MB
+ * 缺点是数据不连续，需要解析协议的输入缓冲区还是使用 Buffer
+ *
+ * 发送的时候通过 writev() 一次把多个块写到 socket，读取的时候通过 readv() 直接读到块里面
+*/
+class ChainBuffer : noncopyable
+{
+public:
+	static const size_t kBlockSize = 16 * 1024;	/*每一个块占用的内存，包括块的头部*/
+	static const size_t kCheapPrepend = 8;		/*新的块前面预留的空间，prepend 的时候不需要分配新的块*/
+	static const size_t kMinExternalSlice = 1024;	/*appendSlice() 中比这个小的数据直接拷贝*/
+
+	explicit ChainBuffer(BufferAllocator* allocator = BufferAllocator::loopAllocator());
+	ChainBuffer(ChainBuffer&& rhs);
+	~ChainBuffer();
+
+	void swap(ChainBuffer& rhs);
+
+	size_t readableBytes() const { return readableBytes_; }
+
+	/**
+	 * 第一个块中可读的数据，peek() 返回的指针之后只有 contiguousBytes() 个字节是连续的
+	*/
+	const char* peek() const;
+	size_t contiguousBytes() const;
+	/**从可读的数据中拷贝 len 个字节到 dst，不移动读指针，返回实际拷贝的字节数*/
+	size_t peek(void* dst, size_t len) const;
+
+	void retrieve(size_t len);
+	void retrieveAll();
+	string retrieveAsString(size_t len);
+	string retrieveAllAsString() { return retrieveAsString(readableBytes_); }
+
+	void append(const StringPiece& str) { append(str.data(), str.size()); }
+	void append(const void* data, size_t len);
+	/**
+	 * 不拷贝数据，把 [data, data + len) 作为一个块挂在最后，owner 保证取走之前数据一直有效
+	 * owner 为空或者数据很小的时候和 append() 一样拷贝
+	*/
+	void appendSlice(const char* data, size_t len, const std::shared_ptr<const void>& owner);
+
+	/**在可读区域的前面插入一段数据，第一个块前面的空间不够的时候在最前面插入一个新的块*/
+	void prepend(const void* data, size_t len);
+
+	/**
+	 * 把可读的数据填入 iov，最多 maxIov 个，返回填入的个数
+	*/
+	int fillIovec(struct iovec* iov, int maxIov) const;
+
+	/**通过 writev() 把尽可能多的数据写到 fd，写入的部分从缓冲区中取走*/
+	ssize_t writefd(int fd, int* savedErrno);
+	/**通过 readv() 读取数据，最后一个块剩余的空间不够的时候，直接读到新的块中*/
+	ssize_t readfd(int fd, int* savedErrno);
+
+	/**
+	 * 缓冲区为空的时候，把保留下来重复使用的块也还给分配器
+	*/
+	void shrink();
+
+	/*从分配器申请的块的个数，不包括 appendSlice() 挂上的外部数据*/
+	size_t blockCount() const { return blockCount_; }
+	size_t internalCapacity() const { return blockCount_ * kBlockSize; }
+
+private:
+	struct Block;
+	struct ExternalBlock;
+
+	Block* allocBlock();
+	void freeBlock(Block* block);
+
+	void pushBack(Block* block);
+	void clear();
+
+	Block* head_;
+	Block* tail_;
+	size_t readableBytes_;
+	size_t blockCount_;
+	BufferAllocator* allocator_;
+};
+
+} // namespace net
+
+} // namespace muduo
+
+
+#endif
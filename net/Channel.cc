@@ -23,6 +23,9 @@ Channel::Channel(EventLoop* loop, int fd_)
         revents_(0),
         index_(-1),
         logHup_(true),
+        edgeTriggered_(false),
+        updatePending_(false),
+        polledEvents_(-1),
         tied_(false),
         eventHandling_(false),
         addedToLoop_(false)
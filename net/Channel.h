@@ -54,7 +54,7 @@ public:
 
 	int events() const { return events_; }
 	void set_revents(int revt) { revents_ = revt; } // used by pollers
-	// int revents() const { return revents_; }
+	int revents() const { return revents_; }
 	bool isNoneEvent() const { return events_ == kNoneEvent; }
 
 	void enableReading() { events_ |= kReadEvent; update(); }
@@ -62,9 +62,18 @@ public:
 	void enableWriting() { events_ |= kWriteEvent; update(); }
 	void disableWriting() { events_ &= ~kWriteEvent; update(); }
 	void disableAll() { events_ = kNoneEvent; update(); }
+	/**同时关注读和写，只需要一次 update()*/
+	void enableAll() { events_ = kReadEvent | kWriteEvent; update(); }
 	bool isWriting() const { return events_ & kWriteEvent; }
 	bool isReading() const { return events_ & kReadEvent; }
 
+	/**
+	 * 边沿触发，只对 EPollPoller 有效，在第一次 update() 之前设置
+	 * 使用者必须把数据读写完，否则不会再收到通知。同时关注 EPOLLRDHUP，对端关闭的时候 revents() 中会带上
+	*/
+	void setEdgeTriggered(bool on) { edgeTriggered_ = on; }
+	bool isEdgeTriggered() const { return edgeTriggered_; }
+
 
 	// for Poller
 	/**
@@ -74,6 +83,16 @@ public:
 	int index() { return index_; }
 	void set_index(int idx) { index_ = idx; }
 
+	// for EventLoop
+	/**
+	 * update() 只是把 Channel 放入 EventLoop 的待更新列表，在下一次 poll 之前统一交给 Poller
+	 * polledEvents() 是上一次交给 Poller 的事件，-1 表示 Poller 中还没有这个 Channel
+	*/
+	bool updatePending() const { return updatePending_; }
+	void setUpdatePending(bool on) { updatePending_ = on; }
+	int polledEvents() const { return polledEvents_; }
+	void setPolledEvents(int events) { polledEvents_ = events; }
+
 	// for debug
 	string reventsToString() const;
 	string eventsToString() const;
@@ -109,6 +128,9 @@ private:
 	*/
 	int        index_; // used by Poller.
 	bool       logHup_;	/*是否对 hup 进行日志的记录*/
+	bool       edgeTriggered_;
+	bool       updatePending_;
+	int        polledEvents_;
 
 	std::weak_ptr<void> tie_;
 	bool tied_;
@@ -1,6 +1,6 @@
 #include "net/EventLoop.h"
-#include "base/Mutex.h"
 #include "base/Logging.h"
+#include "net/BufferPool.h"
 #include "net/Channel.h"
 #include "net/Poller.h"
 #include "net/SocketsOps.h"
@@ -25,6 +25,7 @@ __thread EventLoop* t_loopInThisThread = 0;
 */
 
 const int kPollTimeMs = 10000;
+const int kMaxDrainRounds = 16;    /*loop() 返回之前最多再执行几轮回调，回调不断投递新的回调的时候也能退出*/
 
 /**
  * 目前越来越多的应用程序采用事件驱动的方式实现功能，如何高效地利用系统资源实现通知的管理和送达就愈发变得重要起来。
@@ -90,11 +91,21 @@ EventLoop::EventLoop()
         callingPendingFunctors_(false),
         iteration_(0),
         threadId_(CurrentThread::tid()),
+        bufferPool_(new BufferPool),
+        bufferCapacity_(0),
+        channelUpdates_(0),
+        pollerUpdates_(0),
         poller_(Poller::newDefaultPoller(this)),
         timerQueue_(new TimerQueue(this)),
         wakeupFd_(createEventfd()),
         wakeupChannel_(new Channel(this, wakeupFd_)), /**/
-        currentActiveChannel_(NULL)
+        currentActiveChannel_(NULL),
+        wakeupPending_(false),
+        wakeups_(0),
+        numConnections_(0),
+        busyPermille_(0),
+        busyMicroSeconds_(0),
+        windowMicroSeconds_(0)
 {
     LOG_DEBUG << "Eventloop Create " << this << " in thread " << threadId_;
     /**
@@ -107,6 +118,7 @@ EventLoop::EventLoop()
     else
     {
         t_loopInThisThread = this;
+        BufferPool::setThreadPool(bufferPool_.get());
         LOG_INFO << "set the t_loopInThisThread " << this << " : " << threadId_;
     }
     this->wakeupChannel_->setReadCallback(
@@ -119,10 +131,37 @@ EventLoop::~EventLoop()
 {
     LOG_DEBUG << "EventLoop " << this << " of thread " << threadId_
             << " destructs in thread " << CurrentThread::tid();
+    /**
+     * 这里不再执行任何回调：很多回调持有裸的 this（Connector、TcpServer 等），它们的所有者此时可能已经析构了，
+     * quit() 之前投递的回调已经在 loop() 返回之前执行过了
+     * 剩下的回调和定时器只是销毁，它们持有的 TcpConnection 和 Buffer 在检查 bufferPool_ 之前释放，
+     * Poller 和 Channel 此时都还有效
+    */
+    timerQueue_.reset();
+    pendingFunctors_.consumeAll([](Functor&) {});
+    flushChannelUpdates();
     wakeupChannel_->disableAll();
     wakeupChannel_->remove();
     ::close(wakeupFd_);
     t_loopInThisThread = NULL;
+    BufferPool::setThreadPool(NULL);
+
+    /**
+     * 还有 Buffer 没有释放的时候（例如 TcpConnection 比 EventLoop 活得更久），pool 不能析构，
+     * 之后这些内存释放的时候会放入 pool 的无锁栈，不会访问已经析构的对象
+    */
+    bufferPool_->trim();
+    if (bufferPool_->bytesInUse() > 0)
+    {
+        LOG_WARN << "EventLoop " << this << " destructs with "
+                 << bufferPool_->bytesInUse() << " bytes of buffers in use, leak the BufferPool";
+        bufferPool_.release();
+    }
+}
+
+void EventLoop::setBufferPoolTrimInterval(double seconds)
+{
+    runEvery(seconds, std::bind(&BufferPool::trim, bufferPool_.get()));
 }
 
 /**
@@ -137,12 +176,15 @@ void EventLoop::loop()
     this->looping_ = true;
     this->quit_ = false;    /* 结束标志设置为 false, 保证 while() 循环*/
     LOG_TRACE << "EventLoop " << this << " starting loop ";
+    this->lastIterationEnd_ = Timestamp::now();
 
     /**
      * 所有的事件都会在 EventLoop::loop() 中通过 Channel 来进行分发
     */
     while (!quit_)
     {
+        this->timerQueue_->rearmIfPending();   /*本次循环中推迟的 timerfd 设置在 poll 之前统一完成*/
+        this->flushChannelUpdates();    /*同样，本次循环中 Channel 关注的事件的修改也在这里统一完成*/
         this->activeChannels_.clear();
         pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
         /**
@@ -168,7 +210,17 @@ void EventLoop::loop()
         /**
          * 除了上面的由 poll 触发的事件以外，还有各个组件直接添加到 loop 中的事件需要进行处理
         */
+        this->updateBusyRatio(Timestamp::now());
     }
+    /**
+     * 退出循环的时候队列中可能还有回调（例如 TcpServer 析构时投递的 connectDestroyed()），
+     * 在 loop() 返回之前执行完，这时投递它们的对象都还有效，析构函数中就只需要丢弃剩下的
+    */
+    for (int round = 0; round < kMaxDrainRounds && !pendingFunctors_.empty(); ++round)
+    {
+        this->doPendingFunctors();
+    }
+    this->flushChannelUpdates();
     LOG_TRACE << "EventLoop " << this << " stop looping ";
     this->looping_ = false;
 }
@@ -209,24 +261,43 @@ void EventLoop::runInLoop(Functor cb)
 void EventLoop::queueInLoop(Functor cb)
 {
     LOG_INFO << "push Functor into the eventloop :" << this;
-    {
-        MutexLockGuard lock(mutex_);
-        pendingFunctors_.push_back(std::move(cb));  /**把句柄 cb 放入到待执行队列当中*/
-    }
+    pendingFunctors_.push(std::move(cb));  /**把句柄 cb 放入到待执行队列当中*/
 
     if (!isInLoopThread() || callingPendingFunctors_)
     /**
      * 如果添加任务的线程和 loop 所在的线程不是同一个线程，或者 loop 正在执行 pendingFunctors_则执行唤醒
+     * 已经有别的线程唤醒过 loop 并且 loop 还没有开始处理的话，不需要再唤醒，loop 会一起处理
+     * exchange() 在 push() 之后，doPendingFunctors() 把标志清除之后一定能看到这里放入的回调
     */
     {
-        wakeup();
+        if (!wakeupPending_.exchange(true, std::memory_order_acq_rel))
+            wakeup();
     }
 }
 
 
+/**
+ * poll 返回到这一轮结束是忙的时间，上一轮结束到 poll 返回是空闲的时间（主要是阻塞在 poll 中）
+ * 每累计 kBusyWindow 的时间更新一次，和上一个窗口的值平均，避免一次突发的大量事件让负载跳得太厉害
+*/
+void EventLoop::updateBusyRatio(Timestamp now)
+{
+    static const int64_t kBusyWindow = 100 * 1000;  // 100 ms
+    busyMicroSeconds_ += now.microSecondsSinceEpoch() - pollReturnTime_.microSecondsSinceEpoch();
+    windowMicroSeconds_ += now.microSecondsSinceEpoch() - lastIterationEnd_.microSecondsSinceEpoch();
+    lastIterationEnd_ = now;
+    if (windowMicroSeconds_ >= kBusyWindow)
+    {
+        int permille = static_cast<int>(busyMicroSeconds_ * 1000 / windowMicroSeconds_);
+        busyPermille_.store((busyPermille_.load(std::memory_order_relaxed) + permille) / 2,
+                            std::memory_order_relaxed);
+        busyMicroSeconds_ = 0;
+        windowMicroSeconds_ = 0;
+    }
+}
+
 size_t EventLoop::queueSize() const
 {
-    MutexLockGuard lock(this->mutex_);
     return this->pendingFunctors_.size();
 }
 
@@ -254,11 +325,58 @@ void EventLoop::cancel(TimerId timerid)
     timerQueue_->cancel(timerid);
 }
 
+void EventLoop::setTimerQueueOption(TimerQueueOption option)
+{
+    assertInLoopThread();
+    timerQueue_->setOption(option);
+}
+
+void EventLoop::setTimerRearmDeferred(bool on)
+{
+    assertInLoopThread();
+    timerQueue_->setRearmDeferred(on);
+}
+
+void EventLoop::setTimerSlack(double seconds)
+{
+    assertInLoopThread();
+    timerQueue_->setSlack(seconds);
+}
+
+/**
+ * 不立即修改 Poller，一次循环中同一个 Channel 的多次修改（例如写满了 enableWriting()，马上又写完了 disableWriting()）
+ * 在 poll 之前合并成一次，和上一次交给 Poller 的事件相同的话就什么都不做
+*/
 void EventLoop::updateChannel(Channel* channel)
 {
     assert(channel->ownerLoop() == this);
     assertInLoopThread();
-    poller_->updateChannel(channel);
+    ++channelUpdates_;
+    if (!channel->updatePending())
+    {
+        channel->setUpdatePending(true);
+        dirtyChannels_.push_back(channel);
+    }
+}
+
+void EventLoop::flushChannelUpdates()
+{
+    for (Channel* channel : dirtyChannels_)
+    {
+        if (channel == NULL)
+            continue;   /*已经 removeChannel()*/
+        channel->setUpdatePending(false);
+        /*没有交给过 Poller 并且现在也不关注任何事件的 Channel 也不需要修改*/
+        bool unchanged = channel->events() == channel->polledEvents() ||
+                         (channel->polledEvents() < 0 && channel->isNoneEvent());
+        if (!unchanged)
+        {
+            poller_->updateChannel(channel);
+            channel->setPolledEvents(channel->events());
+            ++pollerUpdates_;
+        }
+    }
+    dirtyChannels_.clear();
 }
 
 
@@ -276,7 +394,22 @@ void EventLoop::removeChannel(Channel* channel)
         */
     }
 
-    poller_->removeChannel(channel);
+    if (channel->updatePending())
+    {
+        *std::find(dirtyChannels_.begin(), dirtyChannels_.end(), channel) = NULL;
+        channel->setUpdatePending(false);
+        /*Poller 中还是修改之前的事件，先同步 (一般是 disableAll())，Poller::removeChannel() 要求两边一致*/
+        if (channel->polledEvents() >= 0 && channel->events() != channel->polledEvents())
+        {
+            poller_->updateChannel(channel);
+            ++pollerUpdates_;
+        }
+    }
+    if (channel->polledEvents() >= 0)   /*从来没有交给过 Poller 的 Channel 不需要从 Poller 中删除*/
+    {
+        poller_->removeChannel(channel);
+        channel->setPolledEvents(-1);
+    }
 }
 
 bool EventLoop::hasChannel(Channel* channel)
@@ -286,6 +419,17 @@ bool EventLoop::hasChannel(Channel* channel)
     return this->poller_->hasChannel(channel);
 }
 
+bool EventLoop::supportsEdgeTriggered() const
+{
+    return this->poller_->supportsEdgeTriggered();
+}
+
+int64_t EventLoop::pollerControlCalls() const
+{
+    assert(isInLoopThread());
+    return this->poller_->controlCalls();
+}
+
 /**
  * 如果尝试从其他的线程来调用这个 eveltloop 的某一些函数将会发出致命错误
 */
@@ -319,25 +463,25 @@ void EventLoop::handleRead()
     {
         LOG_ERROR << "EventLoop::handleRead() reads " << n << " bytes instead of 8";
     }
+    else
+    {
+        wakeups_ += static_cast<int64_t>(one);  /*eventfd 的值是上一次读之后 wakeup() 的次数*/
+    }
 }
 
 void EventLoop::doPendingFunctors()
 {
-    std::vector<Functor> functors;
     this->callingPendingFunctors_ = true;
-
-    {
-        MutexLockGuard lock(this->mutex_);
-        functors.swap(this->pendingFunctors_);
-    }
+    /**
+     * 先清除标志再取出回调，之后 queueInLoop() 的线程会重新唤醒 loop
+     * 这一次来不及处理的回调不会在 poll 中等待
+    */
+    this->wakeupPending_.exchange(false, std::memory_order_acq_rel);
 
     /**
-     * 一次性执行完这里面的所有的句柄
+     * 一次性执行完这里面的所有的句柄，执行过程中新加入的留到下一次循环
     */
-    for (const Functor& functor : functors)
-    {
-        functor();
-    }
+    this->pendingFunctors_.consumeAll([](Functor& functor) { functor(); });
 
     this->callingPendingFunctors_ = false;
 }
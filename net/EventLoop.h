@@ -10,6 +10,7 @@
 
 #include "base/Mutex.h"
 #include "base/CurrentThread.h"
+#include "base/MpscQueue.h"
 #include "base/Timestamp.h"
 #include "net/Callbacks.h"
 #include "net/TimerId.h"
@@ -19,6 +20,7 @@ namespace muduo
 namespace net
 {
 
+class BufferPool;
 class Channel;
 class Poller;
 class TimerQueue;
@@ -35,7 +37,18 @@ class TimerQueue;
 class EventLoop : noncopyable
 {
 public:
-	typedef std::function<void ()> Functor;
+	typedef InlineFunction<void ()> Functor;	/*只能移动，不超过 64 字节的回调不需要分配内存*/
+
+	/**
+	 * TimerQueue 中定时器的存储方式
+	 * kTimerSet : std::set 红黑树，每一次添加和取消都要分配和释放节点
+	 * kTimerHeap : 4 叉最小堆，timer 记录自己在堆中的下标，取消的时候不需要查找，timer 对象回收复用
+	*/
+	enum TimerQueueOption
+	{
+		kTimerSet,
+		kTimerHeap,
+	};
 
 	EventLoop();
 	~EventLoop();
@@ -60,9 +73,15 @@ public:
 	*/
 	void runInLoop(Functor cb);
 
+	/**
+	 * 线程安全的，pendingFunctors_ 是无锁队列，多个线程同时调用不会互相等待
+	 * loop 处理这些回调之前只有第一次调用会唤醒 loop，参考 wakeupPending_
+	*/
 	void queueInLoop(Functor cb);
 
 	size_t queueSize() const;
+	/**被唤醒的次数（wakeup() 写 eventfd 的次数），只能在 loop 线程中调用*/
+	int64_t wakeups() const { return wakeups_; }
 
 	/**
 	 * 在 时间 time 调用 cb 回调函数
@@ -88,6 +107,58 @@ public:
 	///
   	void cancel(TimerId timerId);
 
+	/**
+	 * 选择定时器的存储方式
+	 * 必须在 loop 线程中，在添加任何 timer 之前调用，例如在 EventLoopThread 的 ThreadInitCallback 当中
+	*/
+	void setTimerQueueOption(TimerQueueOption option);
+
+	/**
+	 * 合并 timerfd_settime() 调用，必须在 loop 线程中调用
+	 * 参考 TimerQueue::setRearmDeferred() 和 TimerQueue::setSlack()
+	*/
+	void setTimerRearmDeferred(bool on);
+	void setTimerSlack(double seconds);
+
+	/// 只读访问，用于获取定时器的统计数据，只能在 loop 线程中使用
+	const TimerQueue* timerQueue() const { return timerQueue_.get(); }
+
+	/**
+	 * 这个 loop 线程中 Buffer / ChainBuffer 使用的内存池，统计数据可以在任意线程中读取
+	 * 每 seconds 秒调用一次 BufferPool::trim()，把空闲的 slab 还给系统，线程安全
+	*/
+	BufferPool* bufferPool() const { return bufferPool_.get(); }
+	void setBufferPoolTrimInterval(double seconds);
+
+	/**
+	 * 这个 loop 中所有的 TcpConnection 的输入输出缓冲区的容量之和，可以在任意线程中读取
+	 * addBufferCapacity() 内部使用，只能在 loop 线程中调用
+	*/
+	int64_t bufferCapacity() const { return bufferCapacity_.load(std::memory_order_relaxed); }
+	void addBufferCapacity(int64_t delta)
+	{ bufferCapacity_.store(bufferCapacity_.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed); }
+
+	/**
+	 * 负载的统计，可以在任意线程中读取，参考 EventLoopThreadPool::setSelectionStrategy()
+	 * numConnections(): 属于这个 loop 的 TcpConnection 的个数，TcpConnection 构造的时候就计入，
+	 * 这样在一个线程中连续选择 loop 的时候可以马上看到前一次的选择
+	 * busyRatio(): 最近一段时间 (大约 kBusyWindow) 中处理事件和回调的时间占的比例，0 到 1
+	*/
+	int numConnections() const { return numConnections_.load(std::memory_order_relaxed); }
+	void addConnections(int delta) { numConnections_.fetch_add(delta, std::memory_order_relaxed); }
+	double busyRatio() const { return busyPermille_.load(std::memory_order_relaxed) / 1000.0; }
+
+	/**Poller 是否支持边沿触发，参考 Channel::setEdgeTriggered()*/
+	bool supportsEdgeTriggered() const;
+	/**修改 Poller 关注事件的系统调用次数 (epoll_ctl)，只能在 loop 线程中调用*/
+	int64_t pollerControlCalls() const;
+	/**
+	 * Channel::update() 的次数，以及其中因为在一次循环中合并或者没有变化而没有交给 Poller 的次数
+	 * 只能在 loop 线程中调用
+	*/
+	int64_t channelUpdates() const { return channelUpdates_; }
+	int64_t channelUpdatesSaved() const { return channelUpdates_ - pollerUpdates_; }
+
 	// 内部使用
 	void wakeup();
 	void updateChannel(Channel* channel);
@@ -125,6 +196,8 @@ private:
 	void abortNotInLoopThread();
 	void handleRead();  // waked up
 	void doPendingFunctors();
+	void flushChannelUpdates();
+	void updateBusyRatio(Timestamp now);
 
 	void printActiveChannels() const; // DEBUG
 
@@ -136,6 +209,11 @@ private:
 	int64_t 					iteration_;
 	const pid_t 				threadId_;
 	Timestamp 					pollReturnTime_;
+	std::unique_ptr<BufferPool> bufferPool_;	/*最后析构*/
+	std::atomic<int64_t>		bufferCapacity_;
+	ChannelList dirtyChannels_;	/*这一次循环中修改过的 Channel，参考 updateChannel()。TimerQueue 的构造函数中就会用到，需要在它之前构造*/
+	int64_t channelUpdates_;
+	int64_t pollerUpdates_;
 	std::unique_ptr<Poller> 	poller_;	/*多态的性质*/
 	std::unique_ptr<TimerQueue> timerQueue_;
 	int wakeupFd_;
@@ -145,8 +223,23 @@ private:
   	ChannelList activeChannels_;
   	Channel* currentActiveChannel_;
 
-	mutable MutexLock mutex_;
-  	std::vector<Functor> pendingFunctors_ GUARDED_BY(mutex_);
+	/**
+	 * 已经唤醒过 loop，并且 loop 还没有开始处理 pendingFunctors_
+	 * 为 true 的时候其他线程 queueInLoop() 不需要再写 eventfd
+	*/
+	std::atomic<bool> wakeupPending_;
+	int64_t wakeups_;
+	MpscQueue<Functor> pendingFunctors_;
+
+	/**
+	 * 参考 numConnections() 和 busyRatio()
+	 * 每一轮循环 poll 返回之后的时间是忙的时间，累计超过一个窗口之后更新 busyPermille_
+	*/
+	std::atomic<int> numConnections_;
+	std::atomic<int> busyPermille_;
+	Timestamp lastIterationEnd_;
+	int64_t busyMicroSeconds_;
+	int64_t windowMicroSeconds_;
 };
 
 
@@ -26,6 +26,9 @@ public:
 	~EventLoopThread();
 	EventLoop* startLoop();
 
+	/*在 startLoop() 之前调用，EventLoop 在绑定之后才创建*/
+	void setCpuAffinity(const std::vector<int>& cpus) { thread_.setCpuAffinity(cpus); }
+
 private:
 	EventLoop*			loop_  GUARDED_BY(mutex_);
 	bool				exiting_;
@@ -3,6 +3,8 @@
 #include "net/EventLoopThread.h"
 
 
+#include <algorithm>
+
 #include <stdio.h>
 
 using namespace muduo;
@@ -13,7 +15,9 @@ EventLoopThreadPool::EventLoopThreadPool(EventLoop* baseLoop, const string& name
         name_(nameArg),
         started_(false),
         numThreads_(0),
-        next_(0)
+        next_(0),
+        strategy_(kRoundRobin),
+        virtualNodes_(0)
 {}
 
 EventLoopThreadPool::~EventLoopThreadPool()
@@ -34,12 +38,16 @@ void EventLoopThreadPool::start(const ThreadInitCallback& cb)
         char buf[name_.size() + 32];
         snprintf(buf, sizeof buf, "%s%d", name_.c_str(), i);
         EventLoopThread* t = new EventLoopThread(cb, buf);
+        t->setCpuAffinity(placement_.cpusFor(i));
         threads_.push_back(std::unique_ptr<EventLoopThread>(t));
         loops_.push_back(t->startLoop());
     }
 
     if (this->numThreads_ == 0 && cb)
         cb(this->baseloop_);
+
+    if (virtualNodes_ > 0 && !loops_.empty())
+        buildHashRing();
 }
 
 EventLoop* EventLoopThreadPool::getNextLoop()
@@ -48,7 +56,11 @@ EventLoop* EventLoopThreadPool::getNextLoop()
     assert(started_);
     EventLoop* loop = baseloop_;
 
-    if (!loops_.empty())
+    if (!loops_.empty() && strategy_ != kRoundRobin)
+    {
+        loop = getLeastLoadedLoop();
+    }
+    else if (!loops_.empty())
     {
         // round-robin
         loop = loops_[next_];
@@ -61,12 +73,93 @@ EventLoop* EventLoopThreadPool::getNextLoop()
     return loop;
 }
 
+namespace
+{
+/*splitmix64 的 finalizer，让相邻的整数分散到整个 64 位空间*/
+uint64_t mix(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+}
+
+/**
+ * 从 next_ 开始找负载最小的 loop，负载相同的时候选前面的，然后 next_ 移到它的后面
+ * 负载是其他线程中的近似值，queueSize() 和 busyRatio() 在同一个时刻连续选择的时候还没有变化，
+ * kLeastConnections 在 TcpConnection 构造的时候就计入，没有这个问题
+*/
+EventLoop* EventLoopThreadPool::getLeastLoadedLoop()
+{
+    size_t n = loops_.size();
+    size_t best = next_;
+    double bestLoad = 0;
+    for (size_t k = 0; k < n; ++k)
+    {
+        size_t i = (next_ + k) % n;
+        double load = 0;
+        switch (strategy_)
+        {
+            case kLeastConnections:
+                load = loops_[i]->numConnections();
+                break;
+            case kLeastQueued:
+                load = static_cast<double>(loops_[i]->queueSize());
+                break;
+            case kLeastBusy:
+                /*busyRatio() 相差不到 5% 的时候看连接数，否则同一时刻的连接都会选择同一个 loop*/
+                load = static_cast<int>(loops_[i]->busyRatio() * 20) * 1e6 + loops_[i]->numConnections();
+                break;
+            default:
+                break;
+        }
+        if (k == 0 || load < bestLoad)
+        {
+            best = i;
+            bestLoad = load;
+        }
+    }
+    next_ = static_cast<int>((best + 1) % n);
+    return loops_[best];
+}
+
+/**
+ * 第 i 个 loop 的虚拟节点位置只和 i 有关，所以线程数不同的两个 pool 中前面的 loop 位置相同
+*/
+void EventLoopThreadPool::buildHashRing()
+{
+    ring_.clear();
+    ring_.reserve(loops_.size() * virtualNodes_);
+    for (size_t i = 0; i < loops_.size(); ++i)
+    {
+        for (int v = 0; v < virtualNodes_; ++v)
+        {
+            uint64_t point = mix((static_cast<uint64_t>(i) << 32) | static_cast<uint32_t>(v));
+            ring_.push_back(std::make_pair(point, loops_[i]));
+        }
+    }
+    std::sort(ring_.begin(), ring_.end());
+}
+
 EventLoop* EventLoopThreadPool::getLoopForHash(size_t hashCode)
 {
     baseloop_->assertInLoopThread();
     EventLoop* loop = baseloop_;
 
-    if (!loops_.empty())
+    if (!ring_.empty())
+    {
+        /*顺时针方向第一个虚拟节点，hashCode 可能是 std::hash 这样的恒等函数，先打散*/
+        uint64_t point = mix(hashCode);
+        auto it = std::lower_bound(ring_.begin(), ring_.end(),
+                                   std::make_pair(point, static_cast<EventLoop*>(NULL)));
+        if (it == ring_.end())
+            it = ring_.begin();
+        loop = it->second;
+    }
+    else if (!loops_.empty())
     {
         loop = loops_[hashCode % loops_.size()];
     }
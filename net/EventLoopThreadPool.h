@@ -1,6 +1,7 @@
 #ifndef MUDUO_NET_EVENTLOOPTHREADPOOL_H
 #define MUDUO_NET_EVENTLOOPTHREADPOOL_H
 
+#include "base/CpuPlacement.h"
 #include "base/noncopyable.h"
 #include "base/Types.h"
 
@@ -8,6 +9,9 @@
 #include <functional>
 #include <vector>
 #include <memory>
+#include <utility>
+
+#include <stdint.h>
 
 namespace muduo
 {
@@ -19,6 +23,23 @@ class EventLoopThread;
 
 class EventLoopThreadPool : noncopyable
 {
+public:
+	/**
+	 * getNextLoop() 选择 loop 的方式
+	 * kRoundRobin:          轮流
+	 * kLeastConnections:    EventLoop::numConnections() 最少的
+	 * kLeastQueued:         EventLoop::queueSize() 最短的，还没有处理的回调最少
+	 * kLeastBusy:           EventLoop::busyRatio() 最低的，适合连接之间负载差别很大的时候
+	 * 负载相同的时候从上一次选中的下一个开始找，相当于这些 loop 之间轮流
+	*/
+	enum SelectionStrategy
+	{
+		kRoundRobin,
+		kLeastConnections,
+		kLeastQueued,
+		kLeastBusy,
+	};
+
 private:
 	EventLoop* 			baseloop_;
 	string 				name_;
@@ -27,16 +48,38 @@ private:
 	int 				next_;
 	std::vector<std::unique_ptr<EventLoopThread> > threads_;
 	std::vector<EventLoop*> loops_;
+	SelectionStrategy	strategy_;
+	int 				virtualNodes_;
+	std::vector<std::pair<uint64_t, EventLoop*> > ring_;	/*一致性 hash 环，按照位置排序*/
+	CpuPlacement		placement_;
+
+	EventLoop* getLeastLoadedLoop();
+	void buildHashRing();
 public:
 	typedef std::function<void(EventLoop*)> ThreadInitCallback;
 
 	EventLoopThreadPool(EventLoop* baseLoop, const string& nameArg);
 	~EventLoopThreadPool();
-	void setThreadNum(int numThreads) { numThreads_ = numThreads; }
+	/**第 i 个 io loop 线程按照 placement.cpusFor(i) 绑定 CPU，默认不绑定*/
+	void setThreadNum(int numThreads, const CpuPlacement& placement = CpuPlacement())
+	{
+		numThreads_ = numThreads;
+		placement_ = placement;
+	}
+
+	/**在 start() 之前或者之后都可以，只能在 base loop 线程中调用*/
+	void setSelectionStrategy(SelectionStrategy strategy) { strategy_ = strategy; }
+
+	/**
+	 * getLoopForHash() 使用一致性 hash，每一个 loop 在环上有 virtualNodes 个位置
+	 * loop 的个数变化的时候 (另一个线程数不同的 pool) 只有大约 1/N 的 hashCode 换到别的 loop，取模的时候几乎全部都会变
+	 * 在 start() 之前调用，0 表示取模
+	*/
+	void setConsistentHash(int virtualNodes) { virtualNodes_ = virtualNodes; }
 	void start(const ThreadInitCallback& cb = ThreadInitCallback());
 
 	// valid after calling start()
-	/// round-robin
+	/// round-robin by default, see setSelectionStrategy()
 	EventLoop* getNextLoop();
 
 	/// with the same hash code, it will always return the same EventLoop
@@ -8,7 +8,8 @@ using namespace muduo::net;
 
 
 Poller::Poller(EventLoop* event)
-	: ownerloop_(event)
+	: controlCalls_(0),
+	  ownerloop_(event)
 {
 }
 
@@ -18,6 +18,7 @@ class Channel;
 // 为 IO 复用设计
 /**
  * Poller 是 PollPoller 和 EpollPoller 的基类，采用 电平触发的方式，它是 EventLoop 的成员
+ * EPollPoller 可以对单独的 Channel 使用边沿触发
  * 生命周期由 EventLoop 控制
  * 一个 EventLoop 有一个 Poller,它的生命周期和 EventLoop 的一样长
 */
@@ -43,6 +44,12 @@ public:
 
 	virtual bool hasChannel(Channel* channel) const;
 
+	/**是否支持 Channel::setEdgeTriggered()*/
+	virtual bool supportsEdgeTriggered() const { return false; }
+
+	/**修改内核中关注的事件的次数，对 epoll 来说就是 epoll_ctl() 的调用次数*/
+	int64_t controlCalls() const { return controlCalls_; }
+
 	/**
 	 * 工厂模式，抽象工厂
 	*/
@@ -61,6 +68,7 @@ protected:
 	 * int 存储的是 channel 对应的文件描述符
 	*/
 	ChannelMap	channels_;
+	int64_t		controlCalls_;
 
 private:
 	EventLoop*	ownerloop_;
@@ -0,0 +1,53 @@
+#ifndef MUDUO_NET_SLICE_H
+#define MUDUO_NET_SLICE_H
+
+#include "base/StringPiece.h"
+#include "base/Types.h"
+
+#include <memory>
+
+namespace muduo
+{
+namespace net
+{
+
+/**
+ * TcpConnection::send(const Slice*, size_t) 发送的一段数据
+ * 多个 Slice 通过一次 writev() 发送，例如协议的头部和消息体，不需要先拼接到一起
+ *
+ * owner 为空的时候数据是借用的，只在 send() 调用期间有效，没有发送完的部分会被拷贝到输出缓冲区
+ * owner 不为空的时候，没有发送完的部分直接引用 data，owner 保证发送完之前数据一直有效
+*/
+struct Slice
+{
+	Slice(const void* d, size_t n)
+		: data(static_cast<const char*>(d)), len(n)
+	{}
+
+	Slice(const StringPiece& str)
+		: data(str.data()), len(str.size())
+	{}
+
+	Slice(const void* d, size_t n, std::shared_ptr<const void> o)
+		: data(static_cast<const char*>(d)), len(n), owner(std::move(o))
+	{}
+
+	/*取得 str 的所有权*/
+	explicit Slice(string&& str)
+	{
+		std::shared_ptr<string> s(std::make_shared<string>(std::move(str)));
+		data = s->data();
+		len = s->size();
+		owner = std::move(s);
+	}
+
+	const char*					data;
+	size_t						len;
+	std::shared_ptr<const void>	owner;
+};
+
+} // namespace net
+
+} // namespace muduo
+
+#endif
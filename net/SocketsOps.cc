@@ -7,6 +7,8 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
 #include <sys/uio.h>    //readv
 #include <unistd.h>
@@ -152,7 +154,8 @@ int sockets::accept(int sockfd, struct sockaddr_in6* addr)
 		 * 失败情况下的 errno
 		*/
 		int savedErrno = errno;
-		LOG_SYSERR << "Socket::accept"; // 这个错误是不会终止程序的
+		if (savedErrno != EAGAIN)	/*一次事件 accept 多个连接的时候，最后一次总是 EAGAIN*/
+			LOG_SYSERR << "Socket::accept"; // 这个错误是不会终止程序的
 		switch (savedErrno)
 		{
 			case EAGAIN: /*当前没有新的连接，你可以在一段时间之后重新尝试  AGAIN*/
@@ -228,6 +231,32 @@ ssize_t sockets::write(int sockfd, const void *buf, size_t count)
 	*/
 }
 
+ssize_t sockets::writev(int sockfd, const struct iovec *iov, int iovcnt)
+{
+	return ::writev(sockfd, iov, iovcnt);
+}
+
+/**
+ * 内核直接把页缓存中的文件内容拷贝到 socket 的发送缓冲区，省去了 read() + write() 两次用户态的拷贝
+ * 非阻塞的 socket 缓冲区满了之后返回 -1, errno == EAGAIN，和 write() 一样
+ * 返回 0 表示文件已经读到了末尾
+*/
+ssize_t sockets::sendfile(int sockfd, int fd, off_t* offset, size_t count)
+{
+	return ::sendfile(sockfd, fd, offset, count);
+}
+
+/**
+ * 只查询内核中排队的字节数，不拷贝数据，比 recv(MSG_PEEK) 便宜
+*/
+int sockets::bytesAvailable(int sockfd)
+{
+	int n = 0;
+	if (::ioctl(sockfd, FIONREAD, &n) < 0)
+		return -1;
+	return n;
+}
+
 void sockets::close(int sockfd)
 {
 	if (::close(sockfd) < 0)
@@ -21,6 +21,11 @@ int  accept(int sockfd, struct sockaddr_in6* addr);
 ssize_t read(int sockfd, void *buf, size_t count);
 ssize_t readv(int sockfd, const struct iovec *iov, int iovcnt);
 ssize_t write(int sockfd, const void *buf, size_t count);
+ssize_t writev(int sockfd, const struct iovec *iov, int iovcnt);
+// 从文件 fd 直接发送到 socket，数据不经过用户态，offset 会被更新
+ssize_t sendfile(int sockfd, int fd, off_t* offset, size_t count);
+// 接收缓冲区中还有多少字节可以读，ioctl(FIONREAD)，出错返回 -1
+int  bytesAvailable(int sockfd);
 void close(int sockfd);
 void shutdownWrite(int sockfd);
 
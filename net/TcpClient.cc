@@ -44,6 +44,8 @@ TcpClient::TcpClient(EventLoop* loop,
 	messageCallback_(defaultMessageCallback),
 	retry_(false),
 	connect_(true),
+	edgeTriggered_(false),
+	writeCoalescing_(false),
 	nextConnId_(1)
 {
 	connector_->setNewConnectionCallback(
@@ -152,6 +154,8 @@ void TcpClient::newConnection(int sockfd)
 	conn->setConnectionCallback(this->connectionCallback_);
 	conn->setMessageCallback(this->messageCallback_);
 	conn->setWriteCompleteCallback(this->writeCompleteCallback_);
+	conn->setEdgeTriggered(this->edgeTriggered_);
+	conn->setWriteCoalescing(this->writeCoalescing_);
 	conn->setCloseCallback(
 		std::bind(&TcpClient::removeConnection, this, _1)
 	);
@@ -23,6 +23,8 @@ private:
 
     bool    retry_;
     bool    connect_;
+    bool    edgeTriggered_;
+    bool    writeCoalescing_;
     id_t    nextConnId_;
 
     mutable MutexLock   mutex_;
@@ -50,6 +52,14 @@ public:
     bool retry() const { return retry_; }
     void enableRetry() { retry_ = true; }
 
+    /// 连接使用边沿触发，参考 TcpConnection::setEdgeTriggered()
+    /// 在 connect() 之前调用
+    void setEdgeTriggered(bool on) { edgeTriggered_ = on; }
+
+    /// 合并 messageCallback 中的多次 send()，参考 TcpConnection::setWriteCoalescing()
+    /// 在 connect() 之前调用
+    void setWriteCoalescing(bool on) { writeCoalescing_ = on; }
+
     const string& name() const
     { return name_; }
 
@@ -8,11 +8,22 @@
 #include "net/SocketsOps.h"
 
 #include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/uio.h>
 
 using namespace muduo;
 using namespace muduo::net;
 
+namespace
+{
+
+const size_t kMinReadHint = Buffer::kInitialSize;
+const size_t kMaxReadHint = 256 * 1024;
+const size_t kDefaultReadBudget = 256 * 1024;	/*一次可读事件最多读 256 KB，避免一个连接占住 loop*/
+const size_t kDefaultWriteBudget = 1024 * 1024;	/*边沿触发的时候一次可写事件最多写 1 MB*/
 
+} // namespace
 
 
 /**
@@ -59,7 +70,24 @@ TcpConnection::TcpConnection(EventLoop* loop,
 	  channel_(new Channel(loop, sockfd)),
 	  localAddr_(localAddr),
 	  peerAddr_(peerAddr),
-	  highWaterMark_(64*1024*1024)  // 64 MB
+	  highWaterMark_(64*1024*1024),  // 64 MB
+	  inputBuffer_(0),	/*TcpServer 在 acceptor 线程中构造，真正的内存在 connectEstablished() 中申请*/
+	  pendingBytes_(0),
+	  bufferIdleSeconds_(0.0),
+	  shrinkTimerArmed_(false),
+	  reportedCapacity_(0),
+	  readBudget_(kDefaultReadBudget),
+	  readHint_(kMinReadHint),
+	  readCalls_(0),
+	  bytesRead_(0),
+	  edgeTriggered_(false),
+	  writeBudget_(kDefaultWriteBudget),
+	  readResumeQueued_(false),
+	  writeResumeQueued_(false),
+	  coalesceWrites_(false),
+	  corked_(false),
+	  userCorked_(false),
+	  writeCalls_(0)
 /**
  * channel 并不知道自己处理的是什么事件，以及如何处理这些事件。各种可能的事件都会绑定到 channel 上面，
  * Tcp socket 的读写的操作，普通文件的读写的操作，定时器的相关的操作。那么 channel 处理这些事件的方式就是通过
@@ -83,6 +111,7 @@ TcpConnection::TcpConnection(EventLoop* loop,
 
 	LOG_DEBUG << "TcpConnection::ctor[" <<  this->name_ << "] at " << this
 			<< " fd=" << sockfd;
+	loop_->addConnections(1);	/*在 connectDestroyed() 中减去*/
 	socket_->setKeepAlive(true);
 	/**
 	 * 使用操作系统自带的保活机制，即每隔 2小时发送一个确认连接的包，另一端在接收到这个包的情况下
@@ -98,6 +127,13 @@ TcpConnection::~TcpConnection()
 				<< " fd=" << channel_->fd()
 				<< " state=" << stateToString();
 	assert(state_ == KDisconnected);
+	/**
+	 * 连接断开的时候还没有发送完的文件
+	*/
+	for (const PendingFile& file : pendingFiles_)
+	{
+		sockets::close(file.fd);
+	}
 }
 
 bool TcpConnection::getTcpInfo(struct tcp_info* tcpi) const
@@ -139,6 +175,81 @@ void TcpConnection::send(const StringPiece& message)
 	}
 }
 
+/**
+ * message 被移动到回调中，不需要像 send(const StringPiece&) 那样拷贝一份
+*/
+void TcpConnection::send(string&& message)
+{
+	if (this->state_ == KConnected)
+	{
+		if (this->loop_->isInLoopThread())
+		{
+			this->sendInLoop(message.data(), message.size());
+		}
+		else
+		{
+			void (TcpConnection::*fp)(const StringPiece& message) = &TcpConnection::sendInLoop;
+			this->loop_->runInLoop(
+				std::bind(fp, this, std::move(message))
+			);
+		}
+	}
+}
+
+void TcpConnection::send(Buffer&& message)
+{
+	this->send(&message);
+}
+
+/**
+ * 在 loop 线程中直接用 writev() 发送，没有发送完的 slice 按照 owner 决定是引用还是拷贝
+ * 其他线程调用的时候，借用的 slice 在这里拷贝到一块共享的内存中，有 owner 的只是增加引用计数
+*/
+void TcpConnection::send(const Slice* slices, size_t count)
+{
+	if (this->state_ == KConnected)
+	{
+		if (this->loop_->isInLoopThread())
+		{
+			this->sendInLoop(slices, count);
+		}
+		else
+		{
+			size_t borrowed = 0;
+			for (size_t i = 0; i < count; ++i)
+			{
+				if (!slices[i].owner)
+					borrowed += slices[i].len;
+			}
+			std::shared_ptr<string> storage;
+			if (borrowed > 0)
+			{
+				storage = std::make_shared<string>();
+				storage->reserve(borrowed);	/*之后 append 不会重新分配，前面的指针一直有效*/
+			}
+
+			std::vector<Slice> owned;
+			owned.reserve(count);
+			for (size_t i = 0; i < count; ++i)
+			{
+				if (slices[i].owner)
+				{
+					owned.push_back(slices[i]);
+				}
+				else
+				{
+					size_t offset = storage->size();
+					storage->append(slices[i].data, slices[i].len);
+					owned.push_back(Slice(storage->data() + offset, slices[i].len, storage));
+				}
+			}
+			this->loop_->runInLoop(
+				std::bind(&TcpConnection::sendSlicesInLoop, this, std::move(owned))
+			);
+		}
+	}
+}
+
 /**
  * Buffer 是一种特殊的缓存机构，即可以读，也可以写
  * 非线程安全
@@ -154,9 +265,13 @@ void TcpConnection::send(Buffer* buf)
 		}
 		else 
 		{
-			void (TcpConnection::*fp)(const StringPiece& ) = &TcpConnection::sendInLoop;
+			/**
+			 * 把 buf 的内存交换出来移动到回调中，buf 变成一个空的 Buffer，不需要拷贝数据
+			*/
+			Buffer message(0, buf->allocator());
+			message.swap(*buf);
 			this->loop_->runInLoop(
-				std::bind(fp, this, buf->retrieveAllAsString())
+				std::bind(&TcpConnection::sendBufferInLoop, this, std::move(message))
 			);
 		}
 	}
@@ -166,16 +281,54 @@ void TcpConnection::send(Buffer* buf)
 	*/
 }
 
+void TcpConnection::sendFile(int fd, off_t offset, size_t len)
+{
+	if (this->state_ == KConnected)
+	{
+		/**
+		 * 在调用者的线程里面 dup，这样调用者返回之后就可以关闭自己的 fd
+		*/
+		int dupfd = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+		if (dupfd < 0)
+		{
+			LOG_SYSERR << "TcpConnection::sendFile";
+			return;
+		}
+		loop_->runInLoop(
+			std::bind(&TcpConnection::sendFileInLoop, this, dupfd, offset, len)
+		);
+	}
+}
+
 void TcpConnection::sendInLoop(const StringPiece& message)
 {
 	this->sendInLoop(message.data(), message.size());
 }
 
+void TcpConnection::sendBufferInLoop(TcpConnection* conn, const Buffer& message)
+{
+	conn->sendInLoop(message.peek(), message.readableBytes());
+}
+
 /*回调*/
 void TcpConnection::sendInLoop(const void* data, size_t len)
+{
+	Slice slice(data, len);
+	this->sendInLoop(&slice, 1);
+}
+
+void TcpConnection::sendSlicesInLoop(TcpConnection* conn, const std::vector<Slice>& slices)
+{
+	conn->sendInLoop(slices.data(), slices.size());
+}
+
+void TcpConnection::sendInLoop(const Slice* slices, size_t count)
 {
 	this->loop_->assertInLoopThread();
 	ssize_t nwrote = 0;
+	size_t len = 0;
+	for (size_t i = 0; i < count; ++i)
+		len += slices[i].len;
 	size_t remaining = len;
 	bool faultError = false;
 	if (state_ == KDisconnected)
@@ -184,14 +337,44 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
 		return;
 	}
 
-	if (!this->channel_->isWriting() && outputBuffer_.readableBytes() == 0)
+	if (!pendingFiles_.empty())
 	{
 		/**
-		 * 如果 this->channel_->isWriting() == true 这个分支不会执行 ------- channel 可写
-		 * 如果 this->channel_->isWriting() == false 那么这个分支将会被执行------ channel 和 epoll 没有监听相应的事件
+		 * 前面还有文件没有发送完，数据只能排在最后一个文件的后面
+		*/
+		size_t oldLen = queuedBytes();
+		if (oldLen + len >= highWaterMark_ &&
+			oldLen < highWaterMark_ &&
+			highWaterMarkCallback_)
+			this->loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + len));
+
+		for (size_t i = 0; i < count; ++i)
+			pendingFiles_.back().trailer.appendSlice(slices[i].data, slices[i].len, slices[i].owner);
+		pendingBytes_ += len;
+		noteBufferActivity();
+		return;
+	}
+
+	if (!corked_ && !outputPending() && outputBuffer_.readableBytes() == 0)
+	{
+		/**
+		 * corked_ 的时候数据只放入缓冲区，等待 flush()
+		 * 如果 outputPending() == true 这个分支不会执行 ------- 还有数据在等待可写事件
+		 * 如果 outputPending() == false 那么这个分支将会被执行------ 没有排队的数据
 		 * 发送缓冲区中的内容全部都发送完了，我们就直接绕过缓冲区，直接向 socket 发送我们的数据
+		 * 多个 slice 用一次 writev() 发送，不需要先拼接
 		*/
-		nwrote = sockets::write(channel_->fd(), data, len);
+		struct iovec vec[kMaxSendIovec];
+		int iovcnt = 0;
+		for (size_t i = 0; i < count && iovcnt < kMaxSendIovec; ++i)
+		{
+			vec[iovcnt].iov_base = const_cast<char*>(slices[i].data);
+			vec[iovcnt].iov_len = slices[i].len;
+			++iovcnt;
+		}
+		nwrote = iovcnt == 1 ? sockets::write(channel_->fd(), vec[0].iov_base, vec[0].iov_len)
+							 : sockets::writev(channel_->fd(), vec, iovcnt);
+		++writeCalls_;
 		if (nwrote >= 0) /**发送了部分的数据，可能全部发送完，也可能只发送了一部分*/
 		{
 			remaining = len - nwrote;
@@ -225,7 +408,7 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
 	assert(remaining <= len);
 	if (!faultError && remaining > 0)
 	{
-		size_t oldLen = outputBuffer_.readableBytes();  /**输出缓冲区还有数据的话，有多少数据*/
+		size_t oldLen = queuedBytes();  /**输出缓冲区还有数据的话，有多少数据*/
 		/**
 		 * oldLen 是当前的缓冲区中还有的数据，remaining 是当前发送端还需要发送的数据
 		*/
@@ -234,18 +417,189 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
 			highWaterMarkCallback_)
 			this->loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + remaining));
 		
-		this->outputBuffer_.append(static_cast<const char*>(data) + nwrote, remaining);
 		/**
 		 * 没有完全写入 socket 的数据，先写入缓冲区
+		 * 跳过已经写入的 nwrote 个字节，有 owner 的 slice 直接引用，不拷贝
 		*/
+		size_t skip = nwrote;
+		for (size_t i = 0; i < count; ++i)
+		{
+			const Slice& slice = slices[i];
+			if (skip >= slice.len)
+			{
+				skip -= slice.len;
+				continue;
+			}
+			this->outputBuffer_.appendSlice(slice.data + skip, slice.len - skip, slice.owner);
+			skip = 0;
+		}
 
-		if (!channel_->isWriting())
+		if (!corked_ && !channel_->isWriting())
 		/**
 		 * 如果 channel 被设置为不可写，那么将其设置为可写
 		 * 如果不设置为 可写，那么在 epoll 事件触发的时候无法 channel 无法处理可写事件
+		 * corked_ 的时候由 flush() 决定
 		*/
 			channel_->enableWriting();
+		noteBufferActivity();
+	}
+}
+
+void TcpConnection::sendFileInLoop(int fd, off_t offset, size_t len)
+{
+	this->loop_->assertInLoopThread();
+	if (state_ == KDisconnected)
+	{
+		LOG_WARN << "disconnected, give up sending file";
+		sockets::close(fd);
+		return;
+	}
+
+	size_t oldLen = queuedBytes();
+	if (oldLen + len >= highWaterMark_ &&
+		oldLen < highWaterMark_ &&
+		highWaterMarkCallback_)
+		this->loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + len));
+
+	bool idle = !outputPending() && oldLen == 0;
+	PendingFile file;
+	file.fd = fd;
+	file.offset = offset;
+	file.remaining = len;
+	pendingFiles_.push_back(std::move(file));
+	pendingBytes_ += len;
+
+	if (idle)
+	{
+		/**
+		 * 和 sendInLoop 一样，前面没有排队的数据的时候先直接发送一次
+		*/
+		if (sendPendingFiles() && pendingFiles_.empty() && outputBuffer_.readableBytes() == 0)
+		{
+			if (writeCompleteCallback_)
+				this->loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+			return;
+		}
 	}
+	if (!channel_->isWriting())
+		channel_->enableWriting();
+	noteBufferActivity();
+}
+
+/**
+ * outputBuffer_ 为空的时候才可以发送文件
+ * 一个文件发送完之后关闭 fd，把它的 trailer 移入 outputBuffer_，然后继续发送下一个文件
+ * socket 的缓冲区满了或者出错返回，出错的时候返回 false
+*/
+bool TcpConnection::sendPendingFiles()
+{
+	while (!pendingFiles_.empty() && outputBuffer_.readableBytes() == 0)
+	{
+		PendingFile& file = pendingFiles_.front();
+		while (file.remaining > 0)
+		{
+			ssize_t n = sockets::sendfile(channel_->fd(), file.fd, &file.offset, file.remaining);
+			if (n > 0)
+			{
+				bool full = static_cast<size_t>(n) < file.remaining;
+				file.remaining -= n;
+				pendingBytes_ -= n;
+				if (full)	/*socket 的发送缓冲区已经满了，等待下一次可写事件*/
+					return true;
+			}
+			else if (n == 0)
+			{
+				/**
+				 * 文件比 sendFile() 的时候给出的长度短，可能被截断了
+				*/
+				LOG_WARN << "TcpConnection::sendPendingFiles [" << name_
+						 << "] - file fd = " << file.fd << " ends with "
+						 << file.remaining << " bytes unsent";
+				pendingBytes_ -= file.remaining;
+				file.remaining = 0;
+			}
+			else
+			{
+				if (errno == EWOULDBLOCK)
+					return true;
+				LOG_SYSERR << "TcpConnection::sendPendingFiles";
+				return false;
+			}
+		}
+
+		sockets::close(file.fd);
+		pendingBytes_ -= file.trailer.readableBytes();
+		outputBuffer_.swap(file.trailer);
+		pendingFiles_.pop_front();
+
+		if (outputBuffer_.readableBytes() > 0)
+		{
+			int savedErrno = 0;
+			ssize_t n = outputBuffer_.writefd(channel_->fd(), &savedErrno);
+			++writeCalls_;
+			if (n < 0 && savedErrno != EWOULDBLOCK)
+			{
+				errno = savedErrno;
+				LOG_SYSERR << "TcpConnection::sendPendingFiles";
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+void TcpConnection::cork()
+{
+	loop_->assertInLoopThread();
+	corked_ = true;
+	userCorked_ = true;
+}
+
+/**
+ * cork() 之后积累的数据一次发送出去
+ * 没有在等待可写事件的时候直接 writev() 一次，写不完再关注可写事件，这和 sendInLoop() 直接写是一样的
+ * 已经在关注可写事件的时候，前面还有数据没有发送完，和可写事件一样处理
+*/
+void TcpConnection::flush()
+{
+	loop_->assertInLoopThread();
+	corked_ = false;
+	userCorked_ = false;
+	if (state_ == KDisconnected || !outputPending())
+		return;
+
+	if (channel_->isWriting())
+	{
+		handleWrite();
+		return;
+	}
+
+	if (outputBuffer_.readableBytes() > 0)
+	{
+		int savedErrno = 0;
+		ssize_t n = outputBuffer_.writefd(channel_->fd(), &savedErrno);
+		++writeCalls_;
+		if (n < 0 && savedErrno != EWOULDBLOCK)
+		{
+			errno = savedErrno;
+			LOG_SYSERR << "TcpConnection::flush";
+			if (savedErrno == EPIPE || savedErrno == ECONNRESET)
+				return;
+		}
+	}
+	if (outputBuffer_.readableBytes() == 0 && !sendPendingFiles())
+		return;
+
+	if (!outputPending())
+	{
+		if (writeCompleteCallback_)
+			this->loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+		if (state_ == KDisconnecting)
+			shutdownInLoop();
+	}
+	else
+		channel_->enableWriting();
+	noteBufferActivity();
 }
 
 void TcpConnection::shutdown()
@@ -264,7 +618,7 @@ void TcpConnection::shutdown()
 void TcpConnection::shutdownInLoop()
 {
 	this->loop_->assertInLoopThread();
-	if (!channel_->isWriting())
+	if (!outputPending())
 	/**
 	 * 缓冲区内有数据的话，那么无法进行 shutdowndown()
 	 * 并且 shutdown 只关闭写端不关闭读端
@@ -377,7 +731,27 @@ void TcpConnection::connectEstablished()
 	assert(state_ == KConnecting);
 	setState(KConnected);
 	channel_->tie(shared_from_this());
-	channel_->enableReading();   /**数据达到时 poll 将会检测到*/
+	/**
+	 * 在 io loop 线程中申请，内存来自这个 loop 的 BufferPool，之后的扩容和释放都在本线程
+	*/
+	Buffer(Buffer::kInitialSize, BufferAllocator::loopAllocator()).swap(inputBuffer_);
+	if (edgeTriggered_ && !loop_->supportsEdgeTriggered())
+	{
+		LOG_WARN << "TcpConnection::connectEstablished [" << name_
+				 << "] - poller does not support edge-triggered mode, use level-triggered";
+		edgeTriggered_ = false;
+	}
+	if (edgeTriggered_)
+	{
+		/**
+		 * 边沿触发一开始就同时关注读和写，之后不再修改，省掉每一次写不完和写完时候的 epoll_ctl()
+		*/
+		channel_->setEdgeTriggered(true);
+		channel_->enableAll();
+	}
+	else
+		channel_->enableReading();   /**数据达到时 poll 将会检测到*/
+	updateBufferCapacity();
 
 	connectionCallback_(shared_from_this());
 }
@@ -396,31 +770,89 @@ void TcpConnection::connectDestroyed()
 		connectionCallback_(shared_from_this());
 	}
 	channel_->remove();
+	loop_->addConnections(-1);
+	loop_->addBufferCapacity(-static_cast<int64_t>(reportedCapacity_));
+	reportedCapacity_ = 0;
 }
 
 
+/**
+ * 先按照 readHint_ 准备好可写区域读一次。如果读满了可写区域，说明 socket 中可能还有数据，
+ * 用 FIONREAD 查询剩下多少，按照准确的大小扩容之后接着读，直到读完或者超过 readBudget_
+ * 这样大块的传输不会每次都经过 extrabuf 多拷贝一次，也不会为了一个 EAGAIN 多做一次 read
+ * 所有的数据读完之后只调用一次 messageCallback
+ *
+ * 边沿触发的时候，每一次有新的数据到达都会通知，没有读满就说明已经读完了，不需要再读一次 EAGAIN
+ * 只有 revents 中带着 EPOLLRDHUP 的时候，要一直读到 EOF，因为对端关闭之后不会再有通知
+ * 所以边沿触发不使用 FIONREAD，它区分不出 EOF
+*/
 void TcpConnection::handleRead(Timestamp receiveTime)
 {
 	this->loop_->assertInLoopThread();
+	const int fd = channel_->fd();
 	int savedErrno = 0;
-	ssize_t n = this->inputBuffer_.readfd(channel_->fd(), &savedErrno); /**将socket 中的数据全部读取出来*/
-	/*非阻塞*/
+	const bool peerClosed = edgeTriggered_ && (channel_->revents() & POLLRDHUP);
+	size_t want = readHint_;
+	size_t total = 0;
+	ssize_t n = 0;
+	for (;;)
+	{
+		const size_t direct = std::max(inputBuffer_.writableBytes(), want);
+		n = this->inputBuffer_.readfd(fd, &savedErrno, want); /*非阻塞*/
+		++readCalls_;
+		if (n <= 0)
+			break;
+		total += n;
+		bytesRead_ += n;
+		adjustReadHint(n);
+		if (static_cast<size_t>(n) < direct && !peerClosed)
+			break;	/*没有读满，socket 中的数据已经读完了*/
+		if (edgeTriggered_)
+		{
+			if (total >= readBudget_)
+			{
+				/*剩下的留到这一轮的事件处理完之后，不让一个连接占住整个 loop*/
+				queueResume(&readResumeQueued_, &TcpConnection::resumeRead);
+				break;
+			}
+			want = readHint_;
+			continue;
+		}
+		if (total >= readBudget_)
+			break;
+		int avail = sockets::bytesAvailable(fd);
+		if (avail <= 0)
+			break;
+		want = std::min(static_cast<size_t>(avail), readBudget_ - total);
+	}
 
-	if (n > 0)
+	if (total > 0)
 	{
 		/**
 		 * 立刻通知高层的模块，应该取走这些接收到的数据
+		 * 水平触发模式下后面几次 read 遇到的错误，下一次事件还会报告
+		 * 用户自己 cork() 的时候（之前或者在回调中）不自动 flush()，等用户的 flush()
 		*/
-		this->messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+		if (coalesceWrites_ && !userCorked_)
+		{
+			corked_ = true;
+			this->messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+			if (!userCorked_)
+				flush();
+		}
+		else
+			this->messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+		noteBufferActivity();
 	}
-	else if (n == 0)
+
+	if (n == 0 && (state_ == KConnected || state_ == KDisconnecting))
 		/**
-		 * 没有读到任何的数据
+		 * 读到了 EOF
 		 * 有两种可能的情况，第一种是另一端使用了 close() 关闭了读端和写端。这个时候，我们发送任何的数据都是没有意义的
 		 * 所以关闭这个 TcpConnection 禁止所有的读写的操作
 		*/
 		handleClose(); /*为什么？*/
-	else 
+	else if (n < 0 && savedErrno != EWOULDBLOCK)
 	{
 		errno = savedErrno;
 		LOG_SYSERR << "TcpConnection::handleRead";
@@ -428,48 +860,98 @@ void TcpConnection::handleRead(Timestamp receiveTime)
 	}
 }
 
+/**
+ * 读满了预期的大小就加倍，连续读到的数据远小于预期的时候减半
+*/
+void TcpConnection::adjustReadHint(size_t n)
+{
+	if (n >= readHint_)
+		readHint_ = std::min(readHint_ * 2, kMaxReadHint);
+	else if (n < readHint_ / 4)
+		readHint_ = std::max(readHint_ / 2, kMinReadHint);
+}
+
 void TcpConnection::handleWrite()
 {
 	this->loop_->assertInLoopThread();
 	if (channel_->isWriting())
 	{
-		ssize_t n = sockets::write(	channel_->fd(),
-									this->outputBuffer_.peek(),
-									this->outputBuffer_.readableBytes());
-		if (n > 0)	/**实际写入的字节的数量*/
+		/**
+		 * 边沿触发的时候一直关注可写事件，可读事件也会带上可写，没有数据的时候直接返回
+		 * 水平触发的时候缓冲区发送完并不马上取消关注可写事件（参考下面），如果到了下一次可写事件
+		 * 还是没有新的数据，这个时候才取消
+		*/
+		if (queuedBytes() == 0)
 		{
-			this->outputBuffer_.retrieve(n);
-			if (outputBuffer_.readableBytes() == 0) /**输出 buffer 当中已经没有数据可以发送了*/
-			{
-				/**
-				 * 输出缓冲区空了，需要提醒上层的模块，需要向 buffer 里面输出数据了
-				 * 注意，每一次缓冲区清空之后都需要这样进行处理 --- 关闭 channel 的写端
-				*/
+			if (!edgeTriggered_)
 				this->channel_->disableWriting();
+			return;
+		}
+
+		/**
+		 * 水平触发只写一次，写不完下一次可写事件还会通知
+		 * 边沿触发一直写到 socket 写满（没有任何进展）为止，或者超过 writeBudget_
+		*/
+		size_t written = 0;
+		for (;;)
+		{
+			size_t before = queuedBytes();
+			if (this->outputBuffer_.readableBytes() > 0)
+			{
 				/**
-				 * 将 channel 设置为 disableWriting() 那么下一次 send 数据可以直接向 socket 进行发送
-				 * 但是这个操作需要 epoll 进行设置
-				 * 原因也很简单，那就是如果缓冲区没有了数据，下一次可写事件被 epoll 触发之后，也没有数据可以发送
-				 * 还不如在下一次循环当中不监测这个事件的可写状态，等待主动 send() 数据的时候直接写 socket 
+				 * writev() 一次把多个块写入 socket，写入的部分自动从缓冲区中取走
 				*/
-				if (writeCompleteCallback_)
+				int savedErrno = 0;
+				ssize_t n = this->outputBuffer_.writefd(channel_->fd(), &savedErrno);
+				++writeCalls_;
+				if (n < 0 && savedErrno != EWOULDBLOCK)	/*写失败了*/
 				{
-					this->loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
-				}
-				if (this->state_ == KDisconnecting)	/**如果正在断开连接，关闭写*/
-				{
-					/**
-					 * 前面如果调用过 shutdown()，那么状态 state_ == kDisconnecting。但是当时可能缓冲区的数据还没有发送完
-					 * 现在缓冲区的数据发送完了，因此可以再次执行关闭写端
-					*/
-					shutdownInLoop();
+					errno = savedErrno;
+					LOG_SYSERR << "TcpConnection::handleWrite";
+					return;
 				}
 			}
+
+			/**
+			 * outputBuffer_ 发送完之后，才轮到排队的文件
+			*/
+			if (outputBuffer_.readableBytes() == 0 && !sendPendingFiles())
+				return;
+
+			size_t after = queuedBytes();
+			written += before - after;
+			if (!edgeTriggered_ || after == 0 || after == before)
+				break;
+			if (written >= writeBudget_)
+			{
+				queueResume(&writeResumeQueued_, &TcpConnection::resumeWrite);
+				break;
+			}
 		}
-		else	/*写失败了*/
+
+		if (outputBuffer_.readableBytes() == 0 && pendingFiles_.empty()) /**输出 buffer 当中已经没有数据可以发送了*/
 		{
-			LOG_SYSERR << "TcpConnection::handleWrite";
+			/**
+			 * 输出缓冲区空了，需要提醒上层的模块，需要向 buffer 里面输出数据了
+			 * 这里不马上 disableWriting()：上层常常在 writeCompleteCallback_ 或者下一次可读事件中马上又 send()，
+			 * 这时候关闭之后又要打开，是两次多余的 epoll_ctl()
+			 * 下一次 send() 的时候 outputPending() == false，仍然可以直接向 socket 写
+			 * 如果到下一次可写事件的时候还是没有数据，在上面的分支中再关闭
+			*/
+			if (writeCompleteCallback_)
+			{
+				this->loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+			}
+			if (this->state_ == KDisconnecting)	/**如果正在断开连接，关闭写*/
+			{
+				/**
+				 * 前面如果调用过 shutdown()，那么状态 state_ == kDisconnecting。但是当时可能缓冲区的数据还没有发送完
+				 * 现在缓冲区的数据发送完了，因此可以再次执行关闭写端
+				*/
+				shutdownInLoop();
+			}
 		}
+		noteBufferActivity();
 	}
 	else 	/* channel 不可写*/
 	{	
@@ -478,6 +960,113 @@ void TcpConnection::handleWrite()
 	}
 }
 
+/**
+ * 边沿触发的时候，还没有读写完的数据不会再有事件通知，放到 pendingFunctors 中接着处理
+ * 这时候同一轮的其他连接的事件已经处理完了
+*/
+void TcpConnection::queueResume(bool* queued, void (TcpConnection::*resume)())
+{
+	if (!*queued)
+	{
+		*queued = true;
+		loop_->queueInLoop(makeWeakCallback(shared_from_this(), resume));
+	}
+}
+
+void TcpConnection::resumeRead()
+{
+	readResumeQueued_ = false;
+	if ((state_ == KConnected || state_ == KDisconnecting) && channel_->isReading())
+		handleRead(Timestamp::now());
+}
+
+void TcpConnection::resumeWrite()
+{
+	writeResumeQueued_ = false;
+	if (state_ == KConnected || state_ == KDisconnecting)
+		handleWrite();
+}
+
+/**
+ * 还有数据在等待可写事件
+ * 缓冲区发送完之后可写事件会延迟取消（水平触发）或者一直关注（边沿触发），所以不能用 channel_->isWriting() 判断
+*/
+bool TcpConnection::outputPending() const
+{
+	return queuedBytes() > 0;
+}
+
+/**
+ * 每一次读写缓冲区之后调用，更新 EventLoop 中统计的容量
+ * 缓冲区变大了，并且还没有启动定时器的时候，启动一个定时器，idle 秒之后检查是否空闲
+*/
+void TcpConnection::noteBufferActivity()
+{
+	updateBufferCapacity();
+	if (bufferIdleSeconds_ > 0 && state_ != KDisconnected)
+	{
+		lastBufferActive_ = loop_->pollReturnTime();
+		if (!shrinkTimerArmed_ && buffersShrinkable())
+		{
+			shrinkTimerArmed_ = true;
+			loop_->runAfter(bufferIdleSeconds_,
+							makeWeakCallback(shared_from_this(), &TcpConnection::checkIdleBuffers));
+		}
+	}
+}
+
+void TcpConnection::checkIdleBuffers()
+{
+	loop_->assertInLoopThread();
+	shrinkTimerArmed_ = false;
+	if (state_ == KDisconnected)
+		return;
+
+	double idle = timeDifference(Timestamp::now(), lastBufferActive_);
+	if (idle >= bufferIdleSeconds_)
+	{
+		shrinkBuffers();
+	}
+	else if (buffersShrinkable())
+	{
+		/*定时器启动之后又有了读写，等到空闲满 bufferIdleSeconds_ 秒再检查*/
+		shrinkTimerArmed_ = true;
+		loop_->runAfter(bufferIdleSeconds_ - idle,
+						makeWeakCallback(shared_from_this(), &TcpConnection::checkIdleBuffers));
+	}
+}
+
+/**
+ * 输入缓冲区比初始的大小大，或者输出缓冲区还留着块
+*/
+bool TcpConnection::buffersShrinkable() const
+{
+	return inputBuffer_.internalCapacity() > Buffer::kCheapPrepend + Buffer::kInitialSize ||
+		   outputBuffer_.blockCount() > 0;
+}
+
+/**
+ * 输入缓冲区收缩到刚好放下没有读走的数据，输出缓冲区为空的时候释放所有的块
+*/
+void TcpConnection::shrinkBuffers()
+{
+	loop_->assertInLoopThread();
+	if (inputBuffer_.internalCapacity() > inputBuffer_.readableBytes() + Buffer::kCheapPrepend)
+		inputBuffer_.shrink(0);
+	outputBuffer_.shrink();
+	updateBufferCapacity();
+}
+
+void TcpConnection::updateBufferCapacity()
+{
+	size_t capacity = bufferCapacity();
+	if (capacity != reportedCapacity_)
+	{
+		loop_->addBufferCapacity(static_cast<int64_t>(capacity) - static_cast<int64_t>(reportedCapacity_));
+		reportedCapacity_ = capacity;
+	}
+}
+
 /**
  * loop_ 调用回调
 */
@@ -4,14 +4,22 @@
 
 #include "base/noncopyable.h"
 #include "base/StringPiece.h"
+#include "base/Timestamp.h"
 #include "base/Types.h"
 #include "net/Callbacks.h"
 #include "net/Buffer.h"
+#include "net/ChainBuffer.h"
 #include "net/InetAddress.h"
+#include "net/Slice.h"
 
+#include <deque>
+#include <initializer_list>
 #include <memory>
+#include <vector>
 #include <boost/any.hpp>
 
+#include <sys/types.h>
+
 struct tcp_info;
 
 namespace muduo
@@ -53,7 +61,64 @@ private:
 	 * 每一个 Tcp 连接都维持了一个输出缓冲区和一个输入缓冲区
 	*/
 	Buffer inputBuffer_;
-	Buffer outputBuffer_; // FIXME: use list<Buffer> as output buffer.
+	/**
+	 * 输出缓冲区使用分块的 ChainBuffer，对端很慢的时候积压大量的数据也不需要整块的扩容和搬移
+	 * 输入缓冲区需要连续的内存来解析协议，仍然使用 Buffer
+	*/
+	ChainBuffer outputBuffer_;
+
+	/**
+	 * sendFile() 排队等待发送的文件
+	 * 文件的内容通过 sendfile(2) 从页缓存直接发送到 socket，不会读入 outputBuffer_
+	 * 在这个文件之后 send() 的数据先放在 trailer 中，文件发送完之后再移入 outputBuffer_，保证发送的顺序
+	*/
+	struct PendingFile
+	{
+		int		fd;
+		off_t	offset;
+		size_t	remaining;
+		ChainBuffer	trailer;
+	};
+	std::deque<PendingFile> pendingFiles_;
+	size_t pendingBytes_;	/*pendingFiles_ 中还没有发送的字节数，包括文件和 trailer*/
+
+	/**
+	 * 空闲缓冲区的回收，参考 setBufferShrinkPolicy()
+	 * 只有缓冲区占用的内存超过了初始的大小，才会启动一个定时器检查是否空闲
+	*/
+	double bufferIdleSeconds_;
+	Timestamp lastBufferActive_;
+	bool shrinkTimerArmed_;
+	size_t reportedCapacity_;	/*已经计入 EventLoop::bufferCapacity() 的容量*/
+
+	/**
+	 * 自适应的读，参考 handleRead()
+	 * readHint_ 根据最近几次读到的字节数调整，读之前保证输入缓冲区至少有这么多的可写空间
+	*/
+	size_t readBudget_;
+	size_t readHint_;
+	int64_t readCalls_;
+	int64_t bytesRead_;
+
+	/**
+	 * 边沿触发，参考 setEdgeTriggered()
+	 * 超过读写预算没有处理完的时候放到 loop 的 pendingFunctors 中继续，*ResumeQueued_ 避免重复放入
+	*/
+	bool edgeTriggered_;
+	size_t writeBudget_;
+	bool readResumeQueued_;
+	bool writeResumeQueued_;
+
+	/**
+	 * 合并写，参考 setWriteCoalescing() 和 cork()
+	 * corked_ 的时候 send() 不直接写 socket，也不关注可写事件，等待 flush()
+	 * userCorked_ 表示是用户调用的 cork()，handleRead() 自动的 flush() 不能取消它
+	*/
+	bool coalesceWrites_;
+	bool corked_;
+	bool userCorked_;
+	int64_t writeCalls_;
+
 	boost::any context_;
 private:
 	void handleRead(Timestamp receiveTime);
@@ -61,9 +126,25 @@ private:
 	void handleClose();
 	void handleError();
 
-	// void sendInLoop(string&& message);
 	void sendInLoop(const StringPiece& message);
+	/*普通函数指针比成员函数指针小 8 字节，绑定了 this 和一个 Buffer 之后刚好放得进 EventLoop::Functor*/
+	static void sendBufferInLoop(TcpConnection* conn, const Buffer& message);
+	static void sendSlicesInLoop(TcpConnection* conn, const std::vector<Slice>& slices);
+	void sendInLoop(const Slice* slices, size_t count);
+	static const int kMaxSendIovec = 64;	/*直接发送的时候一次 writev() 最多的 slice 个数*/
 	void sendInLoop(const void* message, size_t len);
+	void sendFileInLoop(int fd, off_t offset, size_t len);
+	bool sendPendingFiles();
+	size_t queuedBytes() const { return outputBuffer_.readableBytes() + pendingBytes_; }
+	bool outputPending() const;
+	void queueResume(bool* queued, void (TcpConnection::*resume)());
+	void resumeRead();
+	void resumeWrite();
+	void adjustReadHint(size_t n);
+	void noteBufferActivity();
+	void checkIdleBuffers();
+	bool buffersShrinkable() const;
+	void updateBufferCapacity();
 	void shutdownInLoop();
 	// void shutdownAndForceCloseInLoop(double seconds);
 	void forceCloseInLoop();
@@ -92,8 +173,26 @@ public:
 
 	void send(const void* message, int len);
 	void send(const StringPiece& message);
-	// void send(Buffer&& message); // C++11
+	/*字符串常量，否则 send(StringPiece) 和 send(string&&) 都需要一次转换，有歧义*/
+	void send(const char* message) { send(StringPiece(message)); }
+	/**
+	 * 取走 message 的内容，其他线程调用的时候数据直接移动到 loop 线程，没有中间的拷贝
+	 * 适合在其他线程（例如 ThreadPool）中组装好整个回复再发送
+	*/
+	void send(string&& message);
+	void send(Buffer&& message);
 	void send(Buffer* message);  // this one will swap data
+	/**
+	 * 一次发送多段数据，例如协议的头部和消息体，参考 Slice
+	 * 能写的部分通过一次 writev() 写入 socket，剩下的不需要拼接，有 owner 的 slice 直接排队
+	*/
+	void send(const Slice* slices, size_t count);
+	void send(std::initializer_list<Slice> slices) { send(slices.begin(), slices.size()); }
+	/**
+	 * 零拷贝的发送文件 fd 中 [offset, offset + len) 的内容，线程安全
+	 * fd 会被 dup 一份，调用者可以在返回之后立刻关闭自己的 fd
+	*/
+	void sendFile(int fd, off_t offset, size_t len);
 	void shutdown(); // NOT thread safe, no simultaneous calling
 	// void shutdownAndForceCloseAfter(double seconds); // NOT thread safe, no simultaneous calling
 	void forceClose();
@@ -125,11 +224,69 @@ public:
 	void setHighWaterMarkCallback(const HighWaterMarkCallback& cb, size_t highWaterMark)
 	{ highWaterMarkCallback_ = cb; highWaterMark_ = highWaterMark; }
 
+	/**
+	 * 输入输出缓冲区超过 idleSeconds 秒没有读写之后，把多出来的内存还给分配器
+	 * 0 表示不回收，这是默认值。在 connectEstablished() 之前或者在 loop 线程中调用
+	*/
+	void setBufferShrinkPolicy(double idleSeconds)
+	{ bufferIdleSeconds_ = idleSeconds; }
+
+	/**立即回收空闲的缓冲区，只能在 loop 线程中调用*/
+	void shrinkBuffers();
+
+	/**
+	 * 一次可读事件最多读多少字节。第一次 read 填满了可写区域的时候，用 FIONREAD 查询 socket 中剩下的数据
+	 * 继续读，直到读完或者超过 bytes，之后只调用一次 messageCallback
+	 * 0 表示每次事件只读一次。在 loop 线程中调用
+	*/
+	void setReadBudget(size_t bytes)
+	{ readBudget_ = bytes; }
+
+	/**
+	 * 使用边沿触发 (EPOLLET)，在 connectEstablished() 之前调用，Poller 不支持的时候退化为水平触发
+	 * 每一次事件都读到 EAGAIN，写到 socket 写满，可写事件一直关注，不再反复的 epoll_ctl()
+	 * 一次事件读写超过预算之后，剩下的放到这一轮的事件都处理完之后继续，保证同一个 loop 上的连接之间的公平
+	*/
+	void setEdgeTriggered(bool on)
+	{ edgeTriggered_ = on; }
+	bool edgeTriggered() const { return edgeTriggered_; }
+
+	/**边沿触发的时候一次可写事件最多写多少字节，在 loop 线程中调用*/
+	void setWriteBudget(size_t bytes)
+	{ writeBudget_ = bytes; }
+
+	/**
+	 * 合并 messageCallback 中的多次 send()：回调期间 send() 的数据只放入输出缓冲区，
+	 * 回调返回之后调用一次 flush()，一次 writev() 发送出去。流水线的请求一次读到多个的时候，
+	 * 多个响应只需要一次系统调用。在 connectEstablished() 之前调用
+	*/
+	void setWriteCoalescing(bool on)
+	{ coalesceWrites_ = on; }
+	bool writeCoalescing() const { return coalesceWrites_; }
+
+	/**
+	 * 手动合并：cork() 之后的 send() 只放入输出缓冲区，直到 flush()
+	 * 只能在 loop 线程中调用
+	*/
+	void cork();
+	void flush();
+
+	/**向 socket 写数据的系统调用 (write/writev) 的次数，不包括 sendfile*/
+	int64_t writeCalls() const { return writeCalls_; }
+
+	/**read 系统调用的次数和读到的总字节数，两者相除就是每次系统调用读到的平均字节数*/
+	int64_t readCalls() const { return readCalls_; }
+	int64_t bytesRead() const { return bytesRead_; }
+
+	/**输入缓冲区和输出缓冲区当前的容量，只能在 loop 线程中调用*/
+	size_t bufferCapacity() const
+	{ return inputBuffer_.internalCapacity() + outputBuffer_.internalCapacity(); }
+
 	/// Advanced interface
 	Buffer* inputBuffer()
 	{ return &inputBuffer_; }
 
-	Buffer* outputBuffer()
+	ChainBuffer* outputBuffer()
 	{ return &outputBuffer_; }
 
 	/// Internal use only.
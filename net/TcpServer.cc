@@ -1,29 +1,56 @@
 #include "net/TcpServer.h"
 
+#include "base/CountDownLatch.h"
 #include "base/Logging.h"
 #include "net/Acceptor.h"
 #include "net/EventLoop.h"
 #include "net/EventLoopThreadPool.h"
 #include "net/SocketsOps.h"
 
+#include <atomic>
+
 #include <stdio.h>  // snprintf
 
 using namespace muduo;
 using namespace muduo::net;
 
+struct TcpServer::LoopAcceptor
+{
+	LoopAcceptor(EventLoop* ioLoop, int i)
+		: loop(ioLoop), index(i), nextConnId(1), numConnections(0)
+	{}
+
+	EventLoop* loop;
+	int index;
+	std::unique_ptr<Acceptor> acceptor;
+	ConnectionMap connections;
+	int nextConnId;
+	std::atomic<int> numConnections;	/*分配到这个 loop 的连接数，其他 loop 选择的时候读取*/
+};
+
 
 TcpServer::TcpServer(EventLoop* loop,
 					 const InetAddress& listenAddr,
 					 const string& nameArg,
 					 Option option)
   : loop_(CHECK_NOTNULL(loop)),
+	listenAddr_(listenAddr),
+	option_(option),
 	ipPort_(listenAddr.toIpPort()),
 	name_(nameArg),
-	acceptor_(new Acceptor(loop, listenAddr, option == kReusePort)),
+	acceptor_(new Acceptor(loop, listenAddr, option != kNoReusePort)),
 	threadPool_(new EventLoopThreadPool(loop, name_)),
 	connectionCallback_(defaultConnectionCallback),
 	messageCallback_(defaultMessageCallback),
-	nextConnId_(1)
+	bufferIdleSeconds_(0.0),
+	edgeTriggered_(false),
+	writeCoalescing_(false),
+	maxAcceptsPerEvent_(1),
+	acceptTimeBudget_(0.0),
+	maxConnections_(0),
+	nextConnId_(1),
+	numConnections_(0),
+	self_(this, [](TcpServer*) {})
 {
 	acceptor_->setNewConnectionCallback(
 		std::bind(&TcpServer::newConnection, this, _1, _2));
@@ -33,6 +60,10 @@ TcpServer::~TcpServer()
 {
 	loop_->assertInLoopThread();
 	LOG_TRACE << "TcpServer::~TcpServer [" << name_ << "] destructing";
+	self_.reset();
+
+	if (!loopAcceptors_.empty())
+		stopLoopAcceptors();
 
 	for (auto& item : connections_)
 	{
@@ -47,10 +78,10 @@ TcpServer::~TcpServer()
 /**
  * 要使用多少个 子线程（每一个线程一个 loop 负责 io 事件） 来处理所有的 TCP 的 IO 事件
 */
-void TcpServer::setThreadNum(int numThreads)
+void TcpServer::setThreadNum(int numThreads, const CpuPlacement& placement)
 {
 	assert(0 <= numThreads);
-	threadPool_->setThreadNum(numThreads);
+	threadPool_->setThreadNum(numThreads, placement);
 }
 
 /**
@@ -62,7 +93,32 @@ void TcpServer::start()
 	{
 		this->threadPool_->start(threadInitCallback_);
 
+		std::vector<EventLoop*> loops = threadPool_->getAllLoops();
+		if (option_ == kReusePortPerLoop && loops.front() != loop_)
+		{
+			/**
+			 * 每一个 io loop 在同一个地址上创建自己的监听 socket，内核按照四元组的 hash 把连接分到各个 socket 上
+			 * acceptor_ 只用来在构造的时候检查地址是否可用，它没有 listen()，不会分到连接
+			 * 所有的 LoopAcceptor 创建完之后才开始 listen()，之后 loopAcceptors_ 不再改变，可以在各个 loop 中读取
+			*/
+			for (size_t i = 0; i < loops.size(); ++i)
+			{
+				LoopAcceptor* la = new LoopAcceptor(loops[i], static_cast<int>(i));
+				la->acceptor.reset(new Acceptor(loops[i], listenAddr_, true));
+				configureAcceptor(get_pointer(la->acceptor));
+				la->acceptor->setNewConnectionCallback(
+					std::bind(&TcpServer::newConnectionInLoop, this, la, _1, _2));
+				loopAcceptors_.emplace_back(la);
+			}
+			for (auto& la : loopAcceptors_)
+			{
+				la->loop->runInLoop(std::bind(&Acceptor::listen, get_pointer(la->acceptor)));
+			}
+			return;
+		}
+
 		assert(!acceptor_->listenning());
+		configureAcceptor(get_pointer(acceptor_));
 		/**
 		 * 接收器开始工作，在 loop_ 的下一次循环当中，就会去执行下面的函数（之后执行一次）。后面的工作交给
 		 * 已经注册在 loop_->poller 下面的 socketChannel_ 进行连接到达的处理
@@ -111,6 +167,7 @@ void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr)
 		localAddr,
 		peerAddr));
 	connections_[connName] = conn; /**新的连接添加到 map 当中*/
+	numConnections_.store(static_cast<int>(connections_.size()), std::memory_order_relaxed);
 	/**
 	 * 一个 Tcp 服务端需要管理多个 Tcp 数据连接。使用 map 管理这些连接可以快速进行查找
 	*/
@@ -123,11 +180,14 @@ void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr)
 	 * 有数据到达，使用这个回调来通知上层程序
 	*/
 	conn->setWriteCompleteCallback(writeCompleteCallback_);
+	conn->setBufferShrinkPolicy(bufferIdleSeconds_);
+	conn->setEdgeTriggered(edgeTriggered_);
+	conn->setWriteCoalescing(writeCoalescing_);
 	/**
 	 * 如果一个数据链接需要关闭的时候，自然其要从 TcpServer 当中删除
 	*/
 	conn->setCloseCallback(
-      	std::bind(&TcpServer::removeConnection, this, _1)); // FIXME: unsafe
+      	std::bind(&TcpServer::removeConnection, loop_, std::weak_ptr<TcpServer>(self_), _1));
 
 	ioloop->runInLoop(std::bind(&TcpConnection::connectEstablished, conn));
 }
@@ -135,9 +195,18 @@ void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr)
 /**
  * 一个 Tcp 连接传输完毕，需要进行的处理
 */
-void TcpServer::removeConnection(const TcpConnectionPtr& conn)
+void TcpServer::removeConnection(EventLoop* loop,
+								 const std::weak_ptr<TcpServer>& server,
+								 const TcpConnectionPtr& conn)
 {
-	this->loop_->runInLoop(std::bind(&TcpServer::removeConnectionInLoop, this, conn));
+	/**
+	 * TcpServer 析构的时候已经把 connections_ 中所有的连接交给了 connectDestroyed()，这里不需要再做什么
+	*/
+	loop->runInLoop([server, conn] {
+		std::shared_ptr<TcpServer> s(server.lock());
+		if (s)
+			s->removeConnectionInLoop(conn);
+	});
 }
 
 
@@ -152,8 +221,204 @@ void TcpServer::removeConnectionInLoop(const TcpConnectionPtr& conn)
 	size_t n = this->connections_.erase(conn->name());
 	(void)n;
 	assert(n == 1);
+	numConnections_.store(static_cast<int>(connections_.size()), std::memory_order_relaxed);
 	EventLoop* ioloop = conn->getLoop();
 	ioloop->queueInLoop(
 		std::bind(&TcpConnection::connectDestroyed, conn)
 	);
 }
+
+/**
+ * kReusePortPerLoop 的时候，在 accept 的 loop 中调用
+ * 内核的 hash 不保证各个 socket 分到的连接一样多，这个 loop 的连接明显比最少的 loop 多的时候，交给那个 loop
+ * 交出去的连接只多一次跨线程的 queueInLoop()，不经过 base loop
+*/
+void TcpServer::newConnectionInLoop(LoopAcceptor* la, int sockfd, const InetAddress& peerAddr)
+{
+	la->loop->assertInLoopThread();
+	LoopAcceptor* target = leastLoadedLoop(la);
+	target->numConnections.fetch_add(1, std::memory_order_relaxed);
+	if (target == la)
+		establishConnection(la, sockfd, peerAddr);
+	else
+		target->loop->queueInLoop(
+			std::bind(&TcpServer::establishConnection, this, target, sockfd, peerAddr));
+}
+
+/**
+ * 允许各个 loop 之间相差的连接数，差得不多的时候留在 accept 的 loop 中，不用跨线程
+*/
+static const int kMaxLoopImbalance = 1;
+
+TcpServer::LoopAcceptor* TcpServer::leastLoadedLoop(LoopAcceptor* la)
+{
+	int mine = la->numConnections.load(std::memory_order_relaxed);
+	LoopAcceptor* least = la;
+	int fewest = mine;
+	for (auto& other : loopAcceptors_)
+	{
+		int n = other->numConnections.load(std::memory_order_relaxed);
+		if (n < fewest)
+		{
+			fewest = n;
+			least = get_pointer(other);
+		}
+	}
+	return mine - fewest > kMaxLoopImbalance ? least : la;
+}
+
+/**
+ * 和 newConnection() 一样，只是连接放在 la->connections 中，关闭的时候也在这个 loop 中处理
+*/
+void TcpServer::establishConnection(LoopAcceptor* la, int sockfd, const InetAddress& peerAddr)
+{
+	la->loop->assertInLoopThread();
+	char buf[64];
+	snprintf(buf, sizeof buf, "-%s#%d-%d", ipPort_.c_str(), la->index, la->nextConnId);
+	++la->nextConnId;
+	string connName = name_ + buf;
+
+	LOG_INFO << "TcpServer::establishConnection [" << name_
+			 << "] - new connection [" << connName
+			 << "] from " << peerAddr.toIpPort();
+
+	InetAddress localAddr(sockets::getLocalAddr(sockfd));
+	TcpConnectionPtr conn(new TcpConnection(
+		la->loop,
+		connName,
+		sockfd,
+		localAddr,
+		peerAddr));
+	la->connections[connName] = conn;
+	conn->setConnectionCallback(connectionCallback_);
+	conn->setMessageCallback(messageCallback_);
+	conn->setWriteCompleteCallback(writeCompleteCallback_);
+	conn->setBufferShrinkPolicy(bufferIdleSeconds_);
+	conn->setEdgeTriggered(edgeTriggered_);
+	conn->setWriteCoalescing(writeCoalescing_);
+	conn->setCloseCallback(
+		std::bind(&TcpServer::removeLoopConnection, std::weak_ptr<TcpServer>(self_), la, _1));
+	conn->connectEstablished();
+}
+
+/**
+ * 关闭回调已经在 la->loop 中，lock() 成功的时候析构函数中的 stopLoopAcceptors() 排在这个回调之后，
+ * 这时 TcpServer 和 la 都还有效；TcpServer 析构之后 lock() 失败，连接已经被 stopLoopAcceptors() 销毁
+*/
+void TcpServer::removeLoopConnection(const std::weak_ptr<TcpServer>& server,
+									 LoopAcceptor* la,
+									 const TcpConnectionPtr& conn)
+{
+	std::shared_ptr<TcpServer> s(server.lock());
+	if (s)
+		s->removeLoopConnectionInLoop(la, conn);
+}
+
+void TcpServer::removeLoopConnectionInLoop(LoopAcceptor* la, const TcpConnectionPtr& conn)
+{
+	la->loop->assertInLoopThread();
+	LOG_INFO << "TcpServer::removeLoopConnectionInLoop [" << name_
+			 << "] - connection " << conn->name();
+	size_t n = la->connections.erase(conn->name());
+	(void)n;
+	assert(n == 1);
+	la->numConnections.fetch_sub(1, std::memory_order_relaxed);
+	la->loop->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+}
+
+/**
+ * 析构的时候在 base loop 中调用，等待每一个 io loop 完成
+ * 先停止所有的 Acceptor，这之后不会再有连接交给其他的 loop，已经交出去的排在第二步的前面
+ * 再在各自的 loop 中销毁连接
+*/
+void TcpServer::stopLoopAcceptors()
+{
+	CountDownLatch stopped(static_cast<int>(loopAcceptors_.size()));
+	for (auto& la : loopAcceptors_)
+	{
+		LoopAcceptor* p = get_pointer(la);
+		p->loop->runInLoop([p, &stopped] {
+			p->acceptor.reset();
+			stopped.countDown();
+		});
+	}
+	stopped.wait();
+
+	CountDownLatch destroyed(static_cast<int>(loopAcceptors_.size()));
+	for (auto& la : loopAcceptors_)
+	{
+		LoopAcceptor* p = get_pointer(la);
+		p->loop->runInLoop([p, &destroyed] {
+			for (auto& item : p->connections)
+			{
+				TcpConnectionPtr conn(item.second);
+				item.second.reset();
+				conn->connectDestroyed();
+			}
+			p->connections.clear();
+			destroyed.countDown();
+		});
+	}
+	destroyed.wait();
+}
+
+void TcpServer::configureAcceptor(Acceptor* acceptor)
+{
+	acceptor->setMaxAcceptsPerEvent(maxAcceptsPerEvent_);
+	acceptor->setAcceptTimeBudget(acceptTimeBudget_);
+	if (maxConnections_ > 0)
+		acceptor->setAdmissionCallback(std::bind(&TcpServer::admitConnection, this));
+}
+
+/**
+ * kReusePortPerLoop 的时候各个 loop 的连接数相加，numConnections 在选择 loop 的时候就已经加上了
+ * 否则在 base loop 中调用，connections_ 就是当前的连接
+*/
+bool TcpServer::admitConnection() const
+{
+	size_t n = 0;
+	if (loopAcceptors_.empty())
+	{
+		loop_->assertInLoopThread();
+		n = connections_.size();
+	}
+	else
+	{
+		for (const auto& la : loopAcceptors_)
+		{
+			n += la->numConnections.load(std::memory_order_relaxed);
+		}
+	}
+	return n < static_cast<size_t>(maxConnections_);
+}
+
+int TcpServer::numConnections() const
+{
+	if (loopAcceptors_.empty())
+		return numConnections_.load(std::memory_order_relaxed);
+	int n = 0;
+	for (const auto& la : loopAcceptors_)
+	{
+		n += la->numConnections.load(std::memory_order_relaxed);
+	}
+	return n;
+}
+
+TcpServer::AcceptStats TcpServer::acceptStats() const
+{
+	AcceptStats stats = { 0, 0, 0, 0 };
+	std::vector<const Acceptor*> acceptors(1, get_pointer(acceptor_));
+	for (const auto& la : loopAcceptors_)
+	{
+		if (la->acceptor)
+			acceptors.push_back(get_pointer(la->acceptor));
+	}
+	for (const Acceptor* acceptor : acceptors)
+	{
+		stats.events += acceptor->acceptEvents();
+		stats.accepted += acceptor->accepted();
+		stats.rejected += acceptor->rejected();
+		stats.errors += acceptor->acceptErrors();
+	}
+	return stats;
+}
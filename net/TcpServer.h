@@ -3,10 +3,13 @@
 
 
 #include "base/Atomic.h"
+#include "base/CpuPlacement.h"
 #include "base/Types.h"
 #include "net/TcpConnection.h"
 
+#include <atomic>
 #include <map>
+#include <vector>
 
 namespace muduo
 {
@@ -20,10 +23,16 @@ class TcpServer : noncopyable
 {
 public:
 	typedef std::function<void(EventLoop*)> ThreadInitCallback;
+	/**
+	 * kReusePortPerLoop: 每一个 io loop 有一个自己的 SO_REUSEPORT 的 Acceptor，在自己的线程中 accept，
+	 * 新的连接不再经过 base loop。参考 start() 和 newConnectionInLoop()
+	 * 没有 io 线程的时候和 kReusePort 一样
+	*/
 	enum Option
 	{
 		kNoReusePort,
 		kReusePort,
+		kReusePortPerLoop,
 	};
 
 	//TcpServer(EventLoop* loop, const InetAddress& listenAddr);
@@ -39,7 +48,8 @@ public:
 
 	/// Set the number of threads for handling input.
 	///
-	/// Always accepts new connection in loop's thread.
+	/// Always accepts new connection in loop's thread,
+	/// except with kReusePortPerLoop, where each io loop accepts for itself.
 	/// Must be called before @c start
 	/// @param numThreads
 	/// - 0 means all I/O in loop's thread, no thread will created.
@@ -47,7 +57,7 @@ public:
 	/// - 1 means all I/O in another thread.
 	/// - N means a thread pool with N threads, new connections
 	///   are assigned on a round-robin basis.
-	void setThreadNum(int numThreads);
+	void setThreadNum(int numThreads, const CpuPlacement& placement = CpuPlacement());
 	void setThreadInitCallback(const ThreadInitCallback& cb)
 	{ threadInitCallback_ = cb; }
 	/// valid after calling start()
@@ -75,17 +85,90 @@ public:
 	void setWriteCompleteCallback(const WriteCompleteCallback& cb)
 	{ writeCompleteCallback_ = cb; }
 
+	/// 连接的缓冲区空闲 idleSeconds 秒之后回收内存，参考 TcpConnection::setBufferShrinkPolicy()
+	/// 只对之后建立的连接有效
+	/// Not thread safe.
+	void setBufferShrinkPolicy(double idleSeconds)
+	{ bufferIdleSeconds_ = idleSeconds; }
+
+	/// 连接使用边沿触发，参考 TcpConnection::setEdgeTriggered()
+	/// 只对之后建立的连接有效
+	/// Not thread safe.
+	void setEdgeTriggered(bool on)
+	{ edgeTriggered_ = on; }
+
+	/// 合并 messageCallback 中的多次 send()，参考 TcpConnection::setWriteCoalescing()
+	/// 只对之后建立的连接有效
+	/// Not thread safe.
+	void setWriteCoalescing(bool on)
+	{ writeCoalescing_ = on; }
+
+	/// 一次可读事件最多 accept 多少个连接，最多用多长时间 (秒，0 表示不限制)
+	/// 参考 Acceptor::setMaxAcceptsPerEvent()
+	/// Must be called before @c start
+	void setAcceptBatch(int maxAcceptsPerEvent, double timeBudgetSeconds = 0.0)
+	{
+		maxAcceptsPerEvent_ = maxAcceptsPerEvent;
+		acceptTimeBudget_ = timeBudgetSeconds;
+	}
+
+	/// 最多同时有多少个连接，超过之后新的连接 accept 之后马上关闭，0 表示不限制
+	/// Must be called before @c start
+	void setMaxConnections(int n)
+	{ maxConnections_ = n; }
+
+	/// 所有 Acceptor 的统计，参考 Acceptor::acceptEvents()
+	/// Thread safe.
+	struct AcceptStats
+	{
+		int64_t events;		/*可读事件的次数，accepted / events 就是平均每次事件 accept 的连接数*/
+		int64_t accepted;
+		int64_t rejected;	/*超过 setMaxConnections() 或者 EMFILE*/
+		int64_t errors;
+	};
+	AcceptStats acceptStats() const;
+
+	/// 当前的连接数，包括已经关闭但是还没有从 TcpServer 中删除的
+	/// Thread safe.
+	int numConnections() const;
+
 private:
 	/// Not thread safe, but in loop
 	void newConnection(int sockfd, const InetAddress& peerAddr);
-	/// Thread safe.
-	void removeConnection(const TcpConnectionPtr& conn);
+	/// Thread safe. 在连接的 loop 中调用，这时 TcpServer 可能已经析构，只使用参数中的 loop 和 server
+	static void removeConnection(EventLoop* loop,
+								 const std::weak_ptr<TcpServer>& server,
+								 const TcpConnectionPtr& conn);
 	/// Not thread safe, but in loop
 	void removeConnectionInLoop(const TcpConnectionPtr& conn);
 
 	typedef std::map<string, TcpConnectionPtr> ConnectionMap;
 
+	/**
+	 * kReusePortPerLoop 的时候每一个 io loop 一个
+	 * 这个 loop 上的连接放在自己的 connections 中，只在这个 loop 的线程中访问，不需要经过 base loop
+	*/
+	struct LoopAcceptor;
+
+	/// in la->loop
+	void newConnectionInLoop(LoopAcceptor* la, int sockfd, const InetAddress& peerAddr);
+	/// in la->loop
+	void establishConnection(LoopAcceptor* la, int sockfd, const InetAddress& peerAddr);
+	/// in la->loop，和 removeConnection() 一样只通过 server 访问 TcpServer
+	static void removeLoopConnection(const std::weak_ptr<TcpServer>& server,
+									 LoopAcceptor* la,
+									 const TcpConnectionPtr& conn);
+	/// in la->loop
+	void removeLoopConnectionInLoop(LoopAcceptor* la, const TcpConnectionPtr& conn);
+	LoopAcceptor* leastLoadedLoop(LoopAcceptor* la);
+	void configureAcceptor(Acceptor* acceptor);
+	/// in the accepting loop
+	bool admitConnection() const;
+	void stopLoopAcceptors();
+
 	EventLoop* loop_;  // the acceptor loop
+	const InetAddress listenAddr_;
+	const Option option_;
 	const string ipPort_;
 	const string name_;
 	std::unique_ptr<Acceptor> acceptor_; // avoid revealing Acceptor
@@ -97,10 +180,24 @@ private:
 	MessageCallback messageCallback_;
 	WriteCompleteCallback writeCompleteCallback_;
 	ThreadInitCallback threadInitCallback_;
+	double bufferIdleSeconds_;
+	bool edgeTriggered_;
+	bool writeCoalescing_;
+	int maxAcceptsPerEvent_;
+	double acceptTimeBudget_;
+	int maxConnections_;
 	AtomicInt32 started_;
 	// always in loop thread
 	int nextConnId_;
 	ConnectionMap connections_;
+	std::atomic<int> numConnections_;	/*connections_.size()，其他线程读取*/
+	/**
+	 * 不拥有 TcpServer（deleter 什么都不做），连接的 close 回调持有它的 weak_ptr
+	 * 析构和回调中的检查都在 loop_ 中，已经排在队列中的 removeConnectionInLoop() 在 TcpServer 析构之后什么都不做
+	 * kReusePortPerLoop 的时候检查在 io loop 中，stopLoopAcceptors() 保证析构函数等到正在执行的回调结束
+	*/
+	std::shared_ptr<TcpServer> self_;
+	std::vector<std::unique_ptr<LoopAcceptor> > loopAcceptors_;	/*start() 之后不再改变*/
 };
 
 } // namespace net
@@ -17,4 +17,14 @@ void Timer::restart(Timestamp now)
 	{
 		this->expiration_ = Timestamp::invalid();	/* = TimeStamp(0)*/
 	}
-}
\ No newline at end of file
+}
+
+void Timer::reuse(TimerCallback cb, Timestamp when, double interval)
+{
+	this->callback_ = std::move(cb);
+	this->expiration_ = when;
+	this->interval_ = interval;
+	this->repeat_ = interval > 0.0;
+	this->sequence_ = s_numCreated_.incrementAndGet();
+	this->index_ = -1;
+}
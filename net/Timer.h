@@ -19,7 +19,8 @@ public:
       expiration_(when),
       interval_(interval),
       repeat_(interval > 0.0), /*timer 的间隔时间被设置为 > 0 的值，那么这个 timer 就是重复发生的*/
-      sequence_(s_numCreated_.incrementAndGet())
+      sequence_(s_numCreated_.incrementAndGet()),
+      index_(-1)
  	{ }
 
 	void run() const
@@ -33,13 +34,25 @@ public:
 
 	void restart(Timestamp now);
 
+	/**
+	 * 用于 TimerQueue 的堆存储方式，Timer 对象会被回收重复使用
+	 * reuse() 之后分配一个新的 sequence_，旧的 TimerId 就不会再匹配到这个 timer
+	*/
+	void reuse(TimerCallback cb, Timestamp when, double interval);
+	void releaseCallback() { callback_ = TimerCallback(); }
+
+	// for TimerQueue, timer 在堆中的下标，不在堆中的时候为 -1
+	int index() const { return index_; }
+	void set_index(int idx) { index_ = idx; }
+
 	static int64_t numCreated() { return s_numCreated_.get(); }
 private:
-	const TimerCallback callback_;
+	TimerCallback callback_;
 	Timestamp expiration_;
-	const double interval_;
-	const bool repeat_;
-	const int64_t sequence_;
+	double interval_;
+	bool repeat_;
+	int64_t sequence_;
+	int index_;
 
 	static AtomicInt64 s_numCreated_;
 };
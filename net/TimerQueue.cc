@@ -9,6 +9,8 @@
 #include "net/TimerId.h"
 #include "net/Timer.h"
 
+#include <algorithm>
+
 #include <sys/timerfd.h>
 #include <unistd.h>
 
@@ -74,6 +76,17 @@ void readTimerfd(int timerfd, Timestamp now)
 	}
 }
 
+/**
+ * 堆中 timer 的顺序，时间相同的时候先创建的先触发
+*/
+inline bool timerLess(const Timer* lhs, const Timer* rhs)
+{
+	return lhs->expiration() < rhs->expiration() ||
+		(lhs->expiration() == rhs->expiration() && lhs->sequence() < rhs->sequence());
+}
+
+const size_t kHeapArity = 4;
+
 void resetTimerfd(int timerfd, Timestamp expiration)
 {
 	// wake up loop by timerfd_settime()
@@ -117,7 +130,13 @@ TimerQueue::TimerQueue(EventLoop* loop)
     timerfd_(createTimerfd()),	/*一个时间事件文件描述符*/
     timerfdChannel_(loop, timerfd_),	/*属于一个 eventloop , 注册一个 timer 事件*/
     timers_(),
-    callingExpiredTimers_(false)
+    callingExpiredTimers_(false),
+    option_(EventLoop::kTimerSet),
+    deferRearm_(false),
+    rearmPending_(false),
+    slackMicroSeconds_(0),
+    rearmRequests_(0),
+    rearmSyscalls_(0)
 {
 	timerfdChannel_.setReadCallback(
 		std::bind(&TimerQueue::handleRead, this));
@@ -137,6 +156,21 @@ TimerQueue::~TimerQueue()
 	{
 		delete timer.second;
 	}
+	for (Timer* timer : heap_)
+	{
+		delete timer;
+	}
+	for (Timer* timer : freeTimers_)
+	{
+		delete timer;
+	}
+}
+
+void TimerQueue::setOption(EventLoop::TimerQueueOption option)
+{
+	loop_->assertInLoopThread();
+	assert(timers_.empty() && heap_.empty());
+	option_ = option;
 }
 
 TimerId TimerQueue::addTimer(TimerCallback cb,
@@ -148,7 +182,21 @@ TimerId TimerQueue::addTimer(TimerCallback cb,
 	 * interval timer 重复触发的话，时间间隔
 	*/
 {
-	Timer* timer = new Timer(std::move(cb), when, interval);
+	Timer* timer = NULL;
+	if (option_ == EventLoop::kTimerHeap && loop_->isInLoopThread() && !freeTimers_.empty())
+	{
+		/**
+		 * 堆模式下，loop 线程里面添加的 timer 优先复用回收的 Timer 对象
+		 * freeTimers_ 只在 loop 线程中访问，其他线程仍然 new 一个新的对象
+		*/
+		timer = freeTimers_.back();
+		freeTimers_.pop_back();
+		timer->reuse(std::move(cb), when, interval);
+	}
+	else
+	{
+		timer = new Timer(std::move(cb), when, interval);
+	}
 	/**
 	 * 一个新的 timer 是通过 new 产生的，注意释放
 	*/
@@ -180,7 +228,7 @@ void TimerQueue::addTimerInLoop(Timer* timer)
 	*/
 	if (earliestChanged)
 	{
-		resetTimerfd(timerfd_, timer->expiration());
+		requestRearm();
 	}
 }
 
@@ -190,6 +238,29 @@ void TimerQueue::addTimerInLoop(Timer* timer)
 void TimerQueue::cancelInLoop(TimerId timerid)
 {
 	loop_->assertInLoopThread();
+	if (option_ == EventLoop::kTimerHeap)
+	{
+		/**
+		 * 堆模式下 Timer 对象不会被释放，可以直接访问
+		 * sequence 不相同说明这个 timer 已经结束并且被复用了
+		*/
+		Timer* timer = timerid.timer_;
+		if (timer == NULL || timer->sequence() != timerid.sequence_)
+		{
+			return;
+		}
+		if (timer->index() >= 0)
+		{
+			heapRemove(timer);
+			recycle(timer);
+		}
+		else if (callingExpiredTimers_)
+		{
+			cancelingTimers_.insert(ActiveTimer(timer, timerid.sequence_));
+		}
+		return;
+	}
+
 	assert(timers_.size() == activeTimers_.size());
 	ActiveTimer timer(timerid.timer_, timerid.sequence_);
 	ActiveTimerSet::iterator it = activeTimers_.find(timer);
@@ -211,11 +282,13 @@ void TimerQueue::handleRead()
 {
 	loop_->assertInLoopThread();
 	Timestamp now(Timestamp::now());
-	readTimerfd(timerfd_, now);		/**在这里 read 的作用是什么，由于是非阻塞的，无论这个函数执行结果如何，下面的内容都同样的执行*/
+	/**在这里 read 的作用是什么，由于是非阻塞的，无论这个函数执行结果如何，下面的内容都同样的执行*/
 	/**
 	 * 由于事件是由 epoll 所监控，有事件发生的时候触发的，所以这里的 readTimerfd 一定可以读到相应的内容
 	 * read() 的作用就是重置 timerfd_ 的
 	*/
+	readTimerfd(timerfd_, now);
+	armed_ = Timestamp::invalid();	/*timerfd 是一次性的，触发之后就不再设置*/
 
 	std::vector<Entry> expired = getExpired(now);
 
@@ -234,6 +307,22 @@ void TimerQueue::handleRead()
 */
 std::vector<TimerQueue::Entry> TimerQueue::getExpired(Timestamp now)
 {
+	if (option_ == EventLoop::kTimerHeap)
+	{
+		/**
+		 * 与 set 的 lower_bound(sentry) 相同，所有 expiration <= now 的 timer 都算作超时
+		*/
+		std::vector<Entry> expired;
+		while (!heap_.empty() && !(now < heap_[0]->expiration()))
+		{
+			Timer* timer = heap_[0];
+			heapRemove(timer);
+			expired.push_back(Entry(timer->expiration(), timer));
+		}
+		LOG_TRACE << "have " << expired.size() << " timer expired";
+		return expired;
+	}
+
 	assert(timers_.size() == activeTimers_.size());
 	LOG_TRACE << "have " << timers_.size() << " timers in queue before getExpired";
 	std::vector<Entry> expired;
@@ -278,6 +367,10 @@ void TimerQueue::reset(const std::vector<Entry>& expired, Timestamp now)
 			it.second->restart(now);
 			insert(it.second);
 		}
+		else if (option_ == EventLoop::kTimerHeap)
+		{
+			recycle(it.second);
+		}
 		else 
 		{
 			delete it.second;
@@ -287,23 +380,94 @@ void TimerQueue::reset(const std::vector<Entry>& expired, Timestamp now)
 		}
 	}
 
-	if (!timers_.empty())
-	{
-		nextExpire = timers_.begin()->second->expiration();
-	}
+	nextExpire = earliestExpiration();
 	if (nextExpire.valid())
 	{
 		/**
 		 * timerfd 被重新设定为一个新的值，这个值就是当前的 set 中最早的那个 timer 定时值
 		*/
-		resetTimerfd(timerfd_, nextExpire);
+		requestRearm();
+	}
+}
+
+Timestamp TimerQueue::earliestExpiration() const
+{
+	if (option_ == EventLoop::kTimerHeap)
+	{
+		return heap_.empty() ? Timestamp::invalid() : heap_[0]->expiration();
 	}
+	return timers_.empty() ? Timestamp::invalid() : timers_.begin()->second->expiration();
+}
+
+void TimerQueue::setSlack(double seconds)
+{
+	loop_->assertInLoopThread();
+	assert(seconds >= 0.0);
+	slackMicroSeconds_ = static_cast<int64_t>(seconds * Timestamp::kMicorSecondsPerSecond);
+}
+
+/**
+ * 最早的 timer 发生了变化，需要重新设置 timerfd
+*/
+void TimerQueue::requestRearm()
+{
+	++rearmRequests_;
+	if (deferRearm_)
+	{
+		rearmPending_ = true;
+	}
+	else
+	{
+		rearm();
+	}
+}
+
+/**
+ * 在 EventLoop::loop() 调用 poll 之前调用，一次循环之内的多次 requestRearm() 合并为一次
+*/
+void TimerQueue::rearmIfPending()
+{
+	if (rearmPending_)
+	{
+		rearmPending_ = false;
+		rearm();
+	}
+}
+
+void TimerQueue::rearm()
+{
+	loop_->assertInLoopThread();
+	Timestamp earliest = earliestExpiration();
+	if (!earliest.valid())
+	{
+		return;
+	}
+
+	Timestamp latest(earliest.microSecondsSinceEpoch() + slackMicroSeconds_);
+	/**
+	 * timerfd 已经设置的触发时间不晚于 earliest + slack，最早的 timer 会在允许的时间窗口之内被触发
+	 * 不需要再调用 timerfd_settime()
+	 * 已经设置的时间比 earliest 还要早（最早的 timer 被取消了）只会导致一次空的 handleRead()，
+	 * 这和原来的行为是一样的
+	*/
+	if (armed_.valid() && !(latest < armed_))
+	{
+		return;
+	}
+
+	armed_ = latest;
+	++rearmSyscalls_;
+	resetTimerfd(timerfd_, latest);
 }
 
 
 bool TimerQueue::insert(Timer* timer)
 {
 	loop_->assertInLoopThread();
+	if (option_ == EventLoop::kTimerHeap)
+	{
+		return heapInsert(timer);
+	}
 	assert(timers_.size() == activeTimers_.size());	/*这两个集合要保持相同的大小*/
 	bool earliestChanged = false;
 	Timestamp when = timer->expiration();
@@ -331,4 +495,98 @@ bool TimerQueue::insert(Timer* timer)
 
 	assert(timers_.size() == activeTimers_.size());
 	return earliestChanged;
-} 
\ No newline at end of file
+}
+
+/**
+ * 4 叉堆：下标为 i 的节点，父节点是 (i-1)/4，子节点是 4i+1 ... 4i+4
+ * 相比二叉堆，层数减半，sift down 时同一层的子节点在同一个 cache line 当中
+*/
+bool TimerQueue::heapInsert(Timer* timer)
+{
+	assert(timer->index() < 0);
+	heap_.push_back(timer);
+	timer->set_index(static_cast<int>(heap_.size() - 1));
+	heapSiftUp(heap_.size() - 1);
+	LOG_TRACE << "TimerQueue::heapInsert - timer : " << timer->sequence() << " index : " << timer->index();
+	return timer->index() == 0;
+}
+
+void TimerQueue::heapRemove(Timer* timer)
+{
+	size_t index = static_cast<size_t>(timer->index());
+	assert(index < heap_.size() && heap_[index] == timer);
+	Timer* last = heap_.back();
+	heap_.pop_back();
+	timer->set_index(-1);
+	if (last != timer)
+	{
+		/**
+		 * 用最后一个节点填补空位，它可能需要上浮，也可能需要下沉
+		*/
+		heapPlace(last, index);
+		heapSiftUp(index);
+		heapSiftDown(static_cast<size_t>(last->index()));
+	}
+}
+
+void TimerQueue::heapSiftUp(size_t index)
+{
+	Timer* timer = heap_[index];
+	while (index > 0)
+	{
+		size_t parent = (index - 1) / kHeapArity;
+		if (!timerLess(timer, heap_[parent]))
+		{
+			break;
+		}
+		heapPlace(heap_[parent], index);
+		index = parent;
+	}
+	heapPlace(timer, index);
+}
+
+void TimerQueue::heapSiftDown(size_t index)
+{
+	Timer* timer = heap_[index];
+	const size_t n = heap_.size();
+	while (true)
+	{
+		size_t first = index * kHeapArity + 1;
+		if (first >= n)
+		{
+			break;
+		}
+		size_t last = std::min(first + kHeapArity, n);
+		size_t smallest = first;
+		for (size_t child = first + 1; child < last; ++child)
+		{
+			if (timerLess(heap_[child], heap_[smallest]))
+			{
+				smallest = child;
+			}
+		}
+		if (!timerLess(heap_[smallest], timer))
+		{
+			break;
+		}
+		heapPlace(heap_[smallest], index);
+		index = smallest;
+	}
+	heapPlace(timer, index);
+}
+
+void TimerQueue::heapPlace(Timer* timer, size_t index)
+{
+	heap_[index] = timer;
+	timer->set_index(static_cast<int>(index));
+}
+
+/**
+ * 堆模式下用完的 timer 不释放，释放回调中持有的资源之后放入 freeTimers_
+*/
+void TimerQueue::recycle(Timer* timer)
+{
+	assert(timer->index() < 0);
+	timer->releaseCallback();
+	freeTimers_.push_back(timer);
+}
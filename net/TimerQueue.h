@@ -8,6 +8,7 @@
 #include "base/Timestamp.h"
 #include "net/Channel.h"
 #include "net/Callbacks.h"
+#include "net/EventLoop.h"
 
 
 namespace muduo
@@ -35,6 +36,30 @@ public:
                    double interval);
 
   	void cancel(TimerId timerId);
+
+	/// 必须在 loop 线程中，在添加任何 timer 之前调用
+	void setOption(EventLoop::TimerQueueOption option);
+
+	size_t size() const
+	{ return option_ == EventLoop::kTimerHeap ? heap_.size() : timers_.size(); }
+
+	/**
+	 * 合并 timerfd_settime() 调用，下面的函数都只能在 loop 线程中调用
+	 * deferred : 最早的 timer 发生变化的时候不立刻重新设置 timerfd，
+	 * 		而是在 EventLoop 每一次 poll 之前调用 rearmIfPending() 统一设置一次
+	 * slack : timer 允许推迟触发的时间（秒），timerfd 被设置为 最早的超时时间 + slack，
+	 * 		这个时间窗口之内超时的 timer 在同一次 handleRead() 当中批量触发，
+	 * 		新加入的 timer 只要在已经设置的触发时间之前 slack 秒之内，就不需要重新设置 timerfd
+	*/
+	void setRearmDeferred(bool on) { deferRearm_ = on; }
+	void setSlack(double seconds);
+	void rearmIfPending();
+
+	/// 最早的 timer 发生变化的次数，即不做任何合并的时候 timerfd_settime() 的调用次数
+	int64_t rearmRequests() const { return rearmRequests_; }
+	/// 实际的 timerfd_settime() 的调用次数
+	int64_t rearmSyscalls() const { return rearmSyscalls_; }
+	int64_t rearmSaved() const { return rearmRequests_ - rearmSyscalls_; }
 private:
 	typedef std::pair<Timestamp, Timer*> Entry;
 	typedef std::set<Entry> TimerList;
@@ -51,6 +76,18 @@ private:
 
   	bool insert(Timer* timer);
 
+	Timestamp earliestExpiration() const;
+	void requestRearm();
+	void rearm();
+
+	// kTimerHeap
+	bool heapInsert(Timer* timer);
+	void heapRemove(Timer* timer);
+	void heapSiftUp(size_t index);
+	void heapSiftDown(size_t index);
+	void heapPlace(Timer* timer, size_t index);
+	void recycle(Timer* timer);
+
   	EventLoop* loop_;
   	const int timerfd_;
   	Channel timerfdChannel_;
@@ -63,7 +100,23 @@ private:
 	 * activeTimers_ 和 timers_ 应当保持一致， activeTimers_ 是用来根据 Timer* 进行快速查找使用的
 	*/
   	bool callingExpiredTimers_; /* atomic */
-  	ActiveTimerSet cancelingTimers_;	
+  	ActiveTimerSet cancelingTimers_;
+
+	EventLoop::TimerQueueOption option_;
+	/**
+	 * kTimerHeap : 按照 (expiration, sequence) 排序的 4 叉最小堆
+	 * 堆模式下 Timer 对象从不释放，用完之后放入 freeTimers_ 回收，
+	 * 所以 cancel() 可以直接访问 TimerId 中的指针，再用 sequence 判断 timer 是否还有效
+	*/
+	std::vector<Timer*> heap_;
+	std::vector<Timer*> freeTimers_;
+
+	bool deferRearm_;
+	bool rearmPending_;
+	int64_t slackMicroSeconds_;
+	Timestamp armed_;	/*timerfd 当前设置的触发时间，已经触发或者没有设置的时候为 invalid*/
+	int64_t rearmRequests_;
+	int64_t rearmSyscalls_;
 };
 } // namespace net
 
@@ -7,6 +7,11 @@ using namespace muduo;
 using namespace muduo::net;
 
 void HttpResponse::appendToBuffer(Buffer* output) const {
+    appendHeadersToBuffer(output);
+    output->append(body_);
+}
+
+void HttpResponse::appendHeadersToBuffer(Buffer* output) const {
     char buf[32];
     snprintf(buf, sizeof buf, "HTTP/1.1 %d ", statusCode_);
     output->append(buf);
@@ -33,5 +38,4 @@ void HttpResponse::appendToBuffer(Buffer* output) const {
     }
 
     output->append("\r\n");
-    output->append(body_);
 }
\ No newline at end of file
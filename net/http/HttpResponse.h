@@ -58,6 +58,19 @@ public:
     void setBody(const string& body)
     { body_ = body; }
 
+    const string& body() const
+    { return body_; }
+
+    /**取走 body，之后 body() 为空，参考 HttpServer::onRequest()*/
+    string releaseBody()
+    {
+        string body;
+        body.swap(body_);
+        return body;
+    }
+
+    /**状态行和头部，不包括 body，body 可以单独发送而不需要拷贝到同一个 Buffer 中*/
+    void appendHeadersToBuffer(Buffer* output) const;
     void appendToBuffer(Buffer* output) const;
 };
 
@@ -82,9 +82,17 @@ void HttpServer::onRequest(const TcpConnectionPtr& conn, const HttpRequest& req)
         (req.getVersion() == HttpRequest::KHttp10 && connection != "Keep-Alive");
     HttpResponse response(close);
     httpCallback_(req, &response);
-    Buffer buf;
-    response.appendToBuffer(&buf);
-    conn->send(&buf);
+    /**
+     * 头部和 body 通过一次 writev() 发送，不需要拷贝到同一个 Buffer 中
+     * body 比较大的时候取得它的所有权，没有发送完的部分直接在输出缓冲区中引用
+    */
+    Buffer header;
+    response.appendHeadersToBuffer(&header);
+    Slice headerSlice(header.peek(), header.readableBytes());
+    if (response.body().size() < ChainBuffer::kMinExternalSlice)
+        conn->send({ headerSlice, Slice(response.body()) });
+    else
+        conn->send({ headerSlice, Slice(response.releaseBody()) });
     if (response.closeConnection())
     {
         conn->shutdown();
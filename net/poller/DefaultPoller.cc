@@ -1,17 +1,30 @@
 #include "net/Poller.h"
 #include "net/poller/PollPoller.h"
 #include "net/poller/EPollPoller.h"
+#include "net/poller/IoUringPoller.h"
+#include "base/Logging.h"
 
-
+#include <memory>
 
 #include <stdlib.h>
 
 using namespace muduo::net;
 
+/**
+ * MODUO_USE_POLL : poll(2)
+ * MUDUO_USE_IO_URING : io_uring，内核不支持的时候退回到 epoll
+ * 默认使用 epoll
+*/
 Poller* Poller::newDefaultPoller(EventLoop* loop)
 {
 	if (::getenv("MODUO_USE_POLL"))
 		return new PollPoller(loop);
-	else 
-		return new EPollPoller(loop);
-}
\ No newline at end of file
+	if (::getenv("MUDUO_USE_IO_URING"))
+	{
+		std::unique_ptr<IoUringPoller> poller(new IoUringPoller(loop));
+		if (poller->valid())
+			return poller.release();
+		LOG_WARN << "io_uring is not available, use epoll";
+	}
+	return new EPollPoller(loop);
+}
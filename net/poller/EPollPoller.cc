@@ -214,10 +214,13 @@ void EPollPoller::update(int operation, Channel* channel)
 	struct epoll_event event;
 	memZero(&event, sizeof event);
 	event.events = channel->events();
+	if (channel->isEdgeTriggered())
+		event.events |= EPOLLET | EPOLLRDHUP;
 	event.data.ptr = channel; /**指针项指向和这个事件绑定的 channel*/
 	int fd = channel->fd();
 	LOG_TRACE << "epoll_ctl op = " << EPollPoller::operationToString(operation)
     	<< " fd = " << fd << " event = { " << channel->eventsToString() << " }";
+	++controlCalls_;
 	if (::epoll_ctl(epollfd_, operation, fd, &event) < 0)
 	{
 		if (operation == EPOLL_CTL_DEL)
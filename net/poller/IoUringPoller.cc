@@ -0,0 +1,396 @@
+#include "net/poller/IoUringPoller.h"
+
+#include "net/Channel.h"
+#include "base/Logging.h"
+
+#include <linux/io_uring.h>
+
+#include <algorithm>
+
+#include <assert.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+const int kNew      = -1;
+const int kAdded    = 1;
+
+const unsigned kRingEntries = 1024;
+const unsigned kCqEntries = 16384;		/*所有的 Channel 同时返回也放得下*/
+const uint64_t kRemoveTag = ~static_cast<uint64_t>(0);	/*POLL_REMOVE 自己的 CQE，直接忽略*/
+
+/**
+ * multishot poll 是 5.13 加入的，和 IORING_FEAT_RSRC_TAGS 同一个版本，用它来判断
+ * 超时需要 IORING_FEAT_EXT_ARG (5.11)
+*/
+const unsigned kRequiredFeatures = IORING_FEAT_EXT_ARG | IORING_FEAT_RSRC_TAGS;
+
+inline uint64_t makeUserData(int fd, uint32_t generation)
+{
+	return (static_cast<uint64_t>(fd) << 32) | generation;
+}
+
+inline unsigned* ringAt(void* ring, unsigned offset)
+{
+	return reinterpret_cast<unsigned*>(static_cast<char*>(ring) + offset);
+}
+
+int ioUringSetup(unsigned entries, struct io_uring_params* params)
+{
+	return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+}
+
+IoUringPoller::IoUringPoller(EventLoop* loop)
+	: Poller(loop),
+	  ringfd_(-1),
+	  features_(0),
+	  sqRing_(MAP_FAILED),
+	  sqRingSize_(0),
+	  cqRing_(MAP_FAILED),
+	  cqRingSize_(0),
+	  sqes_(static_cast<io_uring_sqe*>(MAP_FAILED)),
+	  sqesSize_(0),
+	  sqHead_(NULL),
+	  sqTail_(NULL),
+	  sqMask_(0),
+	  sqEntries_(0),
+	  sqArray_(NULL),
+	  cqHead_(NULL),
+	  cqTail_(NULL),
+	  cqMask_(0),
+	  cqes_(NULL),
+	  sqLocalTail_(0),
+	  pollCount_(0),
+	  enterCalls_(0)
+{
+	if (!setupRing(kRingEntries))
+	{
+		LOG_SYSERR << "IoUringPoller::IoUringPoller";
+		if (ringfd_ >= 0)
+		{
+			::close(ringfd_);
+			ringfd_ = -1;
+		}
+	}
+}
+
+IoUringPoller::~IoUringPoller()
+{
+	if (sqes_ != MAP_FAILED)
+		::munmap(sqes_, sqesSize_);
+	if (cqRing_ != MAP_FAILED && cqRing_ != sqRing_)
+		::munmap(cqRing_, cqRingSize_);
+	if (sqRing_ != MAP_FAILED)
+		::munmap(sqRing_, sqRingSize_);
+	if (ringfd_ >= 0)
+		::close(ringfd_);
+}
+
+bool IoUringPoller::setupRing(unsigned entries)
+{
+	struct io_uring_params params;
+	memZero(&params, sizeof params);
+	/**
+	 * 只有 loop 线程提交，内核可以省掉锁和跨核的中断，老的内核不支持就去掉这两个标志
+	*/
+	params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP |
+				   IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_COOP_TASKRUN;
+	params.cq_entries = kCqEntries;
+	ringfd_ = ioUringSetup(entries, &params);
+	if (ringfd_ < 0 && errno == EINVAL)
+	{
+		memZero(&params, sizeof params);
+		params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP;
+		params.cq_entries = kCqEntries;
+		ringfd_ = ioUringSetup(entries, &params);
+	}
+	if (ringfd_ < 0)
+		return false;
+
+	features_ = params.features;
+	if ((features_ & kRequiredFeatures) != kRequiredFeatures)
+	{
+		errno = ENOSYS;
+		return false;
+	}
+
+	sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	if (features_ & IORING_FEAT_SINGLE_MMAP)
+		sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+
+	sqRing_ = ::mmap(NULL, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+					 ringfd_, IORING_OFF_SQ_RING);
+	if (sqRing_ == MAP_FAILED)
+		return false;
+	if (features_ & IORING_FEAT_SINGLE_MMAP)
+	{
+		cqRing_ = sqRing_;
+	}
+	else
+	{
+		cqRing_ = ::mmap(NULL, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+						 ringfd_, IORING_OFF_CQ_RING);
+		if (cqRing_ == MAP_FAILED)
+			return false;
+	}
+	sqesSize_ = params.sq_entries * sizeof(struct io_uring_sqe);
+	sqes_ = static_cast<io_uring_sqe*>(::mmap(NULL, sqesSize_, PROT_READ | PROT_WRITE,
+											  MAP_SHARED | MAP_POPULATE, ringfd_, IORING_OFF_SQES));
+	if (sqes_ == MAP_FAILED)
+		return false;
+
+	sqHead_ = ringAt(sqRing_, params.sq_off.head);
+	sqTail_ = ringAt(sqRing_, params.sq_off.tail);
+	sqMask_ = *ringAt(sqRing_, params.sq_off.ring_mask);
+	sqEntries_ = params.sq_entries;
+	sqArray_ = ringAt(sqRing_, params.sq_off.array);
+	cqHead_ = ringAt(cqRing_, params.cq_off.head);
+	cqTail_ = ringAt(cqRing_, params.cq_off.tail);
+	cqMask_ = *ringAt(cqRing_, params.cq_off.ring_mask);
+	cqes_ = reinterpret_cast<io_uring_cqe*>(static_cast<char*>(cqRing_) + params.cq_off.cqes);
+	sqLocalTail_ = *sqTail_;
+
+	LOG_DEBUG << "IoUringPoller sq " << params.sq_entries << " cq " << params.cq_entries
+			  << " features " << features_;
+	return true;
+}
+
+/**
+ * 提交队列满了的时候先把已经填好的交给内核，不等待完成
+*/
+io_uring_sqe* IoUringPoller::getSqe()
+{
+	if (sqLocalTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_)
+		enter(0, 0);
+
+	unsigned index = sqLocalTail_ & sqMask_;
+	sqArray_[index] = index;
+	io_uring_sqe* sqe = &sqes_[index];
+	memZero(sqe, sizeof *sqe);
+	++sqLocalTail_;
+	return sqe;
+}
+
+/**
+ * 提交所有填好的 SQE，minComplete > 0 的时候同时等待完成，最多等 timeoutMs 毫秒 (< 0 表示一直等)
+*/
+int IoUringPoller::enter(unsigned minComplete, int timeoutMs)
+{
+	__atomic_store_n(sqTail_, sqLocalTail_, __ATOMIC_RELEASE);
+	unsigned toSubmit = sqLocalTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+
+	struct __kernel_timespec ts;
+	struct io_uring_getevents_arg arg;
+	memZero(&arg, sizeof arg);
+	unsigned flags = IORING_ENTER_EXT_ARG;
+	if (minComplete > 0)
+	{
+		flags |= IORING_ENTER_GETEVENTS;
+		if (timeoutMs >= 0)
+		{
+			ts.tv_sec = timeoutMs / 1000;
+			ts.tv_nsec = static_cast<long long>(timeoutMs % 1000) * 1000 * 1000;
+			arg.ts = reinterpret_cast<uint64_t>(&ts);
+		}
+	}
+	++enterCalls_;
+	return static_cast<int>(::syscall(__NR_io_uring_enter, ringfd_, toSubmit, minComplete,
+									  flags, &arg, sizeof arg));
+}
+
+Timestamp IoUringPoller::poll(int timeoutMs, ChannelList* activeChannels)
+{
+	LOG_TRACE << "fd total count " << channels_.size();
+	++pollCount_;
+	rearmFired();
+	int ret = enter(1, timeoutMs);
+	int savedErrno = errno;
+	Timestamp now(Timestamp::now());
+
+	size_t before = activeChannels->size();
+	fillActiveChannels(activeChannels);
+	if (activeChannels->size() > before)
+	{
+		LOG_TRACE << activeChannels->size() - before << " events happened";
+	}
+	else if (ret >= 0 || savedErrno == ETIME || savedErrno == EINTR)
+	{
+		LOG_TRACE << "nothing happened";
+	}
+	else if (savedErrno != EBUSY)	/*EBUSY : 完成队列溢出，上面已经处理了一部分*/
+	{
+		errno = savedErrno;
+		LOG_SYSERR << "IoUringPoller::poll()";
+	}
+	return now;
+}
+
+void IoUringPoller::fillActiveChannels(ChannelList* activeChannels)
+{
+	unsigned head = *cqHead_;
+	unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+	for (; head != tail; ++head)
+	{
+		const io_uring_cqe* cqe = &cqes_[head & cqMask_];
+		uint64_t userData = cqe->user_data;
+		if (userData == kRemoveTag)
+			continue;
+
+		int fd = static_cast<int>(userData >> 32);
+		Entry* entry = entryOf(fd);
+		if (entry->channel == NULL || entry->generation != static_cast<uint32_t>(userData))
+			continue;	/*已经被修改或者删除的请求*/
+
+		if (!(cqe->flags & IORING_CQE_F_MORE))
+		{
+			/*单次的请求，或者内核终止了 multishot 请求，下一次 poll() 之前重新提交*/
+			entry->armed = false;
+			fired_.push_back(fd);
+		}
+		if (cqe->res == -ECANCELED)
+			continue;
+
+		int revents = cqe->res;
+		if (revents < 0)
+		{
+			errno = -revents;
+			LOG_SYSERR << "IoUringPoller poll fd = " << fd;
+			revents = POLLERR;
+		}
+
+		Channel* channel = entry->channel;
+		if (entry->lastPoll == pollCount_)
+		{
+			/*multishot 请求在同一次 poll() 中返回了多次*/
+			channel->set_revents(channel->revents() | revents);
+		}
+		else
+		{
+			entry->lastPoll = pollCount_;
+			channel->set_revents(revents);
+			activeChannels->push_back(channel);
+		}
+	}
+	__atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+}
+
+void IoUringPoller::rearmFired()
+{
+	for (int fd : fired_)
+	{
+		Entry* entry = entryOf(fd);
+		if (entry->channel && !entry->armed && !entry->channel->isNoneEvent())
+			armChannel(entry->channel, entry);
+	}
+	fired_.clear();
+}
+
+void IoUringPoller::armChannel(Channel* channel, Entry* entry)
+{
+	uint32_t events = channel->events();
+	bool multishot = channel->isEdgeTriggered();
+	if (multishot)
+		events |= POLLRDHUP;
+
+	++entry->generation;
+	entry->armed = true;
+	entry->events = events;
+
+	io_uring_sqe* sqe = getSqe();
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = channel->fd();
+	sqe->poll32_events = events;
+	sqe->len = multishot ? IORING_POLL_ADD_MULTI : 0;
+	sqe->user_data = makeUserData(channel->fd(), entry->generation);
+}
+
+void IoUringPoller::disarm(int fd, Entry* entry)
+{
+	if (entry->armed)
+	{
+		io_uring_sqe* sqe = getSqe();
+		sqe->opcode = IORING_OP_POLL_REMOVE;
+		sqe->fd = -1;
+		sqe->addr = makeUserData(fd, entry->generation);
+		sqe->user_data = kRemoveTag;
+		entry->armed = false;
+		++controlCalls_;
+	}
+	++entry->generation;
+	entry->events = 0;
+}
+
+IoUringPoller::Entry* IoUringPoller::entryOf(int fd)
+{
+	assert(fd >= 0);
+	if (static_cast<size_t>(fd) >= entries_.size())
+		entries_.resize(fd + 1);
+	return &entries_[fd];
+}
+
+/**
+ * 和 EPollPoller 一样维护 channels_，实际的修改在下一次 poll() 的时候一起提交
+*/
+void IoUringPoller::updateChannel(Channel* channel)
+{
+	Poller::assertInLoopThread();
+	const int fd = channel->fd();
+	const int index = channel->index();
+	LOG_TRACE << "fd = " << fd << " events = " << channel->events() << " index = " << index;
+	Entry* entry = entryOf(fd);
+	if (index == kNew)
+	{
+		assert(channels_.find(fd) == channels_.end());
+		channels_[fd] = channel;
+		channel->set_index(kAdded);
+		entry->channel = channel;
+	}
+	else
+	{
+		assert(channels_.find(fd) != channels_.end());
+		assert(channels_[fd] == channel);
+		assert(entry->channel == channel);
+	}
+
+	if (channel->isNoneEvent())
+	{
+		disarm(fd, entry);
+		return;
+	}
+	uint32_t events = channel->events() | (channel->isEdgeTriggered() ? POLLRDHUP : 0);
+	if (entry->armed && entry->events == events)
+		return;
+	disarm(fd, entry);
+	armChannel(channel, entry);
+	++controlCalls_;
+}
+
+void IoUringPoller::removeChannel(Channel* channel)
+{
+	Poller::assertInLoopThread();
+	const int fd = channel->fd();
+	LOG_TRACE << "fd = " << fd;
+	assert(channels_.find(fd) != channels_.end());
+	assert(channels_[fd] == channel);
+	assert(channel->isNoneEvent());
+	assert(channel->index() == kAdded);
+	size_t n = channels_.erase(fd);
+	(void)n;
+	assert(n == 1);
+
+	Entry* entry = entryOf(fd);
+	disarm(fd, entry);
+	entry->channel = NULL;
+	channel->set_index(kNew);
+}
@@ -0,0 +1,105 @@
+#ifndef MUDUO_NET_POLLER_IOURINGPOLLER_H
+#define MUDUO_NET_POLLER_IOURINGPOLLER_H
+
+#include "net/Poller.h"
+
+#include <stdint.h>
+#include <vector>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace muduo
+{
+namespace net
+{
+
+/**
+ * 基于 io_uring 的 IORING_OP_POLL_ADD 实现的 Poller，设置环境变量 MUDUO_USE_IO_URING 之后使用
+ * 没有依赖 liburing，直接使用 io_uring_setup / io_uring_enter 两个系统调用
+ *
+ * 水平触发的 Channel 使用单次的 poll，每一次返回之后在下一次 poll() 的时候重新提交，提交的时候内核会立刻检查
+ * 当前的状态，所以和 epoll 的水平触发一样，没有处理完的事件下一次还会报告
+ * 边沿触发的 Channel 使用 multishot poll，每一次有新的事件都会产生一个 CQE，不需要重新提交
+ *
+ * 关注事件的修改 (POLL_ADD / POLL_REMOVE) 先放在提交队列中，和等待事件一起在一次 io_uring_enter() 中完成
+ * epoll 每一次修改都需要单独的一次 epoll_ctl()
+*/
+class IoUringPoller : public Poller
+{
+public:
+	IoUringPoller(EventLoop* loop);
+	~IoUringPoller() override;
+
+	/**内核不支持 io_uring 的时候返回 false，参考 Poller::newDefaultPoller()*/
+	bool valid() const { return ringfd_ >= 0; }
+
+	Timestamp poll(int timeoutMs, ChannelList* activeChannels) override;
+	void updateChannel(Channel* channel) override;
+	void removeChannel(Channel* channel) override;
+	bool supportsEdgeTriggered() const override { return true; }
+
+	/**io_uring_enter() 的调用次数，每一次 poll() 一般只有一次*/
+	int64_t enterCalls() const { return enterCalls_; }
+
+private:
+	/**
+	 * 每一个 fd 当前的 poll 请求，user_data 由 fd 和 generation 组成
+	 * 修改或者删除之后 generation 加一，之前的请求产生的 CQE 因为 generation 对不上而被忽略
+	*/
+	struct Entry
+	{
+		Entry() : channel(NULL), generation(0), armed(false), events(0), lastPoll(-1) {}
+
+		Channel*	channel;
+		uint32_t	generation;
+		bool		armed;		/*内核中有这个 generation 的 poll 请求*/
+		uint32_t	events;		/*请求中的事件，包括边沿触发的标志*/
+		int64_t		lastPoll;	/*最近一次出现在 activeChannels 中的 poll() 的序号*/
+	};
+
+	bool setupRing(unsigned entries);
+	io_uring_sqe* getSqe();
+	int enter(unsigned minComplete, int timeoutMs);
+	void armChannel(Channel* channel, Entry* entry);
+	void disarm(int fd, Entry* entry);
+	void rearmFired();
+	void fillActiveChannels(ChannelList* activeChannels);
+	Entry* entryOf(int fd);
+
+	int ringfd_;
+	unsigned features_;
+
+	/*mmap 出来的三块内存*/
+	void* sqRing_;
+	size_t sqRingSize_;
+	void* cqRing_;
+	size_t cqRingSize_;
+	io_uring_sqe* sqes_;
+	size_t sqesSize_;
+
+	/*指向 ring 中的共享变量*/
+	unsigned* sqHead_;
+	unsigned* sqTail_;
+	unsigned sqMask_;
+	unsigned sqEntries_;
+	unsigned* sqArray_;
+	unsigned* cqHead_;
+	unsigned* cqTail_;
+	unsigned cqMask_;
+	io_uring_cqe* cqes_;
+
+	unsigned sqLocalTail_;		/*已经填好的 SQE 的位置，enter() 的时候交给内核*/
+
+	std::vector<Entry> entries_;	/*以 fd 为下标*/
+	std::vector<int> fired_;		/*上一次 poll() 返回的单次请求，下一次 poll() 之前重新提交*/
+	int64_t pollCount_;
+	int64_t enterCalls_;
+};
+
+} // namespace net
+
+} // namespace muduo
+
+
+#endif
@@ -0,0 +1,155 @@
+#include "base/CountDownLatch.h"
+#include "base/Logging.h"
+#include "base/Timestamp.h"
+#include "net/EventLoop.h"
+#include "net/EventLoopThread.h"
+#include "net/TcpServer.h"
+
+#include <memory>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/**
+ * 重连风暴：客户端每一轮同时发起 burst 个非阻塞的 connect()，服务端的一次可读事件 accept 多少个连接
+ * 服务端给每一个连接发送 "ok" 之后 holdMs 毫秒再关闭，客户端收到 "ok" 的是接受的，直接读到 EOF 的是被拒绝的
+ * 打印每秒完成的连接数和 TcpServer::acceptStats()
+ *
+ * usage: AcceptStorm_test [maxAcceptsPerEvent] [maxConnections] [burst] [rounds] [holdMs]
+*/
+
+using namespace muduo;
+using namespace muduo::net;
+
+const uint16_t kPort = 2032;
+
+void onConnection(const TcpConnectionPtr& conn, double holdSeconds)
+{
+	if (conn->connected())
+	{
+		conn->send("ok");
+		if (holdSeconds > 0)
+			conn->getLoop()->runAfter(holdSeconds, std::bind(&TcpConnection::shutdown, conn));
+		else
+			conn->shutdown();
+	}
+}
+
+/*一轮同时发起 burst 个连接，等待全部读到 EOF，返回被接受的个数*/
+int runBurst(int burst)
+{
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof addr);
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(kPort);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	std::vector<struct pollfd> fds(burst);
+	std::vector<bool> admitted(burst, false);
+	for (int i = 0; i < burst; ++i)
+	{
+		int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+		int ret = ::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof addr);
+		if (ret < 0 && errno != EINPROGRESS)
+			perror("connect");
+		fds[i].fd = fd;
+		fds[i].events = POLLIN;
+	}
+
+	int open = burst;
+	while (open > 0)
+	{
+		if (::poll(fds.data(), fds.size(), 5000) <= 0)
+		{
+			fprintf(stderr, "%d connections timed out\n", open);
+			break;
+		}
+		for (auto& pfd : fds)
+		{
+			if (pfd.fd < 0 || pfd.revents == 0)
+				continue;
+			char buf[16];
+			ssize_t n = ::read(pfd.fd, buf, sizeof buf);
+			if (n > 0)
+			{
+				admitted[&pfd - fds.data()] = true;
+				continue;
+			}
+			if (n < 0 && errno == EAGAIN)
+				continue;
+			::close(pfd.fd);
+			pfd.fd = -1;
+			--open;
+		}
+	}
+	int accepted = 0;
+	for (int i = 0; i < burst; ++i)
+	{
+		if (fds[i].fd >= 0)
+			::close(fds[i].fd);
+		if (admitted[i])
+			++accepted;
+	}
+	return accepted;
+}
+
+int main(int argc, char* argv[])
+{
+	int maxAccepts = argc > 1 ? atoi(argv[1]) : 1;
+	int maxConnections = argc > 2 ? atoi(argv[2]) : 0;
+	int burst = argc > 3 ? atoi(argv[3]) : 500;
+	int rounds = argc > 4 ? atoi(argv[4]) : 40;
+	double holdSeconds = (argc > 5 ? atoi(argv[5]) : 0) / 1000.0;
+	Logger::setLogLevel(Logger::WARN);
+
+	EventLoopThread serverThread;
+	EventLoop* serverLoop = serverThread.startLoop();
+	std::unique_ptr<TcpServer> server;
+	CountDownLatch started(1);
+	serverLoop->runInLoop([&] {
+		server.reset(new TcpServer(serverLoop, InetAddress(kPort, true), "StormServer"));
+		server->setConnectionCallback(std::bind(onConnection, _1, holdSeconds));
+		server->setAcceptBatch(maxAccepts, 0.001);
+		server->setMaxConnections(maxConnections);
+		server->start();
+		started.countDown();
+	});
+	started.wait();
+
+	int64_t admitted = 0;
+	Timestamp begin = Timestamp::now();
+	for (int i = 0; i < rounds; ++i)
+	{
+		admitted += runBurst(burst);
+	}
+	double seconds = timeDifference(Timestamp::now(), begin);
+
+	TcpServer::AcceptStats stats = server->acceptStats();
+	printf("maxAccepts %3d maxConnections %4d: %8.0f connections/s  admitted %ld  "
+		   "events %ld  accepted %ld (%.1f per event)  rejected %ld  errors %ld\n",
+			maxAccepts, maxConnections,
+			static_cast<double>(burst) * rounds / seconds,
+			static_cast<long>(admitted),
+			static_cast<long>(stats.events),
+			static_cast<long>(stats.accepted),
+			stats.events > 0 ? static_cast<double>(stats.accepted) / stats.events : 0.0,
+			static_cast<long>(stats.rejected),
+			static_cast<long>(stats.errors));
+	fflush(stdout);
+
+	CountDownLatch stopped(1);
+	serverLoop->runInLoop([&] {
+		server.reset();
+		stopped.countDown();
+	});
+	stopped.wait();
+}
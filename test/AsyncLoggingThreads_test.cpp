@@ -0,0 +1,96 @@
+#include "base/AsyncLogging.h"
+#include "base/Logging.h"
+#include "base/Thread.h"
+#include "base/Timestamp.h"
+
+#include <memory>
+#include <vector>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * 比较 AsyncLogging 两种前端在多线程同时写日志时的吞吐量
+ * kGlobalBuffer : 所有线程竞争同一个 mutex_
+ * kPerThreadBuffer : 每一个线程写自己的缓冲区，通过无锁队列交给后端
+ * 后端来不及写而丢弃了日志的时候，吞吐量没有意义，打印丢弃的缓冲区个数，最后返回 1
+ *
+ * usage: AsyncLoggingThreads_test [linesPerThread]
+*/
+
+using namespace muduo;
+
+off_t kRollSize = 500*1000*1000;
+
+muduo::AsyncLogging* g_asyncLog = NULL;
+
+void asyncOutput(const char* msg, int len)
+{
+	g_asyncLog->append(msg, len);
+}
+
+void logInThread(int lines)
+{
+	for (int i = 0; i < lines; ++i)
+	{
+		LOG_INFO << "Hello 0123456789" << " abcdefghijklmnopqrstuvwxyz " << i;
+	}
+}
+
+/*返回丢弃的缓冲区个数*/
+int64_t bench(const char* basename, AsyncLogging::Option option, int numThreads, int linesPerThread)
+{
+	muduo::AsyncLogging log(basename, kRollSize, 3, option);
+	log.start();
+	g_asyncLog = &log;
+
+	std::vector<std::unique_ptr<muduo::Thread> > threads;
+	for (int i = 0; i < numThreads; ++i)
+	{
+		threads.emplace_back(new muduo::Thread(std::bind(logInThread, linesPerThread)));
+	}
+
+	Timestamp start(Timestamp::now());
+	for (auto& thr : threads)
+	{
+		thr->start();
+	}
+	for (auto& thr : threads)
+	{
+		thr->join();
+	}
+	double seconds = timeDifference(Timestamp::now(), start);
+	log.stop();
+
+	int64_t total = static_cast<int64_t>(numThreads) * linesPerThread;
+	int64_t dropped = log.droppedBuffers();
+	printf("%-16s %2d threads: %ld lines in %.3f s, %.0f lines/s",
+			option == AsyncLogging::kGlobalBuffer ? "kGlobalBuffer" : "kPerThreadBuffer",
+			numThreads, total, seconds, static_cast<double>(total) / seconds);
+	if (dropped > 0)
+		printf("  DROPPED %ld buffers, lines/s not comparable", static_cast<long>(dropped));
+	printf("\n");
+	fflush(stdout);
+	return dropped;
+}
+
+int main(int argc, char* argv[])
+{
+	int linesPerThread = argc > 1 ? atoi(argv[1]) : 200*1000;
+
+	Logger::setLogLevel(Logger::INFO);
+	Logger::setOutput(asyncOutput);
+
+	char name[256] = { '\0' };
+	strncpy(name, argv[0], sizeof name - 1);
+
+	const int kThreads[] = { 1, 4, 16 };
+	int64_t dropped = 0;
+	for (int numThreads : kThreads)
+	{
+		dropped += bench(::basename(name), AsyncLogging::kGlobalBuffer, numThreads, linesPerThread);
+		dropped += bench(::basename(name), AsyncLogging::kPerThreadBuffer, numThreads, linesPerThread);
+	}
+	return dropped > 0 ? 1 : 0;
+}
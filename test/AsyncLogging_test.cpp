@@ -0,0 +1,146 @@
+#include "base/AsyncLogging.h"
+#include "base/Logging.h"
+#include "base/Thread.h"
+#include "base/Timestamp.h"
+#include "net/EventLoop.h"
+#include "net/TcpClient.h"
+#include "net/TcpServer.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * AsyncLogging 的 benchmark
+ * 主线程不停的写 LOG_INFO, 统计每秒的日志行数和每一次写日志的延时 (p50/p99/max)
+ * 同时可以在另一个线程中启动一个 TcpServer + TcpClient 进行 ping-pong 作为背景负载
+ *
+ * usage: AsyncLogging_test [load(0/1)] [lines]
+*/
+
+using namespace muduo;
+using namespace muduo::net;
+
+off_t kRollSize = 500*1000*1000;
+
+muduo::AsyncLogging* g_asyncLog = NULL;
+EventLoop* g_loadLoop = NULL;
+TcpClient* g_loadClient = NULL;
+
+void asyncOutput(const char* msg, int len)
+{
+	g_asyncLog->append(msg, len);
+}
+
+int64_t nowNanos()
+{
+	struct timespec ts;
+	::clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * 背景负载：同一个 loop 里面的 echo server 和一个不停发送 16KB 数据的 client
+*/
+void onServerMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+	conn->send(buf);
+}
+
+void onClientConnection(const TcpConnectionPtr& conn)
+{
+	if (conn->connected())
+	{
+		conn->setTcpNoDelay(true);
+		conn->send(string(16*1024, 'x'));
+	}
+}
+
+void loadThreadFunc()
+{
+	EventLoop loop;
+	InetAddress listenAddr(2022, true);
+	TcpServer server(&loop, listenAddr, "LoadServer");
+	server.setMessageCallback(onServerMessage);
+	server.start();
+
+	TcpClient client(&loop, InetAddress("127.0.0.1", 2022), "LoadClient");
+	client.setConnectionCallback(onClientConnection);
+	client.setMessageCallback(onServerMessage);
+	client.connect();
+
+	g_loadClient = &client;
+	g_loadLoop = &loop;
+	loop.loop();
+}
+
+void bench(int lines)
+{
+	std::vector<int64_t> latencies;
+	latencies.reserve(lines);
+
+	int64_t start = nowNanos();
+	for (int i = 0; i < lines; ++i)
+	{
+		int64_t t0 = nowNanos();
+		LOG_INFO << "Hello 0123456789" << " abcdefghijklmnopqrstuvwxyz " << i;
+		latencies.push_back(nowNanos() - t0);
+	}
+	int64_t elapsed = nowNanos() - start;
+
+	std::sort(latencies.begin(), latencies.end());
+	printf("%d lines in %.3f s, %.0f lines/s, append latency p50 %ld ns p99 %ld ns max %ld ns\n",
+			lines,
+			static_cast<double>(elapsed) / 1e9,
+			static_cast<double>(lines) * 1e9 / static_cast<double>(elapsed),
+			latencies[lines / 2],
+			latencies[static_cast<size_t>(lines * 0.99)],
+			latencies.back());
+}
+
+int main(int argc, char* argv[])
+{
+	bool withLoad = argc > 1 && atoi(argv[1]) != 0;
+	int lines = argc > 2 ? atoi(argv[2]) : 1000*1000;
+
+	Logger::setLogLevel(Logger::INFO);
+
+	char name[256] = { '\0' };
+	strncpy(name, argv[0], sizeof name - 1);
+	muduo::AsyncLogging log(::basename(name), kRollSize);
+	log.start();
+	g_asyncLog = &log;
+	Logger::setOutput(asyncOutput);
+
+	muduo::Thread loadThread(loadThreadFunc, "LoadThread");
+	if (withLoad)
+	{
+		loadThread.start();
+		while (g_loadLoop == NULL)
+		{
+			::usleep(1000);
+		}
+		::sleep(1);
+	}
+
+	for (int i = 0; i < 3; ++i)
+	{
+		bench(lines);
+		::sleep(1);
+	}
+
+	if (withLoad)
+	{
+		/**
+		 * 先断开负载连接，等两端的 TcpConnection 都销毁之后再退出 loop
+		*/
+		g_loadLoop->runInLoop(std::bind(&TcpClient::disconnect, g_loadClient));
+		g_loadLoop->runAfter(1.0, std::bind(&EventLoop::quit, g_loadLoop));
+		loadThread.join();
+	}
+	log.stop();
+}
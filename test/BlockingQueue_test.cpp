@@ -0,0 +1,131 @@
+#include "base/BlockingQueue.h"
+#include "base/BoundedBlockingQueue.h"
+#include "base/Thread.h"
+#include "base/Timestamp.h"
+
+#include <memory>
+#include <vector>
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * 1. 功能：takeAll() / drainTo() 取出的顺序和个数
+ * 2. producers 个线程 put，一个消费者分别用 take()、drainTo(maxBatch) 和 takeAll() 取，对比每秒处理的元素个数
+ *
+ * usage: BlockingQueue_test [items] [producers] [maxBatch]
+*/
+
+using namespace muduo;
+
+void functionalTests()
+{
+	BlockingQueue<int> q;
+	for (int i = 0; i < 10; ++i)
+		q.put(i);
+	std::vector<int> out;
+	assert(q.drainTo(&out, 4) == 4);
+	assert(q.drainTo(&out, 100) == 6);
+	for (int i = 0; i < 10; ++i)
+		assert(out[i] == i);
+	q.put(10);
+	q.put(11);
+	std::vector<int> all(q.takeAll());
+	assert(all.size() == 2 && all[0] == 10 && q.size() == 0);
+
+	BoundedBlockingQueue<int> b(4);
+	for (int i = 0; i < 4; ++i)
+		b.put(i);
+	out.clear();
+	assert(b.drainTo(&out, 3) == 3 && out[2] == 2);
+	std::vector<int> rest(b.takeAll());
+	assert(rest.size() == 1 && rest[0] == 3 && b.empty());
+
+	printf("functional tests passed\n");
+	fflush(stdout);
+}
+
+enum Mode { kTake, kDrainTo, kTakeAll };
+
+/*消费者从一次取出的元素中看到 -1 之后退出*/
+template <typename Queue>
+void consume(Queue* queue, Mode mode, size_t maxBatch)
+{
+	std::vector<int> batch;
+	for (;;)
+	{
+		if (mode == kTake)
+		{
+			if (queue->take() < 0)
+				return;
+			continue;
+		}
+		batch.clear();
+		if (mode == kDrainTo)
+		{
+			queue->drainTo(&batch, maxBatch);
+		}
+		else
+		{
+			batch = queue->takeAll();
+		}
+		for (int x : batch)
+		{
+			if (x < 0)
+				return;
+		}
+	}
+}
+
+template <typename Queue>
+double itemsPerSecond(Queue* queue, Mode mode, int producers, int items, size_t maxBatch)
+{
+	int perProducer = items / producers;
+	std::vector<std::unique_ptr<Thread> > threads;
+	for (int p = 0; p < producers; ++p)
+	{
+		threads.emplace_back(new Thread([queue, perProducer] {
+			for (int i = 0; i < perProducer; ++i)
+				queue->put(i);
+		}));
+	}
+	Thread consumer(std::bind(consume<Queue>, queue, mode, maxBatch));
+
+	Timestamp start(Timestamp::now());
+	consumer.start();
+	for (auto& thr : threads)
+		thr->start();
+	for (auto& thr : threads)
+		thr->join();
+	queue->put(-1);
+	consumer.join();
+	return perProducer * producers / timeDifference(Timestamp::now(), start);
+}
+
+int main(int argc, char* argv[])
+{
+	int items = argc > 1 ? atoi(argv[1]) : 2000000;
+	int producers = argc > 2 ? atoi(argv[2]) : 8;
+	size_t maxBatch = argc > 3 ? atoi(argv[3]) : 256;
+
+	functionalTests();
+
+	printf("%d items, %d producers, 1 consumer, items/s:\n", items, producers);
+	printf("  %-28s %10s %10s %10s\n", "", "take", "drainTo", "takeAll");
+	{
+		BlockingQueue<int> a, b, c;
+		printf("  %-28s %10.0f %10.0f %10.0f\n", "BlockingQueue",
+				itemsPerSecond(&a, kTake, producers, items, maxBatch),
+				itemsPerSecond(&b, kDrainTo, producers, items, maxBatch),
+				itemsPerSecond(&c, kTakeAll, producers, items, maxBatch));
+	}
+	{
+		BoundedBlockingQueue<int> a(4096), b(4096), c(4096);
+		printf("  %-28s %10.0f %10.0f %10.0f\n", "BoundedBlockingQueue(4096)",
+				itemsPerSecond(&a, kTake, producers, items, maxBatch),
+				itemsPerSecond(&b, kDrainTo, producers, items, maxBatch),
+				itemsPerSecond(&c, kTakeAll, producers, items, maxBatch));
+	}
+	fflush(stdout);
+}
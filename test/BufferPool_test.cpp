@@ -0,0 +1,193 @@
+#include "base/CountDownLatch.h"
+#include "base/Logging.h"
+#include "base/Thread.h"
+#include "base/Timestamp.h"
+#include "net/Buffer.h"
+#include "net/BufferPool.h"
+#include "net/ChainBuffer.h"
+#include "net/EventLoop.h"
+#include "net/EventLoopThread.h"
+#include "net/EventLoopThreadPool.h"
+#include "net/TcpClient.h"
+#include "net/TcpServer.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <assert.h>
+#include <stdio.h>
+
+/**
+ * BufferPool 的测试和 benchmark
+ * short : 模拟大量短连接，每一个连接创建一个输入 Buffer 和一个输出 ChainBuffer，写入少量数据后销毁
+ *         比较 malloc 和 BufferPool 两种分配器
+ * remote : 在 loop 线程中申请，在另一个线程中释放，trim() 之后所有的内存都要还给系统
+ * idle : 持有大量的空闲连接的缓冲区，打印 bytesHeld / bytesInUse，释放一半之后 trim() 再打印一次
+ * server : TcpServer 有 2 个 io loop，连接的输入 Buffer 要来自各自 io loop 的 pool，acceptor 所在的 base loop 的 pool 不能有
+ *
+ * usage: BufferPool_test
+*/
+
+using namespace muduo;
+using namespace muduo::net;
+
+struct Connection
+{
+	explicit Connection(BufferAllocator* allocator)
+		: input(Buffer::kInitialSize, allocator),
+		  output(allocator)
+	{
+	}
+
+	Buffer input;
+	ChainBuffer output;
+};
+
+void printStats(const char* what, const BufferPool* pool)
+{
+	printf("  %-24s held %10zu bytes  in use %10zu bytes  slabs %6zu\n",
+			what, pool->bytesHeld(), pool->bytesInUse(), pool->slabCount());
+}
+
+void benchShort(const char* name, BufferAllocator* allocator, int n)
+{
+	const char message[] = "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n";
+	Timestamp start(Timestamp::now());
+	for (int i = 0; i < n; ++i)
+	{
+		Connection conn(allocator);
+		conn.input.append(message, sizeof message - 1);
+		conn.output.append(message, sizeof message - 1);
+		conn.input.retrieveAll();
+		conn.output.retrieveAll();
+	}
+	double seconds = timeDifference(Timestamp::now(), start);
+	printf("  short %-8s %8d connections %8.3f s %8.1f ns/connection\n",
+			name, n, seconds, seconds * 1e9 / n);
+}
+
+void testRemote(EventLoop* loop)
+{
+	BufferPool* pool = loop->bufferPool();
+	std::vector<std::unique_ptr<Buffer> > buffers;
+	for (int i = 0; i < 10000; ++i)
+	{
+		buffers.emplace_back(new Buffer(Buffer::kInitialSize, BufferAllocator::loopAllocator()));
+	}
+	printStats("remote before", pool);
+
+	Thread thread([&buffers] { buffers.clear(); }, "RemoteFree");
+	thread.start();
+	thread.join();
+	printStats("remote after free", pool);
+
+	pool->trim();
+	printStats("remote after trim", pool);
+	assert(pool->bytesInUse() == 0);
+	assert(pool->bytesHeld() == 0);
+}
+
+void testIdle(EventLoop* loop, int n)
+{
+	BufferPool* pool = loop->bufferPool();
+	std::vector<std::unique_ptr<Connection> > conns;
+	string burst(32 * 1024, 'x');
+	for (int i = 0; i < n; ++i)
+	{
+		conns.emplace_back(new Connection(BufferAllocator::loopAllocator()));
+		conns.back()->input.append(burst);
+		conns.back()->input.retrieveAll();
+	}
+	printStats("idle connections", pool);
+
+	conns.resize(n / 2);
+	printStats("idle half closed", pool);
+	pool->trim();
+	printStats("idle half closed, trim", pool);
+
+	conns.clear();
+	pool->trim();
+	printStats("idle all closed, trim", pool);
+	assert(pool->bytesHeld() == 0);
+}
+
+const uint16_t kPort = 2035;
+
+void testServer(EventLoop* loop, int n)
+{
+	TcpServer server(loop, InetAddress(kPort, true), "PoolServer");
+	server.setThreadNum(2);
+	std::atomic<int> connected(0);
+	server.setConnectionCallback([&connected](const TcpConnectionPtr& conn) {
+		if (conn->connected())
+			++connected;
+		else
+			--connected;
+	});
+	server.start();
+
+	/*客户端在另一个 loop 中，它们的 Buffer 不会算到 base loop 的 pool 上*/
+	EventLoopThread clientThread;
+	EventLoop* clientLoop = clientThread.startLoop();
+	std::vector<std::unique_ptr<TcpClient> > clients;
+	std::atomic<int> clientConnected(0);
+	clientLoop->runInLoop([&clients, &clientConnected, clientLoop, n] {
+		for (int i = 0; i < n; ++i)
+		{
+			clients.emplace_back(new TcpClient(clientLoop, InetAddress("127.0.0.1", kPort), "PoolClient"));
+			clients.back()->setConnectionCallback([&clientConnected](const TcpConnectionPtr& conn) {
+				if (conn->connected())
+					++clientConnected;
+				else
+					--clientConnected;
+			});
+			clients.back()->connect();
+		}
+	});
+
+	int target = n;
+	/*两端都看到全部连接建立或者全部断开*/
+	TimerId timer = loop->runEvery(0.01, [&connected, &clientConnected, &target, loop] {
+		if (connected == target && clientConnected == target)
+			loop->quit();
+	});
+	loop->loop();
+
+	std::vector<EventLoop*> ioLoops(server.threadPool()->getAllLoops());
+	printStats("server base loop", loop->bufferPool());
+	for (EventLoop* ioLoop : ioLoops)
+		printStats("server io loop", ioLoop->bufferPool());
+	assert(loop->bufferPool()->bytesInUse() == 0);
+	for (EventLoop* ioLoop : ioLoops)
+		assert(ioLoop->bufferPool()->bytesInUse() > 0);
+
+	clientLoop->runInLoop([&clients] {
+		for (auto& client : clients)
+			client->disconnect();
+	});
+	target = 0;
+	loop->loop();
+	loop->cancel(timer);
+	CountDownLatch cleared(1);
+	clientLoop->runInLoop([&clients, &cleared] {
+		clients.clear();
+		cleared.countDown();
+	});
+	cleared.wait();
+}
+
+int main()
+{
+	Logger::setLogLevel(Logger::WARN);
+	EventLoop loop;
+	const int kConnections = 1000 * 1000;
+
+	benchShort("malloc", BufferAllocator::defaultAllocator(), kConnections);
+	benchShort("pool", BufferAllocator::loopAllocator(), kConnections);
+	loop.bufferPool()->trim();
+
+	testRemote(&loop);
+	testIdle(&loop, 10000);
+	testServer(&loop, 200);
+}
@@ -0,0 +1,104 @@
+#include "base/Logging.h"
+#include "net/BufferPool.h"
+#include "net/EventLoop.h"
+#include "net/EventLoopThreadPool.h"
+#include "net/TcpClient.h"
+#include "net/TcpServer.h"
+
+#include <memory>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * 空闲连接缓冲区回收的测试
+ * N 个客户端各自发送 256 KB，服务端收到之后回复 256 KB，之后所有的连接都保持空闲
+ * 每 0.5 秒打印一次服务端 io loop 的 bufferCapacity() 和 BufferPool 的统计
+ * 打开回收之后，空闲 idle 秒之后容量应该降下来
+ *
+ * usage: BufferShrink_test [idleSeconds(0 表示不回收)] [connections]
+*/
+
+using namespace muduo;
+using namespace muduo::net;
+
+const size_t kBurst = 256 * 1024;
+std::vector<std::unique_ptr<TcpClient> > g_clients;
+
+void onServerConnection(const TcpConnectionPtr& conn)
+{
+	if (conn->connected())
+	{
+		conn->setContext(static_cast<size_t>(0));
+	}
+}
+
+/**
+ * 不读走数据，等整个 burst 都到达之后再一次性处理，让输入缓冲区涨到 256 KB
+*/
+void onServerMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+	if (buf->readableBytes() >= kBurst)
+	{
+		buf->retrieveAll();
+		conn->send(string(kBurst, 'y'));
+	}
+}
+
+void printStats(EventLoop* ioLoop, double elapsed)
+{
+	BufferPool* pool = ioLoop->bufferPool();
+	printf("%5.1f s  connection buffers %10ld bytes  pool held %10zu in use %10zu\n",
+			elapsed,
+			static_cast<long>(ioLoop->bufferCapacity()),
+			pool->bytesHeld(),
+			pool->bytesInUse());
+	fflush(stdout);
+}
+
+void disconnectAll()
+{
+	for (auto& client : g_clients)
+	{
+		client->disconnect();
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	double idleSeconds = argc > 1 ? atof(argv[1]) : 1.0;
+	int connections = argc > 2 ? atoi(argv[2]) : 200;
+	Logger::setLogLevel(Logger::WARN);
+
+	EventLoop loop;
+	InetAddress listenAddr(2023, true);
+	TcpServer server(&loop, listenAddr, "ShrinkServer");
+	server.setConnectionCallback(onServerConnection);
+	server.setMessageCallback(onServerMessage);
+	server.setBufferShrinkPolicy(idleSeconds);
+	server.setThreadNum(1);
+	server.setThreadInitCallback([](EventLoop* ioLoop) { ioLoop->setBufferPoolTrimInterval(1.0); });
+	server.start();
+	EventLoop* ioLoop = server.threadPool()->getAllLoops()[0];
+
+	string burst(kBurst, 'x');
+	for (int i = 0; i < connections; ++i)
+	{
+		g_clients.emplace_back(new TcpClient(&loop, InetAddress("127.0.0.1", 2023), "ShrinkClient"));
+		g_clients.back()->setConnectionCallback([burst](const TcpConnectionPtr& conn) {
+			if (conn->connected())
+				conn->send(burst);
+		});
+		g_clients.back()->connect();
+	}
+
+	for (int i = 1; i <= 10; ++i)
+	{
+		loop.runAfter(0.5 * i, std::bind(printStats, ioLoop, 0.5 * i));
+	}
+	loop.runAfter(5.5, disconnectAll);
+	loop.runAfter(6.5, std::bind(&EventLoop::quit, &loop));
+	loop.loop();
+	g_clients.clear();
+}
@@ -0,0 +1,194 @@
+#include "base/Logging.h"
+#include "base/Timestamp.h"
+#include "net/Buffer.h"
+#include "net/ChainBuffer.h"
+#include "net/EventLoop.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+
+#include <assert.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/**
+ * 比较 Buffer 和 ChainBuffer 在几种典型的使用方式下的性能，每一次写入 1KB / 64KB / 16MB
+ * steady : 写入一次，马上全部读走，缓冲区一直很小
+ * backlog : 写入一次，只读走一半，模拟对端很慢的时候输出缓冲区不停的积压，最后再全部读走
+ * drain : 先全部写入，再每次读走一个 chunk
+ *
+ * 开始之前先通过 socketpair 检查 ChainBuffer 的 prepend / writefd / readfd / appendSlice 是否正确
+ *
+ * usage: ChainBuffer_test
+*/
+
+using namespace muduo;
+using namespace muduo::net;
+
+const size_t kTotalBytes = 256 * 1024 * 1024;
+const size_t kBacklogBytes = 8 * 1024 * 1024;	/*Buffer 在 backlog 模式下每一次 append 都要搬移积压的数据，总量小一些*/
+
+void printResult(const char* type, const char* what, size_t chunk, size_t total,
+				 size_t capacity, Timestamp start)
+{
+	double seconds = timeDifference(Timestamp::now(), start);
+	printf("  %-11s %-8s chunk %8zu  %8.3f s %10.1f MiB/s  capacity %10zu\n",
+			type, what, chunk, seconds,
+			static_cast<double>(total) / seconds / 1024 / 1024,
+			capacity);
+}
+
+template<typename BUFFER>
+void benchSteady(const char* type, const std::string& chunk)
+{
+	BUFFER buf;
+	size_t n = kTotalBytes / chunk.size();
+	Timestamp start(Timestamp::now());
+	for (size_t i = 0; i < n; ++i)
+	{
+		buf.append(chunk.data(), chunk.size());
+		buf.retrieve(chunk.size());
+	}
+	printResult(type, "steady", chunk.size(), kTotalBytes, buf.internalCapacity(), start);
+}
+
+template<typename BUFFER>
+void benchBacklog(const char* type, const std::string& chunk)
+{
+	BUFFER buf;
+	size_t n = std::max<size_t>(kBacklogBytes / chunk.size(), 2);
+	size_t capacity = 0;
+	Timestamp start(Timestamp::now());
+	for (size_t i = 0; i < n; ++i)
+	{
+		buf.append(chunk.data(), chunk.size());
+		buf.retrieve(chunk.size() / 2);
+	}
+	capacity = buf.internalCapacity();
+	buf.retrieve(buf.readableBytes());
+	printResult(type, "backlog", chunk.size(), n * chunk.size(), capacity, start);
+}
+
+template<typename BUFFER>
+void benchDrain(const char* type, const std::string& chunk)
+{
+	BUFFER buf;
+	size_t n = kTotalBytes / chunk.size();
+	Timestamp start(Timestamp::now());
+	for (size_t i = 0; i < n; ++i)
+	{
+		buf.append(chunk.data(), chunk.size());
+	}
+	size_t capacity = buf.internalCapacity();
+	for (size_t i = 0; i < n; ++i)
+	{
+		buf.retrieve(chunk.size());
+	}
+	assert(buf.readableBytes() == 0);
+	printResult(type, "drain", chunk.size(), kTotalBytes, capacity, start);
+}
+
+void testChainBuffer()
+{
+	std::string data;
+	for (int i = 0; i < 100000; ++i)
+	{
+		data.push_back(static_cast<char>('a' + i % 26));
+	}
+
+	ChainBuffer buf;
+	buf.append(data.data() + 4, data.size() - 4);
+	buf.prepend(data.data(), 4);
+	assert(buf.readableBytes() == data.size());
+	assert(buf.contiguousBytes() < data.size());
+
+	std::string head(16, '\0');
+	buf.peek(&*head.begin(), head.size());
+	assert(head == data.substr(0, 16));
+
+	int fds[2];
+	int ret = ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds);
+	assert(ret == 0);
+	(void)ret;
+
+	ChainBuffer input;
+	int savedErrno = 0;
+	while (buf.readableBytes() > 0)
+	{
+		buf.writefd(fds[0], &savedErrno);
+		while (input.readfd(fds[1], &savedErrno) > 0)
+		{
+		}
+	}
+	assert(input.retrieveAllAsString() == data);
+	assert(input.blockCount() == 1);
+	::close(fds[0]);
+	::close(fds[1]);
+	printf("ChainBuffer ok\n");
+}
+
+/**
+ * appendSlice() 挂上的外部数据：和普通的数据交错，prepend 到外部块的前面，部分取走之后释放 owner
+*/
+void testAppendSlice()
+{
+	std::shared_ptr<std::string> body(std::make_shared<std::string>(50000, 'b'));
+	std::weak_ptr<std::string> watch(body);
+	std::string expected;
+	{
+		ChainBuffer buf;
+		buf.appendSlice(body->data(), body->size(), body);
+		buf.append("tail", 4);
+		buf.appendSlice("small", 5, body);	/*太小，直接拷贝*/
+		buf.prepend("head", 4);
+		body.reset();
+		assert(!watch.expired());
+		assert(buf.blockCount() == 2);
+
+		expected = "head" + std::string(50000, 'b') + "tailsmall";
+		assert(buf.readableBytes() == expected.size());
+		std::string first(100, '\0');
+		buf.peek(&*first.begin(), first.size());
+		assert(first == expected.substr(0, 100));
+
+		buf.retrieve(4 + 40000);
+		assert(!watch.expired());
+		buf.retrieve(10000);
+		assert(watch.expired());	/*外部的数据取走之后马上释放*/
+		assert(buf.retrieveAllAsString() == "tailsmall");
+	}
+
+	/*外部的块是最后一个块的时候，取完之后缓冲区可以继续使用*/
+	ChainBuffer buf;
+	std::shared_ptr<std::string> last(std::make_shared<std::string>(4096, 'c'));
+	buf.append("x", 1);
+	buf.retrieveAll();
+	buf.appendSlice(last->data(), last->size(), last);
+	assert(buf.blockCount() == 0);
+	buf.retrieveAll();
+	buf.append("y", 1);
+	assert(buf.retrieveAllAsString() == "y");
+	printf("ChainBuffer appendSlice ok\n");
+}
+
+int main()
+{
+	Logger::setLogLevel(Logger::WARN);
+	EventLoop loop;	/*ChainBuffer 的块来自 loop 的 BufferPool*/
+	testChainBuffer();
+	testAppendSlice();
+
+	const size_t chunks[] = { 1024, 64 * 1024, 16 * 1024 * 1024 };
+	for (size_t chunkSize : chunks)
+	{
+		std::string chunk(chunkSize, 'x');
+		benchSteady<Buffer>("Buffer", chunk);
+		benchSteady<ChainBuffer>("ChainBuffer", chunk);
+		benchBacklog<Buffer>("Buffer", chunk);
+		benchBacklog<ChainBuffer>("ChainBuffer", chunk);
+		benchDrain<Buffer>("Buffer", chunk);
+		benchDrain<ChainBuffer>("ChainBuffer", chunk);
+	}
+}
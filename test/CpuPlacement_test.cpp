@@ -0,0 +1,279 @@
+#include "base/CountDownLatch.h"
+#include "base/CpuPlacement.h"
+#include "base/Logging.h"
+#include "base/Mutex.h"
+#include "base/Thread.h"
+#include "base/ThreadPool.h"
+#include "base/Timestamp.h"
+#include "net/BufferPool.h"
+#include "net/EventLoop.h"
+#include "net/EventLoopThreadPool.h"
+#include "net/TcpServer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <assert.h>
+#include <netinet/in.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/**
+ * 1. parseCpuList()、NUMA 拓扑、setCpuAffinity() 之后线程确实在指定的 CPU 上运行、EventLoopThreadPool 按照 spreadNodes() 绑定，
+ *    TcpServer 的连接的 Buffer 来自它所在的 io loop 自己的 BufferPool（绑定之后就是本地节点的内存）
+ * 2. 跨节点的代价：一个线程在节点 A 上分配并写一块内存（物理页在 A 上），另一个线程在节点 B 上反复读，
+ *    以及两个线程通过同一个 cache line 来回传递消息的延迟，分别对比绑定在各个节点组合上和不绑定
+ *    只有一个节点的机器上只能看到 node0 -> node0 和不绑定的结果
+ *
+ * usage: CpuPlacement_test [bufferMiB] [rounds]
+*/
+
+using namespace muduo;
+using namespace muduo::net;
+
+const uint16_t kPort = 2036;
+
+bool contains(const std::vector<int>& cpus, int cpu)
+{
+	return std::find(cpus.begin(), cpus.end(), cpu) != cpus.end();
+}
+
+/**
+ * 连接在 base loop 中 accept，在 io loop 中 connectEstablished()
+ * 每一个 io loop 的 pool 中至少有它的连接的输入 Buffer，base loop 的 pool 中没有
+*/
+void testConnectionBuffers(EventLoop* baseLoop, int n)
+{
+	TcpServer server(baseLoop, InetAddress(kPort, true), "PlacementServer");
+	server.setThreadNum(2, CpuPlacement::spreadNodes());
+	MutexLock mutex;
+	std::map<EventLoop*, int> perLoop;
+	std::atomic<int> connected(0);
+	server.setConnectionCallback([&](const TcpConnectionPtr& conn) {
+		MutexLockGuard lock(mutex);
+		if (conn->connected())
+		{
+			++perLoop[conn->getLoop()];
+			++connected;
+		}
+		else
+		{
+			--perLoop[conn->getLoop()];
+			--connected;
+		}
+	});
+	server.start();
+
+	/*阻塞的 connect() 在内核完成握手就返回，不需要 base loop 运行*/
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof addr);
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(kPort);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	std::vector<int> fds;
+	for (int i = 0; i < n; ++i)
+	{
+		int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+		int ret = ::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof addr);
+		assert(ret == 0);
+		(void)ret;
+		fds.push_back(fd);
+	}
+
+	int target = n;
+	/*全部建立，或者全部断开并且从 TcpServer 中删除*/
+	TimerId timer = baseLoop->runEvery(0.01, [&] {
+		if (connected == target && (target > 0 || server.numConnections() == 0))
+			baseLoop->quit();
+	});
+	baseLoop->loop();
+
+	assert(baseLoop->bufferPool()->bytesInUse() == 0);
+	for (EventLoop* ioLoop : server.threadPool()->getAllLoops())
+	{
+		MutexLockGuard lock(mutex);
+		assert(perLoop[ioLoop] > 0);
+		size_t expected = perLoop[ioLoop] * Buffer::kInitialSize;
+		assert(ioLoop->bufferPool()->bytesInUse() >= expected);
+		(void)expected;
+	}
+
+	for (int fd : fds)
+		::close(fd);
+	target = 0;
+	baseLoop->loop();
+	baseLoop->cancel(timer);
+}
+
+void functionalTests()
+{
+	std::vector<int> cpus;
+	assert(CpuPlacement::parseCpuList("0-3,8,10-11", &cpus));
+	int expected[] = { 0, 1, 2, 3, 8, 10, 11 };
+	assert(cpus == std::vector<int>(expected, expected + 7));
+	cpus.clear();
+	assert(!CpuPlacement::parseCpuList("3-1", &cpus));
+	assert(!CpuPlacement::parseCpuList("1,x", &cpus));
+	assert(!CpuPlacement::cpuList(string("oops")).enabled());
+
+	CpuPlacement list(CpuPlacement::cpuList(string("2,5")));
+	assert(list.cpusFor(0) == std::vector<int>(1, 2));
+	assert(list.cpusFor(3) == std::vector<int>(1, 5));
+	assert(CpuPlacement().cpusFor(0).empty());
+
+	/*每一个 CPU 上各启动一个线程*/
+	std::vector<std::vector<int> > nodes(CpuPlacement::numaNodes());
+	for (auto& node : nodes)
+	{
+		for (int cpu : node)
+		{
+			int ran = -1;
+			Thread thread([&ran] { ran = sched_getcpu(); });
+			thread.setCpuAffinity(std::vector<int>(1, cpu));
+			thread.start();
+			thread.join();
+			assert(ran == cpu);
+		}
+	}
+
+	/*io loop 依次分散到各个节点*/
+	EventLoop baseLoop;
+	EventLoopThreadPool pool(&baseLoop, "spread");
+	CpuPlacement spread(CpuPlacement::spreadNodes());
+	pool.setThreadNum(4, spread);
+	pool.start();
+	std::vector<EventLoop*> loops(pool.getAllLoops());
+	for (size_t i = 0; i < loops.size(); ++i)
+	{
+		CountDownLatch latch(1);
+		int ran = -1;
+		loops[i]->runInLoop([&] { ran = sched_getcpu(); latch.countDown(); });
+		latch.wait();
+		assert(contains(spread.cpusFor(static_cast<int>(i)), ran));
+	}
+
+	ThreadPool threadPool;
+	std::atomic<int> misplaced(0);
+	threadPool.setThreadInitCallback([&misplaced] {
+		if (sched_getcpu() != 0)
+			++misplaced;
+	});
+	threadPool.start(2, CpuPlacement::cpuList(std::vector<int>(1, 0)));
+	threadPool.stop();
+	assert(misplaced == 0);
+
+	testConnectionBuffers(&baseLoop, 100);
+
+	printf("functional tests passed\n");
+	fflush(stdout);
+}
+
+/*空的 cpus 表示不绑定*/
+double readBandwidth(const std::vector<int>& writerCpus, const std::vector<int>& readerCpus,
+					 size_t bytes, int rounds)
+{
+	std::unique_ptr<char[]> buffer;
+	Thread writer([&] {
+		buffer.reset(new char[bytes]);
+		memset(buffer.get(), 1, bytes);
+	});
+	writer.setCpuAffinity(writerCpus);
+	writer.start();
+	writer.join();
+
+	double seconds = 0;
+	Thread reader([&] {
+		const uint64_t* p = reinterpret_cast<const uint64_t*>(buffer.get());
+		size_t n = bytes / sizeof(uint64_t);
+		volatile uint64_t sink = 0;
+		Timestamp start(Timestamp::now());
+		for (int round = 0; round < rounds; ++round)
+		{
+			uint64_t sum = 0;
+			for (size_t i = 0; i < n; ++i)
+				sum += p[i];
+			sink = sink + sum;
+		}
+		seconds = timeDifference(Timestamp::now(), start);
+	});
+	reader.setCpuAffinity(readerCpus);
+	reader.start();
+	reader.join();
+	return static_cast<double>(bytes) * rounds / seconds / (1 << 30);
+}
+
+/*两个线程轮流修改同一个变量，cache line 在两个 CPU 之间来回，返回一次单程的纳秒数*/
+double pingPongNs(const std::vector<int>& pingCpus, const std::vector<int>& pongCpus, int round)
+{
+	alignas(64) std::atomic<int> turn(0);
+	auto player = [&turn, round](int self) {
+		for (int i = self; i < 2 * round; i += 2)
+		{
+			while (turn.load(std::memory_order_acquire) != i)
+				sched_yield();
+			turn.store(i + 1, std::memory_order_release);
+		}
+	};
+	Thread ping(std::bind(player, 0));
+	Thread pong(std::bind(player, 1));
+	ping.setCpuAffinity(pingCpus);
+	pong.setCpuAffinity(pongCpus);
+	Timestamp start(Timestamp::now());
+	ping.start();
+	pong.start();
+	ping.join();
+	pong.join();
+	return timeDifference(Timestamp::now(), start) * 1e9 / (2 * round);
+}
+
+int main(int argc, char* argv[])
+{
+	size_t bytes = static_cast<size_t>(argc > 1 ? atoi(argv[1]) : 256) << 20;
+	int rounds = argc > 2 ? atoi(argv[2]) : 10;
+	Logger::setLogLevel(Logger::WARN);
+
+	functionalTests();
+
+	std::vector<std::vector<int> > nodes(CpuPlacement::numaNodes());
+	printf("%zu NUMA node(s)\n", nodes.size());
+	for (size_t i = 0; i < nodes.size(); ++i)
+		printf("  node%zu: %zu cpus, first %d\n", i, nodes[i].size(), nodes[i][0]);
+
+	printf("read %zu MiB x %d, GiB/s (memory on writer's node):\n", bytes >> 20, rounds);
+	for (size_t w = 0; w < nodes.size(); ++w)
+	{
+		for (size_t r = 0; r < nodes.size(); ++r)
+		{
+			printf("  node%zu -> node%zu  %6.2f\n", w, r,
+					readBandwidth(nodes[w], nodes[r], bytes, rounds));
+			fflush(stdout);
+		}
+	}
+	printf("  unpinned        %6.2f\n", readBandwidth(std::vector<int>(), std::vector<int>(), bytes, rounds));
+
+	/*每个节点的前两个 CPU，只有一个 CPU 的时候两个线程在同一个 CPU 上轮流运行*/
+	printf("cache line ping-pong, ns per hop:\n");
+	const int kRounds = 100000;
+	for (size_t a = 0; a < nodes.size(); ++a)
+	{
+		for (size_t b = a; b < nodes.size(); ++b)
+		{
+			int pingCpu = nodes[a][0];
+			int pongCpu = nodes[b].size() > 1 && a == b ? nodes[b][1] : nodes[b][0];
+			printf("  cpu%d <-> cpu%d (node%zu/node%zu)  %8.0f\n", pingCpu, pongCpu, a, b,
+					pingPongNs(std::vector<int>(1, pingCpu), std::vector<int>(1, pongCpu), kRounds));
+			fflush(stdout);
+		}
+	}
+	printf("  unpinned                      %8.0f\n",
+			pingPongNs(std::vector<int>(), std::vector<int>(), kRounds));
+	fflush(stdout);
+}
@@ -0,0 +1,149 @@
+#include "base/CountDownLatch.h"
+#include "base/Logging.h"
+#include "net/EventLoop.h"
+#include "net/EventLoopThread.h"
+#include "net/TcpClient.h"
+#include "net/TcpConnection.h"
+#include "net/TcpServer.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * 统计从其他线程 TcpConnection::send() 的时候，每一次 send 分配内存的次数
+ * 替换全局的 operator new 计数，先单独比较 std::function 和 EventLoop::Functor 保存同一个 std::bind 对象，
+ * 再通过一个真正的连接从主线程用不同的 send() 各发送 count 次
+ *
+ * usage: CrossThreadSend_test [count] [messageSize]
+*/
+
+using namespace muduo;
+using namespace muduo::net;
+
+std::atomic<int64_t> g_allocations(0);
+
+void* operator new(size_t size)
+{
+	g_allocations.fetch_add(1, std::memory_order_relaxed);
+	void* p = ::malloc(size ? size : 1);
+	if (p == NULL)
+		throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void* p) noexcept
+{
+	::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	::free(p);
+}
+
+struct Sink
+{
+	void consume(const StringPiece& message) { bytes += message.size(); }
+	size_t bytes = 0;
+};
+
+/*和 TcpConnection::send() 中 bind 的对象一样：成员函数指针，this 和一个 string*/
+template <typename Function>
+double allocationsPerFunctor(int count, const string& message)
+{
+	Sink sink;
+	void (Sink::*fp)(const StringPiece&) = &Sink::consume;
+	int64_t before = g_allocations.load();
+	for (int i = 0; i < count; ++i)
+	{
+		Function f(std::bind(fp, &sink, message));
+		Function moved(std::move(f));	/*放入和取出队列各移动一次*/
+		moved();
+	}
+	return static_cast<double>(g_allocations.load() - before) / count;
+}
+
+template <typename SendFunc>
+void measureSends(EventLoop* loop, const char* what, int count, SendFunc send)
+{
+	int64_t before = g_allocations.load();
+	for (int i = 0; i < count; ++i)
+	{
+		send(i);
+	}
+	CountDownLatch drained(1);
+	loop->runInLoop(std::bind(&CountDownLatch::countDown, &drained));
+	drained.wait();
+	int64_t allocations = g_allocations.load() - before - 1;	/*减去 drained 的一次*/
+	printf("cross-thread TcpConnection::%-24s %.2f allocations per send\n",
+			what, static_cast<double>(allocations) / count);
+	fflush(stdout);
+}
+
+void onServerMessage(const TcpConnectionPtr&, Buffer* buf, Timestamp)
+{
+	buf->retrieveAll();
+}
+
+int main(int argc, char* argv[])
+{
+	int count = argc > 1 ? atoi(argv[1]) : 100000;
+	size_t messageSize = argc > 2 ? atoi(argv[2]) : 32;
+	Logger::setLogLevel(Logger::WARN);
+	string message(messageSize, 'x');
+
+	printf("bound sendInLoop, %zu byte message, allocations per functor:\n", messageSize);
+	printf("  std::function<void ()>  %.2f\n", allocationsPerFunctor<std::function<void ()> >(count, message));
+	printf("  EventLoop::Functor      %.2f\n", allocationsPerFunctor<EventLoop::Functor>(count, message));
+	fflush(stdout);
+
+	EventLoopThread loopThread;
+	EventLoop* loop = loopThread.startLoop();
+	InetAddress listenAddr(2028, true);
+	std::unique_ptr<TcpServer> server;
+	std::unique_ptr<TcpClient> client;
+	CountDownLatch connected(1);
+	loop->runInLoop([&] {
+		server.reset(new TcpServer(loop, listenAddr, "SinkServer"));
+		server->setMessageCallback(onServerMessage);
+		server->start();
+		client.reset(new TcpClient(loop, InetAddress("127.0.0.1", 2028), "SendClient"));
+		client->setConnectionCallback([&connected](const TcpConnectionPtr& conn) {
+			if (conn->connected())
+				connected.countDown();
+		});
+		client->connect();
+	});
+	connected.wait();
+
+	TcpConnectionPtr conn = client->connection();
+	measureSends(loop, "send(const StringPiece&)", count, [&](int) { conn->send(message); });
+
+	/*要发送的数据事先准备好，只统计 send() 中的分配*/
+	std::vector<string> strings(count, message);
+	measureSends(loop, "send(string&&)", count, [&](int i) { conn->send(std::move(strings[i])); });
+
+	std::vector<Buffer> buffers;
+	buffers.reserve(count);
+	for (int i = 0; i < count; ++i)
+	{
+		buffers.emplace_back(messageSize);
+		buffers.back().append(message);
+	}
+	measureSends(loop, "send(Buffer&&)", count, [&](int i) { conn->send(std::move(buffers[i])); });
+
+	conn.reset();
+	CountDownLatch stopped(1);
+	loop->runInLoop([&] { client->disconnect(); });
+	loop->runAfter(0.2, [&] {
+		client.reset();
+		server.reset();
+		stopped.countDown();
+	});
+	stopped.wait();
+}
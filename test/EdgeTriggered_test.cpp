@@ -0,0 +1,130 @@
+#include "base/CountDownLatch.h"
+#include "base/Logging.h"
+#include "base/Timestamp.h"
+#include "net/EventLoop.h"
+#include "net/EventLoopThread.h"
+#include "net/TcpClient.h"
+#include "net/TcpServer.h"
+
+#include <memory>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * 水平触发和边沿触发的 pingpong 对比
+ * 服务端在一个 io 线程中把收到的数据原样发回，客户端在主线程中同样把收到的数据发回
+ * 运行 seconds 秒之后打印吞吐量，以及服务端和客户端两个 loop 的 epoll_ctl() 次数和合并掉的次数
+ *
+ * usage: EdgeTriggered_test [lt|et] [connections] [blockSize] [seconds]
+*/
+
+using namespace muduo;
+using namespace muduo::net;
+
+std::vector<std::unique_ptr<TcpClient> > g_clients;
+int64_t g_bytesRead = 0;
+int64_t g_readCalls = 0;
+
+void onEcho(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+	conn->send(buf);
+}
+
+void onClientConnection(const TcpConnectionPtr& conn, const string* block)
+{
+	if (conn->connected())
+	{
+		conn->setTcpNoDelay(true);
+		conn->send(*block);
+	}
+}
+
+void stop(EventLoop* loop, EventLoop* serverLoop, bool edgeTriggered, double seconds)
+{
+	int64_t clientCalls = loop->pollerControlCalls();
+	int64_t clientSaved = loop->channelUpdatesSaved();
+	int64_t serverCalls = 0;
+	int64_t serverSaved = 0;
+	CountDownLatch latch(1);
+	/*serverLoop 的计数只能在它自己的线程中读*/
+	serverLoop->runInLoop([serverLoop, &serverCalls, &serverSaved, &latch] {
+		serverCalls = serverLoop->pollerControlCalls();
+		serverSaved = serverLoop->channelUpdatesSaved();
+		latch.countDown();
+	});
+	for (auto& client : g_clients)
+	{
+		TcpConnectionPtr conn = client->connection();
+		if (conn)
+		{
+			g_bytesRead += conn->bytesRead();
+			g_readCalls += conn->readCalls();
+		}
+	}
+	latch.wait();
+
+	printf("%s: %.1f MiB/s  client reads %ld (%.0f bytes/read)  epoll_ctl server %ld client %ld  saved server %ld client %ld\n",
+			edgeTriggered ? "edge-triggered " : "level-triggered",
+			static_cast<double>(g_bytesRead) / seconds / 1024 / 1024,
+			static_cast<long>(g_readCalls),
+			static_cast<double>(g_bytesRead) / g_readCalls,
+			static_cast<long>(serverCalls),
+			static_cast<long>(clientCalls),
+			static_cast<long>(serverSaved),
+			static_cast<long>(clientSaved));
+	fflush(stdout);
+
+	for (auto& client : g_clients)
+	{
+		client->disconnect();
+	}
+	loop->runAfter(0.5, std::bind(&EventLoop::quit, loop));
+}
+
+int main(int argc, char* argv[])
+{
+	bool edgeTriggered = argc > 1 && strcmp(argv[1], "et") == 0;
+	int connections = argc > 2 ? atoi(argv[2]) : 100;
+	size_t blockSize = argc > 3 ? atoi(argv[3]) : 64 * 1024;
+	double seconds = argc > 4 ? atof(argv[4]) : 5.0;
+	Logger::setLogLevel(Logger::WARN);
+
+	EventLoopThread serverThread;
+	EventLoop* serverLoop = serverThread.startLoop();
+	InetAddress listenAddr(2026, true);
+	std::unique_ptr<TcpServer> server;
+	CountDownLatch started(1);
+	serverLoop->runInLoop([&] {
+		server.reset(new TcpServer(serverLoop, listenAddr, "EchoServer"));
+		server->setMessageCallback(onEcho);
+		server->setEdgeTriggered(edgeTriggered);
+		server->start();
+		started.countDown();
+	});
+	started.wait();
+
+	EventLoop loop;
+	string block(blockSize, 'x');
+	for (int i = 0; i < connections; ++i)
+	{
+		g_clients.emplace_back(new TcpClient(&loop, InetAddress("127.0.0.1", 2026), "PingPong"));
+		g_clients.back()->setEdgeTriggered(edgeTriggered);
+		g_clients.back()->setConnectionCallback(std::bind(onClientConnection, _1, &block));
+		g_clients.back()->setMessageCallback(onEcho);
+		g_clients.back()->connect();
+	}
+	loop.runAfter(seconds, std::bind(stop, &loop, serverLoop, edgeTriggered, seconds));
+	loop.loop();
+	g_clients.clear();
+
+	CountDownLatch stopped(1);
+	serverLoop->runInLoop([&] {
+		server.reset();
+		stopped.countDown();
+	});
+	stopped.wait();
+}
@@ -0,0 +1,222 @@
+#include "base/CountDownLatch.h"
+#include "base/CurrentThread.h"
+#include "base/Future.h"
+#include "base/Logging.h"
+#include "base/ThreadPool.h"
+#include "base/Timestamp.h"
+#include "base/WorkStealingThreadPool.h"
+#include "net/EventLoop.h"
+#include "net/EventLoopThread.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * 1. 功能：then() 在指定的 loop 中执行、void 任务、结果先于 then() 到达、cancel()、WeakCallback 的对象析构
+ * 2. I/O loop -> 线程池 -> I/O loop 的往返延迟：loop 中一直保持 outstanding 个请求，
+ *    每一个请求在线程池中计算之后回到 loop，和手写 run() + runInLoop() 对比
+ *
+ * usage: Future_test [requests] [threads] [outstanding]
+*/
+
+using namespace muduo;
+using namespace muduo::net;
+
+/*模拟一个请求的计算量*/
+int compute(int n)
+{
+	unsigned sum = 0;
+	for (int i = 0; i < 1000; ++i)
+		sum = sum * 31 + n + i;
+	return n + static_cast<int>(sum & 0);
+}
+
+struct Session
+{
+	int replies = 0;
+	void onReply(int) { ++replies; }
+};
+
+template <typename Pool>
+void functionalTests(EventLoop* loop, const char* name)
+{
+	Pool pool;
+	pool.start(2);
+
+	{
+		CountDownLatch done(1);
+		int result = 0;
+		bool inLoop = false;
+		pool.submit(std::bind(compute, 42)).then(loop, [&](int n) {
+			result = n;
+			inLoop = loop->isInLoopThread();
+			done.countDown();
+		});
+		done.wait();
+		assert(result == 42 && inLoop);
+	}
+
+	{
+		CountDownLatch done(1);
+		std::atomic<int> ran(0);
+		pool.submit([&] { ++ran; }).then(loop, [&] { done.countDown(); });
+		done.wait();
+		assert(ran == 1);
+	}
+
+	{
+		/*结果已经有了再调用 then()*/
+		Future<int> f = pool.submit(std::bind(compute, 7));
+		while (!f.ready())
+			CurrentThread::sleepUsec(100);
+		CountDownLatch done(1);
+		int result = 0;
+		f.then(loop, [&](int n) { result = n; done.countDown(); });
+		done.wait();
+		assert(result == 7);
+	}
+
+	{
+		/*两个 worker 都被占住，后面的任务在开始之前被取消*/
+		CountDownLatch blocked(1);
+		pool.run([&] { blocked.wait(); });
+		pool.run([&] { blocked.wait(); });
+		std::atomic<int> computed(0);
+		std::atomic<int> delivered(0);
+		Future<int> cancelled = pool.submit([&] { ++computed; return 1; });
+		cancelled.then(loop, [&](int) { ++delivered; });
+		cancelled.cancel();
+
+		std::shared_ptr<Session> session(new Session);
+		pool.submit([&] { ++computed; return 2; })
+			.then(loop, makeWeakCallback(session, &Session::onReply));
+		session.reset();
+
+		CountDownLatch done(1);
+		pool.submit([&] { return 3; }).then(loop, [&](int) { done.countDown(); });
+		blocked.countDown();
+		done.wait();
+		/*这时候 loop 中排在 done 之前的回调都已经执行过了*/
+		assert(computed == 0 && delivered == 0);
+	}
+
+	pool.stop();
+	printf("%s: functional tests passed\n", name);
+	fflush(stdout);
+}
+
+/**
+ * 在 loop 线程中发起 requests 个请求，同时最多 outstanding 个
+*/
+class RoundTrip
+{
+public:
+	RoundTrip(EventLoop* loop, int requests, int outstanding, bool useFuture)
+		: loop_(loop), requests_(requests), outstanding_(outstanding),
+		  useFuture_(useFuture), sent_(0), done_(1)
+	{
+		latencies_.reserve(requests);
+	}
+
+	template <typename Pool>
+	double run(Pool* pool)
+	{
+		Timestamp start(Timestamp::now());
+		loop_->runInLoop([this, pool] {
+			for (int i = 0; i < outstanding_ && sent_ < requests_; ++i)
+				send(pool);
+		});
+		done_.wait();
+		return timeDifference(Timestamp::now(), start);
+	}
+
+	void print(const char* pool, double seconds)
+	{
+		std::sort(latencies_.begin(), latencies_.end());
+		size_t n = latencies_.size();
+		printf("%-16s %-8s %8.0f req/s  p50 %6lld us  p99 %6lld us  max %6lld us\n",
+				pool, useFuture_ ? "future" : "manual", n / seconds,
+				static_cast<long long>(latencies_[n / 2]),
+				static_cast<long long>(latencies_[n * 99 / 100]),
+				static_cast<long long>(latencies_[n - 1]));
+		fflush(stdout);
+	}
+
+private:
+	template <typename Pool>
+	void send(Pool* pool)
+	{
+		int id = sent_++;
+		Timestamp start(Timestamp::now());
+		if (useFuture_)
+		{
+			pool->submit(std::bind(compute, id)).then(loop_, [this, pool, start](int) {
+				onReply(pool, start);
+			});
+		}
+		else
+		{
+			EventLoop* loop = loop_;
+			pool->run([this, pool, loop, id, start] {
+				compute(id);
+				loop->runInLoop([this, pool, start] { onReply(pool, start); });
+			});
+		}
+	}
+
+	template <typename Pool>
+	void onReply(Pool* pool, Timestamp start)
+	{
+		latencies_.push_back(Timestamp::now().microSecondsSinceEpoch() - start.microSecondsSinceEpoch());
+		if (sent_ < requests_)
+			send(pool);
+		else if (static_cast<int>(latencies_.size()) == requests_)
+			done_.countDown();
+	}
+
+	EventLoop* loop_;
+	const int requests_;
+	const int outstanding_;
+	const bool useFuture_;
+	int sent_;
+	std::vector<int64_t> latencies_;
+	CountDownLatch done_;
+};
+
+template <typename Pool>
+void bench(EventLoop* loop, const char* name, int requests, int threads, int outstanding)
+{
+	for (int useFuture = 0; useFuture < 2; ++useFuture)
+	{
+		Pool pool;
+		pool.start(threads);
+		RoundTrip trip(loop, requests, outstanding, useFuture);
+		double seconds = trip.run(&pool);
+		trip.print(name, seconds);
+		pool.stop();
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	int requests = argc > 1 ? atoi(argv[1]) : 200000;
+	int threads = argc > 2 ? atoi(argv[2]) : 2;
+	int outstanding = argc > 3 ? atoi(argv[3]) : 1;
+	Logger::setLogLevel(Logger::WARN);
+
+	EventLoopThread ioThread;
+	EventLoop* loop = ioThread.startLoop();
+
+	functionalTests<ThreadPool>(loop, "ThreadPool");
+	functionalTests<WorkStealingThreadPool>(loop, "WorkStealingThreadPool");
+
+	printf("requests %d threads %d outstanding %d\n", requests, threads, outstanding);
+	bench<ThreadPool>(loop, "ThreadPool", requests, threads, outstanding);
+	bench<WorkStealingThreadPool>(loop, "WorkStealing", requests, threads, outstanding);
+}
@@ -0,0 +1,174 @@
+#include "base/CountDownLatch.h"
+#include "base/Logging.h"
+#include "base/Mutex.h"
+#include "net/EventLoop.h"
+#include "net/EventLoopThread.h"
+#include "net/EventLoopThreadPool.h"
+#include "net/TcpClient.h"
+#include "net/TcpServer.h"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * 1. 一致性 hash：4 个 loop 和 5 个 loop 的 pool 中，同一个 hashCode 换了 loop 的比例，取模和一致性 hash 对比
+ * 2. 负载不均匀的长连接：依次建立 connections 个连接，每 4 个中有 1 个一直在发送数据 (重的)，其他的不发送
+ *    轮流分配的时候重的连接全部落在同一个 loop 上，打印每一个 loop 的连接数、busyRatio() 和处理的数据量
+ *
+ * usage: LoopSelection_test [rr|conn|queue|busy] [ioThreads] [connections] [seconds]
+*/
+
+using namespace muduo;
+using namespace muduo::net;
+
+const uint16_t kPort = 2033;
+const size_t kBlockSize = 16 * 1024;
+
+MutexLock g_mutex;
+std::map<EventLoop*, int64_t> g_bytesPerLoop;
+
+double movedKeys(EventLoop* base, int virtualNodes)
+{
+	EventLoopThreadPool four(base, "four");
+	four.setThreadNum(4);
+	four.setConsistentHash(virtualNodes);
+	four.start();
+	EventLoopThreadPool five(base, "five");
+	five.setThreadNum(5);
+	five.setConsistentHash(virtualNodes);
+	five.start();
+
+	std::vector<EventLoop*> loops4 = four.getAllLoops();
+	std::vector<EventLoop*> loops5 = five.getAllLoops();
+	const int kKeys = 100000;
+	int moved = 0;
+	for (size_t key = 0; key < kKeys; ++key)
+	{
+		/*比较的是第几个 loop*/
+		size_t i = std::find(loops4.begin(), loops4.end(), four.getLoopForHash(key)) - loops4.begin();
+		size_t j = std::find(loops5.begin(), loops5.end(), five.getLoopForHash(key)) - loops5.begin();
+		if (i != j)
+			++moved;
+	}
+	return static_cast<double>(moved) / kKeys;
+}
+
+/*消耗和数据量成正比的 CPU*/
+void onServerMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+	size_t n = buf->readableBytes();
+	const char* p = buf->peek();
+	unsigned sum = 0;
+	for (int round = 0; round < 8; ++round)
+	{
+		for (size_t i = 0; i < n; ++i)
+			sum = sum * 31 + p[i];
+	}
+	buf->retrieveAll();
+	MutexLockGuard lock(g_mutex);
+	g_bytesPerLoop[conn->getLoop()] += n + (sum & 0);
+}
+
+void onClientConnection(const TcpConnectionPtr& conn, bool heavy, const string* block)
+{
+	if (conn->connected() && heavy)
+		conn->send(*block);
+}
+
+void onWriteComplete(const TcpConnectionPtr& conn, const string* block)
+{
+	conn->send(*block);
+}
+
+int main(int argc, char* argv[])
+{
+	const char* mode = argc > 1 ? argv[1] : "busy";
+	int ioThreads = argc > 2 ? atoi(argv[2]) : 4;
+	int connections = argc > 3 ? atoi(argv[3]) : 16;
+	double seconds = argc > 4 ? atof(argv[4]) : 3.0;
+	Logger::setLogLevel(Logger::WARN);
+
+	EventLoopThreadPool::SelectionStrategy strategy = EventLoopThreadPool::kRoundRobin;
+	if (strcmp(mode, "conn") == 0)
+		strategy = EventLoopThreadPool::kLeastConnections;
+	else if (strcmp(mode, "queue") == 0)
+		strategy = EventLoopThreadPool::kLeastQueued;
+	else if (strcmp(mode, "busy") == 0)
+		strategy = EventLoopThreadPool::kLeastBusy;
+
+	EventLoop loop;
+	printf("4 -> 5 loops, keys moved: modulo %.1f%%  consistent hash %.1f%%\n",
+			movedKeys(&loop, 0) * 100, movedKeys(&loop, 160) * 100);
+	fflush(stdout);
+
+	EventLoopThread serverThread;
+	EventLoop* serverLoop = serverThread.startLoop();
+	std::unique_ptr<TcpServer> server;
+	std::vector<EventLoop*> ioLoops;
+	CountDownLatch started(1);
+	serverLoop->runInLoop([&] {
+		server.reset(new TcpServer(serverLoop, InetAddress(kPort, true), "LoadServer"));
+		server->setMessageCallback(onServerMessage);
+		server->setThreadNum(ioThreads);
+		server->threadPool()->setSelectionStrategy(strategy);
+		server->start();
+		ioLoops = server->threadPool()->getAllLoops();
+		started.countDown();
+	});
+	started.wait();
+
+	/*连接间隔 150ms 建立，让 busyRatio() 跟上*/
+	string block(kBlockSize, 'x');
+	std::vector<std::unique_ptr<TcpClient> > clients;
+	for (int i = 0; i < connections; ++i)
+	{
+		bool heavy = i % 4 == 0;
+		loop.runAfter(0.15 * i, [&, heavy] {
+			clients.emplace_back(new TcpClient(&loop, InetAddress("127.0.0.1", kPort), "LoadClient"));
+			clients.back()->setConnectionCallback(std::bind(onClientConnection, _1, heavy, &block));
+			clients.back()->setWriteCompleteCallback(std::bind(onWriteComplete, _1, &block));
+			clients.back()->connect();
+		});
+	}
+
+	double connectTime = 0.15 * connections + 0.2;
+	loop.runAfter(connectTime, [&] {
+		MutexLockGuard lock(g_mutex);
+		g_bytesPerLoop.clear();
+	});
+	loop.runAfter(connectTime + seconds, [&] {
+		int64_t total = 0;
+		printf("%-5s loop  connections  busy   MiB/s\n", mode);
+		MutexLockGuard lock(g_mutex);
+		for (size_t i = 0; i < ioLoops.size(); ++i)
+		{
+			int64_t bytes = g_bytesPerLoop[ioLoops[i]];
+			total += bytes;
+			printf("      %4zu  %11d  %4.0f%%  %6.1f\n",
+					i, ioLoops[i]->numConnections(), ioLoops[i]->busyRatio() * 100,
+					static_cast<double>(bytes) / seconds / 1024 / 1024);
+		}
+		printf("      total %.1f MiB/s\n", static_cast<double>(total) / seconds / 1024 / 1024);
+		fflush(stdout);
+		for (auto& client : clients)
+		{
+			client->disconnect();
+		}
+		loop.runAfter(0.5, std::bind(&EventLoop::quit, &loop));
+	});
+	loop.loop();
+	clients.clear();
+
+	CountDownLatch stopped(1);
+	serverLoop->runInLoop([&] {
+		server.reset();
+		stopped.countDown();
+	});
+	stopped.wait();
+}
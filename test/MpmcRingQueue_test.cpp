@@ -0,0 +1,163 @@
+#include "base/BlockingQueue.h"
+#include "base/BoundedBlockingQueue.h"
+#include "base/CountDownLatch.h"
+#include "base/MpmcRingQueue.h"
+#include "base/Thread.h"
+#include "base/Timestamp.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+/**
+ * 1. 功能：tryPut / tryTake、满和空、超时、close() 之后取完剩下的元素、多线程下每个元素恰好取出一次
+ * 2. 竞争：producers 个线程 put，consumers 个线程 take，对比 BlockingQueue、BoundedBlockingQueue 和 MpmcRingQueue
+ *    的吞吐量，以及进程的主动上下文切换次数（线程在 futex 上休眠的次数）
+ *
+ * usage: MpmcRingQueue_test [items] [capacity]
+*/
+
+using namespace muduo;
+
+void functionalTests()
+{
+	MpmcRingQueue<std::string> q(3);
+	std::string s;
+	assert(!q.tryTake(&s));
+	assert(q.tryPut("a") && q.tryPut("b") && q.tryPut(std::string("c")));
+	assert(q.full() && !q.tryPut("d"));
+	assert(!q.putFor("d", 0.01));
+	assert(q.tryTake(&s) && s == "a");
+	assert(q.put("d"));
+	assert(q.take() == "b" && q.take() == "c" && q.take() == "d");
+	assert(!q.takeFor(&s, 0.01));
+
+	MpmcRingQueue<int> one(1);
+	int x = 0;
+	assert(one.tryPut(1) && !one.tryPut(2));
+	assert(one.tryTake(&x) && x == 1 && !one.tryTake(&x));
+	assert(one.tryPut(3) && !one.tryPut(4) && one.take() == 3);
+
+	/*take() 阻塞，close() 之后先取完剩下的元素再返回*/
+	MpmcRingQueue<int> closing(4);
+	CountDownLatch taken(1);
+	int got = -1;
+	Thread waiter([&] { got = closing.take(); taken.countDown(); });
+	waiter.start();
+	closing.put(7);
+	taken.wait();
+	waiter.join();
+	assert(got == 7);
+	closing.put(8);
+	closing.close();
+	assert(!closing.put(9));
+	assert(closing.take() == 8);
+	assert(closing.take() == 0);
+
+	/*4 个生产者 4 个消费者，容量很小，一直在满和空之间切换*/
+	MpmcRingQueue<int> ring(8);
+	const int kPerProducer = 50000;
+	std::atomic<int64_t> sum(0);
+	std::vector<std::unique_ptr<Thread> > threads;
+	for (int p = 0; p < 4; ++p)
+	{
+		threads.emplace_back(new Thread([&ring] {
+			for (int i = 1; i <= kPerProducer; ++i)
+				ring.put(i);
+		}));
+	}
+	for (int c = 0; c < 4; ++c)
+	{
+		threads.emplace_back(new Thread([&ring, &sum] {
+			int x;
+			while ((x = ring.take()) != 0)
+				sum += x;
+		}));
+	}
+	for (auto& thr : threads)
+		thr->start();
+	for (int p = 0; p < 4; ++p)
+		threads[p]->join();
+	ring.close();
+	for (size_t c = 4; c < threads.size(); ++c)
+		threads[c]->join();
+	assert(sum == 4 * static_cast<int64_t>(kPerProducer) * (kPerProducer + 1) / 2);
+
+	printf("functional tests passed\n");
+	fflush(stdout);
+}
+
+long voluntarySwitches()
+{
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_nvcsw;
+}
+
+/**
+ * 每一个消费者取到 -1 的时候退出，生产者全部结束之后放入 consumers 个 -1
+*/
+template <typename Queue>
+void contention(const char* name, Queue* queue, int producers, int consumers, int items)
+{
+	int perProducer = items / producers;
+	std::vector<std::unique_ptr<Thread> > threads;
+	for (int p = 0; p < producers; ++p)
+	{
+		threads.emplace_back(new Thread([queue, perProducer] {
+			for (int i = 0; i < perProducer; ++i)
+				queue->put(i);
+		}));
+	}
+	for (int c = 0; c < consumers; ++c)
+	{
+		threads.emplace_back(new Thread([queue] {
+			while (queue->take() >= 0)
+			{
+			}
+		}));
+	}
+
+	long switches = voluntarySwitches();
+	Timestamp start(Timestamp::now());
+	for (auto& thr : threads)
+		thr->start();
+	for (int p = 0; p < producers; ++p)
+		threads[p]->join();
+	for (int c = 0; c < consumers; ++c)
+		queue->put(-1);
+	for (size_t c = producers; c < threads.size(); ++c)
+		threads[c]->join();
+	double seconds = timeDifference(Timestamp::now(), start);
+
+	printf("  %dP/%dC  %-20s %10.0f items/s  %8ld context switches\n",
+			producers, consumers, name, perProducer * producers / seconds,
+			voluntarySwitches() - switches);
+	fflush(stdout);
+}
+
+int main(int argc, char* argv[])
+{
+	int items = argc > 1 ? atoi(argv[1]) : 1000000;
+	int capacity = argc > 2 ? atoi(argv[2]) : 1024;
+
+	functionalTests();
+
+	printf("%d items, bounded capacity %d\n", items, capacity);
+	int configs[][2] = { { 1, 1 }, { 4, 1 }, { 1, 4 }, { 4, 4 }, { 8, 8 } };
+	for (auto& config : configs)
+	{
+		BlockingQueue<int> unbounded;
+		contention("BlockingQueue", &unbounded, config[0], config[1], items);
+		BoundedBlockingQueue<int> bounded(capacity);
+		contention("BoundedBlockingQueue", &bounded, config[0], config[1], items);
+		MpmcRingQueue<int> ring(capacity);
+		contention("MpmcRingQueue", &ring, config[0], config[1], items);
+	}
+}
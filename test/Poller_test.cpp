@@ -0,0 +1,141 @@
+#include "base/CountDownLatch.h"
+#include "base/Logging.h"
+#include "base/Timestamp.h"
+#include "net/EventLoop.h"
+#include "net/EventLoopThread.h"
+#include "net/TcpClient.h"
+#include "net/TcpServer.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * 比较 poll / epoll / io_uring 三种 Poller 的 echo 吞吐量和延迟
+ * 服务端在一个 io 线程中原样发回，每一个客户端连接发出一个请求，收到回复之后记录延迟，再发下一个
+ * 请求的前 8 个字节是发送的时间
+ *
+ * usage: Poller_test [poll|epoll|uring] [connections] [messageSize] [seconds] [lt|et]
+*/
+
+using namespace muduo;
+using namespace muduo::net;
+
+size_t g_messageSize = 64;
+std::vector<int64_t> g_latencies;
+bool g_running = true;
+
+void onServerMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+	conn->send(buf);
+}
+
+void sendRequest(const TcpConnectionPtr& conn)
+{
+	string message(g_messageSize, 'x');
+	int64_t now = Timestamp::now().microSecondsSinceEpoch();
+	memcpy(&*message.begin(), &now, sizeof now);
+	conn->send(message);
+}
+
+void onClientConnection(const TcpConnectionPtr& conn)
+{
+	if (conn->connected())
+	{
+		conn->setTcpNoDelay(true);
+		sendRequest(conn);
+	}
+}
+
+void onClientMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+	while (buf->readableBytes() >= g_messageSize)
+	{
+		int64_t sent = 0;
+		memcpy(&sent, buf->peek(), sizeof sent);
+		buf->retrieve(g_messageSize);
+		g_latencies.push_back(Timestamp::now().microSecondsSinceEpoch() - sent);
+		if (g_running)
+			sendRequest(conn);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const char* backend = argc > 1 ? argv[1] : "epoll";
+	int connections = argc > 2 ? atoi(argv[2]) : 100;
+	g_messageSize = std::max<size_t>(argc > 3 ? atoi(argv[3]) : 64, sizeof(int64_t));
+	double seconds = argc > 4 ? atof(argv[4]) : 5.0;
+	bool edgeTriggered = argc > 5 && strcmp(argv[5], "et") == 0;
+	Logger::setLogLevel(Logger::WARN);
+
+	/*在创建任何 EventLoop 之前选择 Poller，参考 Poller::newDefaultPoller()*/
+	if (strcmp(backend, "poll") == 0)
+		::setenv("MODUO_USE_POLL", "1", 1);
+	else if (strcmp(backend, "uring") == 0)
+		::setenv("MUDUO_USE_IO_URING", "1", 1);
+
+	EventLoopThread serverThread;
+	EventLoop* serverLoop = serverThread.startLoop();
+	InetAddress listenAddr(2027, true);
+	std::unique_ptr<TcpServer> server;
+	CountDownLatch started(1);
+	serverLoop->runInLoop([&] {
+		server.reset(new TcpServer(serverLoop, listenAddr, "EchoServer"));
+		server->setMessageCallback(onServerMessage);
+		server->setEdgeTriggered(edgeTriggered);
+		server->start();
+		started.countDown();
+	});
+	started.wait();
+
+	EventLoop loop;
+	std::vector<std::unique_ptr<TcpClient> > clients;
+	for (int i = 0; i < connections; ++i)
+	{
+		clients.emplace_back(new TcpClient(&loop, InetAddress("127.0.0.1", 2027), "EchoClient"));
+		clients.back()->setEdgeTriggered(edgeTriggered);
+		clients.back()->setConnectionCallback(onClientConnection);
+		clients.back()->setMessageCallback(onClientMessage);
+		clients.back()->connect();
+	}
+
+	/*先预热 1 秒，丢掉建立连接时候的数据*/
+	Timestamp start;
+	loop.runAfter(1.0, [&start] {
+		g_latencies.clear();
+		start = Timestamp::now();
+	});
+	loop.runAfter(1.0 + seconds, [&] {
+		g_running = false;
+		double elapsed = timeDifference(Timestamp::now(), start);
+		std::vector<int64_t> sorted(g_latencies);
+		std::sort(sorted.begin(), sorted.end());
+		size_t n = sorted.size();
+		printf("%-6s %s %4d connections %6zu bytes: %9.0f req/s %8.1f MiB/s  latency us p50 %5ld p99 %5ld max %6ld\n",
+				backend, edgeTriggered ? "et" : "lt", connections, g_messageSize,
+				n / elapsed, n * g_messageSize / elapsed / 1024 / 1024,
+				n ? static_cast<long>(sorted[n / 2]) : 0L,
+				n ? static_cast<long>(sorted[n * 99 / 100]) : 0L,
+				n ? static_cast<long>(sorted[n - 1]) : 0L);
+		fflush(stdout);
+		for (auto& client : clients)
+		{
+			client->disconnect();
+		}
+		loop.runAfter(0.5, std::bind(&EventLoop::quit, &loop));
+	});
+	loop.loop();
+	clients.clear();
+
+	CountDownLatch stopped(1);
+	serverLoop->runInLoop([&] {
+		server.reset();
+		stopped.countDown();
+	});
+	stopped.wait();
+}
@@ -0,0 +1,104 @@
+#include "base/CountDownLatch.h"
+#include "base/Logging.h"
+#include "base/Thread.h"
+#include "base/Timestamp.h"
+#include "net/EventLoop.h"
+#include "net/EventLoopThread.h"
+
+#include <memory>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * 多个线程同时向一个 EventLoop runInLoop() 的吞吐量
+ * 每一轮 producers 个线程一共投递 total 个回调，回调在 loop 线程中计数，全部执行完之后统计耗时
+ * 同时打印这一轮 loop 被唤醒 (eventfd 被写) 的次数
+ *
+ * usage: QueueInLoop_test [total] [maxProducers]
+*/
+
+using namespace muduo;
+using namespace muduo::net;
+
+struct Round
+{
+	int64_t expected;
+	int64_t done;
+	CountDownLatch* finished;
+};
+
+void onFunctor(Round* round)
+{
+	if (++round->done == round->expected)
+		round->finished->countDown();
+}
+
+void produce(EventLoop* loop, Round* round, int64_t count, CountDownLatch* start)
+{
+	start->wait();
+	for (int64_t i = 0; i < count; ++i)
+	{
+		loop->runInLoop(std::bind(onFunctor, round));
+	}
+}
+
+int64_t loopWakeups(EventLoop* loop)
+{
+	int64_t wakeups = 0;
+	CountDownLatch latch(1);
+	loop->runInLoop([loop, &wakeups, &latch] {
+		wakeups = loop->wakeups();
+		latch.countDown();
+	});
+	latch.wait();
+	return wakeups;
+}
+
+void runRound(EventLoop* loop, int producers, int64_t total)
+{
+	int64_t perProducer = total / producers;
+	CountDownLatch finished(1);
+	CountDownLatch start(1);
+	Round round = { perProducer * producers, 0, &finished };
+
+	std::vector<std::unique_ptr<Thread> > threads;
+	for (int i = 0; i < producers; ++i)
+	{
+		threads.emplace_back(new Thread(std::bind(produce, loop, &round, perProducer, &start)));
+		threads.back()->start();
+	}
+
+	int64_t wakeupsBefore = loopWakeups(loop);
+	Timestamp begin = Timestamp::now();
+	start.countDown();
+	finished.wait();
+	double seconds = timeDifference(Timestamp::now(), begin);
+	int64_t wakeups = loopWakeups(loop) - wakeupsBefore - 1;	/*减去 loopWakeups() 自己的一次*/
+
+	for (auto& thr : threads)
+	{
+		thr->join();
+	}
+	printf("%2d producers: %8.0f functors/s  %7ld wakeups (%.1f functors/wakeup)\n",
+			producers,
+			static_cast<double>(round.expected) / seconds,
+			static_cast<long>(wakeups),
+			wakeups > 0 ? static_cast<double>(round.expected) / wakeups : 0.0);
+	fflush(stdout);
+}
+
+int main(int argc, char* argv[])
+{
+	int64_t total = argc > 1 ? atol(argv[1]) : 1000000;
+	int maxProducers = argc > 2 ? atoi(argv[2]) : 32;
+	Logger::setLogLevel(Logger::WARN);
+
+	EventLoopThread loopThread;
+	EventLoop* loop = loopThread.startLoop();
+	for (int producers = 1; producers <= maxProducers; producers *= 2)
+	{
+		runRound(loop, producers, total);
+	}
+}
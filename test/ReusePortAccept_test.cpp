@@ -0,0 +1,142 @@
+#include "base/CountDownLatch.h"
+#include "base/Logging.h"
+#include "base/Mutex.h"
+#include "base/Thread.h"
+#include "base/Timestamp.h"
+#include "net/EventLoop.h"
+#include "net/EventLoopThread.h"
+#include "net/TcpServer.h"
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/**
+ * 短连接的 accept 吞吐量，比较 TcpServer 的一个 Acceptor (kNoReusePort) 和每一个 io loop 一个 Acceptor (kReusePortPerLoop)
+ * 服务端在连接建立之后马上 shutdown()，客户端线程阻塞的 connect()，读到 EOF 之后关闭，再发起下一个连接
+ * 服务端先关闭，TIME_WAIT 留在服务端，不占用客户端的端口
+ * 运行 seconds 秒之后打印每秒完成的连接数，以及连接在各个 io loop 上的分布
+ *
+ * usage: ReusePortAccept_test [single|perloop] [ioThreads] [clientThreads] [seconds]
+*/
+
+using namespace muduo;
+using namespace muduo::net;
+
+const uint16_t kPort = 2031;
+
+MutexLock g_mutex;
+std::map<EventLoop*, int64_t> g_connectionsPerLoop;
+std::atomic<bool> g_running(true);
+std::atomic<int64_t> g_completed(0);
+
+void onConnection(const TcpConnectionPtr& conn)
+{
+	if (conn->connected())
+	{
+		{
+			MutexLockGuard lock(g_mutex);
+			++g_connectionsPerLoop[conn->getLoop()];
+		}
+		conn->shutdown();
+	}
+}
+
+void connectLoop()
+{
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof addr);
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(kPort);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	while (g_running.load(std::memory_order_relaxed))
+	{
+		int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+		if (::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof addr) == 0)
+		{
+			char buf[16];
+			while (::read(fd, buf, sizeof buf) > 0)
+			{
+			}
+			g_completed.fetch_add(1, std::memory_order_relaxed);
+		}
+		::close(fd);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	bool perLoop = argc > 1 && strcmp(argv[1], "perloop") == 0;
+	int ioThreads = argc > 2 ? atoi(argv[2]) : 4;
+	int clientThreads = argc > 3 ? atoi(argv[3]) : 8;
+	double seconds = argc > 4 ? atof(argv[4]) : 5.0;
+	Logger::setLogLevel(Logger::WARN);
+
+	EventLoopThread baseThread;
+	EventLoop* baseLoop = baseThread.startLoop();
+	std::unique_ptr<TcpServer> server;
+	CountDownLatch started(1);
+	baseLoop->runInLoop([&] {
+		server.reset(new TcpServer(baseLoop, InetAddress(kPort, true), "AcceptServer",
+								   perLoop ? TcpServer::kReusePortPerLoop : TcpServer::kNoReusePort));
+		server->setConnectionCallback(onConnection);
+		server->setThreadNum(ioThreads);
+		server->start();
+		started.countDown();
+	});
+	started.wait();
+	::usleep(100 * 1000);	/*等待各个 io loop listen()*/
+
+	std::vector<std::unique_ptr<Thread> > clients;
+	for (int i = 0; i < clientThreads; ++i)
+	{
+		clients.emplace_back(new Thread(connectLoop, "client"));
+		clients.back()->start();
+	}
+	Timestamp begin = Timestamp::now();
+	::usleep(static_cast<useconds_t>(seconds * 1000 * 1000));
+	g_running = false;
+	int64_t completed = g_completed.load();
+	double elapsed = timeDifference(Timestamp::now(), begin);
+	for (auto& thr : clients)
+	{
+		thr->join();
+	}
+
+	printf("%-7s %d io threads: %8.0f connections/s  per loop:",
+			perLoop ? "perloop" : "single", ioThreads, static_cast<double>(completed) / elapsed);
+	{
+		MutexLockGuard lock(g_mutex);
+		for (const auto& item : g_connectionsPerLoop)
+		{
+			printf(" %ld", static_cast<long>(item.second));
+		}
+	}
+	printf("\n");
+	fflush(stdout);
+
+	/**
+	 * 客户端都已经关闭，等服务端把所有的连接从 TcpServer 中删除之后再析构
+	 * 否则 base loop 的队列中可能还有这些连接的 removeConnectionInLoop()
+	*/
+	while (server->numConnections() > 0)
+	{
+		::usleep(10 * 1000);
+	}
+	CountDownLatch stopped(1);
+	baseLoop->runInLoop([&] {
+		server.reset();
+		stopped.countDown();
+	});
+	stopped.wait();
+}
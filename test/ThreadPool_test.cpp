@@ -1,11 +1,25 @@
 #include "base/ThreadPool.h"
+#include "base/WorkStealingThreadPool.h"
 #include "base/CountDownLatch.h"
 #include "base/CurrentThread.h"
 #include "base/Logging.h"
+#include "base/Timestamp.h"
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>  // usleep
 
+/**
+ * 先用 ThreadPool 和 WorkStealingThreadPool 分别运行原来的功能测试，然后对比两者的吞吐量和延迟
+ *
+ * usage: ThreadPool_test [tasks] [workers]
+ * 只运行对比测试：ThreadPool_test [tasks] [workers] bench
+ */
+
 void print()
 {
   printf("tid=%d\n", muduo::CurrentThread::tid());
@@ -17,10 +31,11 @@ void printString(const std::string& str)
   usleep(100*1000);
 }
 
+template <typename Pool>
 void test(int maxSize)
 {
   LOG_WARN << "Test ThreadPool with max queue size = " << maxSize;
-  muduo::ThreadPool pool("MainThreadPool");
+  Pool pool("MainThreadPool");
   pool.setMaxQueueSize(maxSize);
   pool.start(5);  /**设置了5个线程*/
 
@@ -61,10 +76,11 @@ void longTask(int num)
   muduo::CurrentThread::sleepUsec(3000000);
 }
 
+template <typename Pool>
 void test2()
 {
   LOG_WARN << "Test ThreadPool by stoping early.";
-  muduo::ThreadPool pool("ThreadPool");
+  Pool pool("ThreadPool");
   pool.setMaxQueueSize(5);
   pool.start(3);
 
@@ -87,12 +103,187 @@ void test2()
   LOG_WARN << "test2 Done";
 }
 
-int main()
+/*一次取多个任务的时候，所有的任务都要执行，并且分散到各个线程*/
+void testBatch(int maxQueueSize)
+{
+  LOG_WARN << "Test ThreadPool batch 16 with max queue size = " << maxQueueSize;
+  muduo::ThreadPool pool("BatchPool");
+  pool.setMaxQueueSize(maxQueueSize);
+  pool.setTaskBatch(16);
+  pool.start(4);
+  std::atomic<int> count(0);
+  for (int i = 0; i < 10000; ++i)
+    pool.run([&count] { ++count; });
+  muduo::CountDownLatch latch(1);
+  pool.run(std::bind(&muduo::CountDownLatch::countDown, &latch));
+  latch.wait();
+  while (count < 10000)
+    usleep(1000);
+  pool.stop();
+  LOG_WARN << "count = " << count.load();
+}
+
+/*所有 worker 都休眠的时候一次提交 workers 个耗时的任务，每个 worker 都要被唤醒，总时间约等于一个任务的时间*/
+template <typename Pool>
+void testBurstWakeup(int workers, int taskMs)
+{
+  Pool pool("BurstPool");
+  pool.start(workers);
+  usleep(200 * 1000);  // 等所有的 worker 都休眠
+  muduo::CountDownLatch latch(workers);
+  muduo::Timestamp start(muduo::Timestamp::now());
+  for (int i = 0; i < workers; ++i)
+    pool.run([taskMs, &latch] { usleep(taskMs * 1000); latch.countDown(); });
+  latch.wait();
+  double ms = muduo::timeDifference(muduo::Timestamp::now(), start) * 1000;
+  pool.stop();
+  LOG_WARN << "burst of " << workers << " x " << taskMs << "ms tasks took " << ms << "ms";
+  if (ms > taskMs * 1.8)
+  {
+    fprintf(stderr, "burst wakeup: %d tasks of %dms took %.1fms, some workers were not woken\n",
+            workers, taskMs, ms);
+    abort();
+  }
+}
+
+template <typename Pool>
+void functionalTests()
 {
-  test(0);
-  test(1);
-  test(5);
-  test(10);
-  test(50);
-  test2();
+  test<Pool>(0);
+  test<Pool>(1);
+  test<Pool>(5);
+  test<Pool>(10);
+  test<Pool>(50);
+  test2<Pool>();
+  testBurstWakeup<Pool>(8, 100);
+}
+
+std::atomic<int64_t> g_done(0);
+
+void countTask(int64_t total, muduo::CountDownLatch* latch)
+{
+  if (g_done.fetch_add(1, std::memory_order_relaxed) + 1 == total)
+    latch->countDown();
+}
+
+template <typename Pool>
+void submit(Pool* pool, int64_t count, int64_t total, muduo::CountDownLatch* latch)
+{
+  for (int64_t i = 0; i < count; ++i)
+    pool->run(std::bind(countTask, total, latch));
+}
+
+/*只有 ThreadPool 支持一次取多个任务*/
+void setTaskBatch(muduo::ThreadPool* pool, int maxBatch)
+{
+  pool->setTaskBatch(maxBatch);
+}
+
+void setTaskBatch(muduo::WorkStealingThreadPool*, int)
+{
+}
+
+/*producers 个线程同时 run() 空任务，producers == 0 的时候由线程池中的一个任务提交 (worker 中产生子任务)*/
+template <typename Pool>
+double throughput(int workers, int producers, int64_t total, int maxQueueSize = 0, int maxBatch = 1)
+{
+  Pool pool("BenchPool");
+  pool.setMaxQueueSize(maxQueueSize);
+  setTaskBatch(&pool, maxBatch);
+  pool.start(workers);
+  g_done = 0;
+  muduo::CountDownLatch latch(1);
+  muduo::Timestamp begin = muduo::Timestamp::now();
+  if (producers == 0)
+  {
+    pool.run(std::bind(submit<Pool>, &pool, total, total, &latch));
+  }
+  else
+  {
+    std::vector<std::unique_ptr<muduo::Thread> > threads;
+    for (int i = 0; i < producers; ++i)
+    {
+      threads.emplace_back(new muduo::Thread(
+          std::bind(submit<Pool>, &pool, total / producers, total / producers * producers, &latch)));
+      threads.back()->start();
+    }
+    for (auto& thr : threads)
+      thr->join();
+  }
+  latch.wait();
+  double seconds = timeDifference(muduo::Timestamp::now(), begin);
+  pool.stop();
+  return static_cast<double>(g_done.load()) / seconds;
+}
+
+void recordLatency(muduo::Timestamp submitted, int64_t* latency, muduo::CountDownLatch* latch)
+{
+  *latency = muduo::Timestamp::now().microSecondsSinceEpoch() - submitted.microSecondsSinceEpoch();
+  latch->countDown();
+}
+
+/*一个任务从 run() 到开始执行的时间，gapUs 是两个任务之间的间隔，间隔长的时候 worker 已经休眠*/
+template <typename Pool>
+void latency(const char* name, int workers, int count, int gapUs)
+{
+  Pool pool("LatencyPool");
+  pool.start(workers);
+  std::vector<int64_t> samples(count);
+  for (int i = 0; i < count; ++i)
+  {
+    muduo::CountDownLatch latch(1);
+    pool.run(std::bind(recordLatency, muduo::Timestamp::now(), &samples[i], &latch));
+    latch.wait();
+    if (gapUs > 0)
+      usleep(gapUs);
+  }
+  pool.stop();
+  std::sort(samples.begin(), samples.end());
+  printf("  %-22s gap %5dus  latency p50 %4ldus  p99 %5ldus\n", name, gapUs,
+         static_cast<long>(samples[count / 2]), static_cast<long>(samples[count * 99 / 100]));
+  fflush(stdout);
+}
+
+void benchmark(int64_t tasks, int workers)
+{
+  printf("%d workers, %ld tasks, tasks/s:\n", workers, static_cast<long>(tasks));
+  printf("  producers  ThreadPool  WorkStealingThreadPool\n");
+  int producerCounts[] = { 0, 1, 2, 4, 8 };
+  for (int producers : producerCounts)
+  {
+    double a = throughput<muduo::ThreadPool>(workers, producers, tasks);
+    double b = throughput<muduo::WorkStealingThreadPool>(workers, producers, tasks);
+    printf("  %9s  %10.0f  %22.0f\n", producers == 0 ? "in-pool" : std::to_string(producers).c_str(), a, b);
+    fflush(stdout);
+  }
+  printf("  bounded (maxQueueSize 1024, 4 producers): ThreadPool %.0f  WorkStealingThreadPool %.0f\n",
+         throughput<muduo::ThreadPool>(workers, 4, tasks, 1024),
+         throughput<muduo::WorkStealingThreadPool>(workers, 4, tasks, 1024));
+  printf("  ThreadPool, 8 producers: batch 1 %.0f  batch 64 %.0f  batch 64 bounded 1024 %.0f\n",
+         throughput<muduo::ThreadPool>(workers, 8, tasks),
+         throughput<muduo::ThreadPool>(workers, 8, tasks, 0, 64),
+         throughput<muduo::ThreadPool>(workers, 8, tasks, 1024, 64));
+  fflush(stdout);
+
+  latency<muduo::ThreadPool>("ThreadPool", workers, 2000, 0);
+  latency<muduo::WorkStealingThreadPool>("WorkStealingThreadPool", workers, 2000, 0);
+  latency<muduo::ThreadPool>("ThreadPool", workers, 500, 1000);
+  latency<muduo::WorkStealingThreadPool>("WorkStealingThreadPool", workers, 500, 1000);
+}
+
+int main(int argc, char* argv[])
+{
+  int64_t tasks = argc > 1 ? atol(argv[1]) : 1000000;
+  int workers = argc > 2 ? atoi(argv[2]) : 4;
+  bool benchOnly = argc > 3;
+  muduo::Logger::setLogLevel(muduo::Logger::INFO);
+  if (!benchOnly)
+  {
+    functionalTests<muduo::ThreadPool>();
+    functionalTests<muduo::WorkStealingThreadPool>();
+    testBatch(0);
+    testBatch(100);
+  }
+  muduo::Logger::setLogLevel(muduo::Logger::WARN);
+  benchmark(tasks, workers);
 }
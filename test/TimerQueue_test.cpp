@@ -0,0 +1,124 @@
+#include "base/Logging.h"
+#include "base/Timestamp.h"
+#include "net/EventLoop.h"
+#include "net/TimerId.h"
+#include "net/TimerQueue.h"
+
+#include <vector>
+
+#include <stdio.h>
+
+/**
+ * 比较 TimerQueue 两种存储方式 (kTimerSet / kTimerHeap) 的性能
+ * add : 在 loop 线程中添加 N 个一小时之后才触发的 timer
+ * cancel : 取消上面的 N 个 timer
+ * expire : 添加 N 个立刻超时的 timer，统计全部触发完成所需的时间
+ * rearm : 一次循环之内添加 N 个越来越早的短 timer，统计 timerfd_settime() 的调用次数
+ *
+ * usage: TimerQueue_test
+*/
+
+using namespace muduo;
+using namespace muduo::net;
+
+int g_fired = 0;
+int g_total = 0;
+EventLoop* g_loop = NULL;
+
+void onTimer()
+{
+	if (++g_fired == g_total)
+	{
+		g_loop->quit();
+	}
+}
+
+void printResult(const char* what, int n, Timestamp start)
+{
+	double seconds = timeDifference(Timestamp::now(), start);
+	printf("  %-6s %8d timers %8.3f s %12.0f ops/s\n",
+			what, n, seconds, static_cast<double>(n) / seconds);
+}
+
+void bench(EventLoop::TimerQueueOption option, int n)
+{
+	EventLoop loop;
+	loop.setTimerQueueOption(option);
+	g_loop = &loop;
+
+	std::vector<TimerId> timers;
+	timers.reserve(n);
+
+	Timestamp start(Timestamp::now());
+	for (int i = 0; i < n; ++i)
+	{
+		timers.push_back(loop.runAfter(3600.0 + i * 1e-6, onTimer));
+	}
+	printResult("add", n, start);
+
+	start = Timestamp::now();
+	for (const TimerId& timerId : timers)
+	{
+		loop.cancel(timerId);
+	}
+	printResult("cancel", n, start);
+
+	g_fired = 0;
+	g_total = n;
+	start = Timestamp::now();
+	Timestamp when(Timestamp::now());
+	for (int i = 0; i < n; ++i)
+	{
+		loop.runAt(when, onTimer);
+	}
+	loop.loop();
+	printResult("expire", n, start);
+}
+
+void addShortTimers(int n)
+{
+	for (int i = 0; i < n; ++i)
+	{
+		g_loop->runAfter(0.05 - i * 1e-6, onTimer);
+	}
+}
+
+void benchRearm(bool deferred, double slack, int n)
+{
+	EventLoop loop;
+	loop.setTimerRearmDeferred(deferred);
+	loop.setTimerSlack(slack);
+	g_loop = &loop;
+	g_fired = 0;
+	g_total = n;
+
+	Timestamp start(Timestamp::now());
+	loop.runInLoop(std::bind(addShortTimers, n));
+	loop.loop();
+	double seconds = timeDifference(Timestamp::now(), start);
+
+	const TimerQueue* queue = loop.timerQueue();
+	printf("  deferred=%d slack=%.3f: %d timers fired in %.3f s, "
+			"rearm requests %ld, timerfd_settime %ld, saved %ld\n",
+			deferred, slack, n, seconds,
+			queue->rearmRequests(), queue->rearmSyscalls(), queue->rearmSaved());
+}
+
+int main()
+{
+	Logger::setLogLevel(Logger::WARN);
+
+	const int kCounts[] = { 10*1000, 100*1000, 1000*1000 };
+	for (int n : kCounts)
+	{
+		printf("kTimerSet\n");
+		bench(EventLoop::kTimerSet, n);
+		printf("kTimerHeap\n");
+		bench(EventLoop::kTimerHeap, n);
+	}
+
+	printf("rearm\n");
+	benchRearm(false, 0.0, 10000);
+	benchRearm(true, 0.0, 10000);
+	benchRearm(true, 0.001, 10000);
+}
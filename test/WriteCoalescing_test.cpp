@@ -0,0 +1,135 @@
+#include "base/CountDownLatch.h"
+#include "base/Logging.h"
+#include "net/EventLoop.h"
+#include "net/EventLoopThread.h"
+#include "net/TcpClient.h"
+#include "net/TcpServer.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * 流水线的请求/响应，比较服务端打开和关闭 TcpConnection::setWriteCoalescing() 的区别
+ * 每一个请求 kRequestSize 字节，服务端对每一个请求单独 send() 一个 kResponseSize 字节的响应
+ * 客户端每个连接保持 depth 个请求在路上，收到多少个响应就一次补发多少个请求
+ * 运行 seconds 秒之后打印每秒的请求数，以及服务端平均每个请求 write/writev 的次数
+ *
+ * usage: WriteCoalescing_test [on|off] [connections] [depth] [seconds]
+*/
+
+using namespace muduo;
+using namespace muduo::net;
+
+const size_t kRequestSize = 32;
+const size_t kResponseSize = 128;
+
+std::vector<std::unique_ptr<TcpClient> > g_clients;
+int64_t g_responses = 0;
+std::atomic<int64_t> g_serverWriteCalls(0);
+std::atomic<int64_t> g_serverRequests(0);
+
+void onServerConnection(const TcpConnectionPtr& conn)
+{
+	if (conn->connected())
+		conn->setTcpNoDelay(true);
+	else
+		g_serverWriteCalls += conn->writeCalls();
+}
+
+void onRequest(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+	static const string response(kResponseSize, 'r');
+	int64_t requests = 0;
+	while (buf->readableBytes() >= kRequestSize)
+	{
+		buf->retrieve(kRequestSize);
+		conn->send(response);
+		++requests;
+	}
+	g_serverRequests += requests;
+}
+
+void onClientConnection(const TcpConnectionPtr& conn, int depth)
+{
+	if (conn->connected())
+	{
+		conn->setTcpNoDelay(true);
+		conn->send(string(kRequestSize * depth, 'q'));
+	}
+}
+
+void onResponse(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+	size_t n = buf->readableBytes() / kResponseSize;
+	if (n > 0)
+	{
+		buf->retrieve(n * kResponseSize);
+		g_responses += n;
+		conn->send(string(kRequestSize * n, 'q'));
+	}
+}
+
+void stop(EventLoop* loop)
+{
+	for (auto& client : g_clients)
+	{
+		client->disconnect();
+	}
+	loop->runAfter(0.5, std::bind(&EventLoop::quit, loop));
+}
+
+int main(int argc, char* argv[])
+{
+	bool coalescing = argc <= 1 || strcmp(argv[1], "off") != 0;
+	int connections = argc > 2 ? atoi(argv[2]) : 10;
+	int depth = argc > 3 ? atoi(argv[3]) : 16;
+	double seconds = argc > 4 ? atof(argv[4]) : 5.0;
+	Logger::setLogLevel(Logger::WARN);
+
+	EventLoopThread serverThread;
+	EventLoop* serverLoop = serverThread.startLoop();
+	InetAddress listenAddr(2030, true);
+	std::unique_ptr<TcpServer> server;
+	CountDownLatch started(1);
+	serverLoop->runInLoop([&] {
+		server.reset(new TcpServer(serverLoop, listenAddr, "PipelineServer"));
+		server->setConnectionCallback(onServerConnection);
+		server->setMessageCallback(onRequest);
+		server->setWriteCoalescing(coalescing);
+		server->start();
+		started.countDown();
+	});
+	started.wait();
+
+	EventLoop loop;
+	for (int i = 0; i < connections; ++i)
+	{
+		g_clients.emplace_back(new TcpClient(&loop, InetAddress("127.0.0.1", 2030), "PipelineClient"));
+		g_clients.back()->setConnectionCallback(std::bind(onClientConnection, _1, depth));
+		g_clients.back()->setMessageCallback(onResponse);
+		g_clients.back()->connect();
+	}
+	loop.runAfter(seconds, std::bind(stop, &loop));
+	loop.loop();
+	g_clients.clear();
+
+	CountDownLatch stopped(1);
+	serverLoop->runInLoop([&] {
+		server.reset();
+		stopped.countDown();
+	});
+	stopped.wait();
+
+	int64_t requests = g_serverRequests.load();
+	printf("write coalescing %-3s: %8.0f requests/s  server writes %ld (%.3f per request)\n",
+			coalescing ? "on" : "off",
+			static_cast<double>(g_responses) / seconds,
+			static_cast<long>(g_serverWriteCalls.load()),
+			requests > 0 ? static_cast<double>(g_serverWriteCalls.load()) / requests : 0.0);
+	fflush(stdout);
+}